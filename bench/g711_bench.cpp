@@ -0,0 +1,150 @@
+// Microbenchmark of each G.711 batch kernel, one 20 ms frame (160 samples)
+// per call as the media path converts them. Input is speech-like noise so
+// every segment is hit. Kernels this CPU cannot run are skipped.
+//
+//   g711_bench [frames]
+
+#include "util/G711Utils.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+using Kernel = G711Utils::Kernel;
+
+const size_t kFrameSamples = 160;
+const int kGainQ8 = 300; // off unity, so the fused gain path does real work
+
+enum class Op {
+  DecodeULaw,
+  DecodeALaw,
+  EncodeULaw,
+  EncodeALaw,
+  DecodeULawGain,
+  DecodeALawGain,
+  EncodeULawGain,
+  EncodeALawGain
+};
+
+const Op kOps[] = {Op::DecodeULaw,     Op::DecodeALaw,     Op::EncodeULaw,
+                   Op::EncodeALaw,     Op::DecodeULawGain, Op::DecodeALawGain,
+                   Op::EncodeULawGain, Op::EncodeALawGain};
+
+const char *opName(Op op) {
+  switch (op) {
+  case Op::DecodeULaw:
+    return "decodeULaw";
+  case Op::DecodeALaw:
+    return "decodeALaw";
+  case Op::EncodeULaw:
+    return "encodeULaw";
+  case Op::EncodeALaw:
+    return "encodeALaw";
+  case Op::DecodeULawGain:
+    return "decodeULaw+gain";
+  case Op::DecodeALawGain:
+    return "decodeALaw+gain";
+  case Op::EncodeULawGain:
+    return "encodeULaw+gain";
+  case Op::EncodeALawGain:
+    return "encodeALaw+gain";
+  }
+  return "?";
+}
+
+// A few frames of input, cycled so they stay in L1 like a live frame does
+struct Input {
+  static const size_t kFrames = 16;
+  std::vector<int16_t> pcm;
+  std::vector<uint8_t> ulaw, alaw;
+
+  Input() : pcm(kFrames * kFrameSamples) {
+    std::mt19937 rng(1);
+    std::normal_distribution<double> speech(0.0, 4000.0);
+    for (auto &s : pcm) {
+      double v = speech(rng);
+      s = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+    }
+    ulaw.resize(pcm.size());
+    alaw.resize(pcm.size());
+    for (size_t i = 0; i < pcm.size(); ++i) {
+      ulaw[i] = G711Utils::linearToULaw(pcm[i]);
+      alaw[i] = G711Utils::linearToALaw(pcm[i]);
+    }
+  }
+};
+
+// Nanoseconds per frame
+double run(const Input &input, Op op, size_t frames, uint64_t &checksum) {
+  int16_t pcmOut[kFrameSamples];
+  uint8_t codeOut[kFrameSamples];
+  auto start = Clock::now();
+  for (size_t f = 0; f < frames; ++f) {
+    size_t at = (f % Input::kFrames) * kFrameSamples;
+    const int16_t *pcm = input.pcm.data() + at;
+    const uint8_t *ulaw = input.ulaw.data() + at;
+    const uint8_t *alaw = input.alaw.data() + at;
+    switch (op) {
+    case Op::DecodeULaw:
+      G711Utils::decodeULaw(ulaw, pcmOut, kFrameSamples);
+      break;
+    case Op::DecodeALaw:
+      G711Utils::decodeALaw(alaw, pcmOut, kFrameSamples);
+      break;
+    case Op::EncodeULaw:
+      G711Utils::encodeULaw(pcm, codeOut, kFrameSamples);
+      break;
+    case Op::EncodeALaw:
+      G711Utils::encodeALaw(pcm, codeOut, kFrameSamples);
+      break;
+    case Op::DecodeULawGain:
+      G711Utils::decodeULaw(ulaw, pcmOut, kFrameSamples, kGainQ8);
+      break;
+    case Op::DecodeALawGain:
+      G711Utils::decodeALaw(alaw, pcmOut, kFrameSamples, kGainQ8);
+      break;
+    case Op::EncodeULawGain:
+      G711Utils::encodeULaw(pcm, codeOut, kFrameSamples, kGainQ8);
+      break;
+    case Op::EncodeALawGain:
+      G711Utils::encodeALaw(pcm, codeOut, kFrameSamples, kGainQ8);
+      break;
+    }
+    // Keeps the output live so the call cannot be dropped
+    checksum += (uint16_t)pcmOut[f % kFrameSamples] + codeOut[f % kFrameSamples];
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return seconds * 1e9 / frames;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+  Input input;
+  uint64_t checksum = 0;
+
+  std::printf("%zu frames of %zu samples per run\n\n", frames, kFrameSamples);
+  std::printf("%-8s %-16s %10s %12s\n", "kernel", "op", "ns/frame",
+              "Msamples/s");
+  for (Kernel k : {Kernel::Scalar, Kernel::Lut, Kernel::Sse41, Kernel::Avx2,
+                   Kernel::Neon}) {
+    if (!G711Utils::setKernel(k)) {
+      std::printf("%-8s (not supported here)\n", G711Utils::kernelName(k));
+      continue;
+    }
+    for (Op op : kOps) {
+      run(input, op, frames / 10 + 1, checksum); // warm up
+      double ns = run(input, op, frames, checksum);
+      std::printf("%-8s %-16s %10.1f %12.1f\n", G711Utils::kernelName(k),
+                  opName(op), ns, kFrameSamples * 1e3 / ns);
+    }
+  }
+  std::printf("\n(checksum %llu)\n", (unsigned long long)checksum);
+  return 0;
+}
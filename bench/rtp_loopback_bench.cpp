@@ -0,0 +1,153 @@
+// Echo benchmark of the RtpWorker I/O backends over loopback: the worker
+// echoes every datagram it receives, and one client socket keeps a window of
+// packets in flight across all ports. Run once per backend with the same
+// load for a side-by-side comparison.
+//
+//   rtp_loopback_bench [ports] [packets] [window]
+
+#include "app/Logger.h"
+#include "rtp/RtpWorker.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+class EchoSink : public RtpSink {
+public:
+  EchoSink(RtpWorker &worker) : worker_(worker) {}
+  void setPort(int port) { port_ = port; }
+  void onRtpPacket(const RtpPacketRef &pkt,
+                   const sockaddr_in &sender) override {
+    worker_.send(port_, pkt, sender);
+  }
+
+private:
+  RtpWorker &worker_;
+  int port_ = 0;
+};
+
+struct Result {
+  bool ran = false;
+  double seconds = 0;
+  size_t echoed = 0;
+  size_t lost = 0;
+  double p50Us = 0;
+  double p99Us = 0;
+};
+
+Result run(RtpIoBackend backend, int ports, size_t packets, size_t window) {
+  const int kBasePort = 41000;
+  RtpWorkerOptions options;
+  options.ioBackend = backend;
+  options.socketPoolSize = ports;
+  options.portQuarantineMs = 0;
+  RtpWorker worker(0, kBasePort, kBasePort + 2 * ports - 1, options);
+  Result result;
+  if (backend == RtpIoBackend::IO_URING && !worker.usesIoUring())
+    return result;
+  worker.start();
+
+  std::vector<int> localPorts;
+  std::vector<std::shared_ptr<EchoSink>> sinks;
+  for (int i = 0; i < ports; ++i) {
+    auto sink = std::make_shared<EchoSink>(worker);
+    int port = worker.allocatePort(sink);
+    if (port < 0) {
+      fprintf(stderr, "port allocation failed\n");
+      return result;
+    }
+    sink->setPort(port);
+    sinks.push_back(sink);
+    localPorts.push_back(port);
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  int buf = 4 << 20;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+  struct timeval tv = {0, 100000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  // 12-byte RTP header and 160 bytes of PCMU, send time in the payload
+  uint8_t packet[172] = {0x80, 0x00};
+  std::vector<sockaddr_in> dests(ports);
+  for (int i = 0; i < ports; ++i) {
+    dests[i].sin_family = AF_INET;
+    dests[i].sin_port = htons(localPorts[i]);
+    dests[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+
+  std::vector<double> rtts;
+  rtts.reserve(packets);
+  size_t sent = 0;
+  auto start = Clock::now();
+  while (result.echoed + result.lost < packets) {
+    while (sent < packets && sent - result.echoed - result.lost < window) {
+      int64_t now = Clock::now().time_since_epoch().count();
+      memcpy(packet + 12, &now, sizeof(now));
+      const sockaddr_in &dest = dests[sent % ports];
+      sendto(fd, packet, sizeof(packet), 0, (const sockaddr *)&dest,
+             sizeof(dest));
+      sent++;
+    }
+    uint8_t in[2048];
+    ssize_t n = recv(fd, in, sizeof(in), 0);
+    if (n < 0) {
+      // Nothing for 100 ms: what is still in flight was dropped
+      result.lost = sent - result.echoed;
+      continue;
+    }
+    int64_t then;
+    memcpy(&then, in + 12, sizeof(then));
+    rtts.push_back((Clock::now().time_since_epoch().count() - then) / 1000.0);
+    result.echoed++;
+  }
+  result.seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  close(fd);
+
+  for (int port : localPorts)
+    worker.releasePort(port);
+  worker.stop();
+
+  std::sort(rtts.begin(), rtts.end());
+  if (!rtts.empty()) {
+    result.p50Us = rtts[rtts.size() / 2];
+    result.p99Us = rtts[rtts.size() * 99 / 100];
+  }
+  result.ran = true;
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int ports = argc > 1 ? atoi(argv[1]) : 16;
+  size_t packets = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200000;
+  size_t window = argc > 3 ? strtoul(argv[3], nullptr, 10) : 64;
+  Logger::instance().setLevel(LogLevel::ERROR);
+
+  printf("%d ports, %zu packets, window %zu\n", ports, packets, window);
+  printf("%-9s %10s %8s %12s %10s %10s\n", "backend", "echoed", "lost",
+         "packets/s", "p50 us", "p99 us");
+  for (auto backend : {RtpIoBackend::EPOLL, RtpIoBackend::IO_URING}) {
+    const char *name = backend == RtpIoBackend::EPOLL ? "epoll" : "io_uring";
+    Result r = run(backend, ports, packets, window);
+    if (!r.ran) {
+      printf("%-9s unavailable on this kernel/build\n", name);
+      continue;
+    }
+    printf("%-9s %10zu %8zu %12.0f %10.1f %10.1f\n", name, r.echoed, r.lost,
+           r.echoed / r.seconds, r.p50Us, r.p99Us);
+  }
+  return 0;
+}
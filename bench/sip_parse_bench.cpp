@@ -0,0 +1,207 @@
+// Parse rate of SipParser against the parser it replaced, on one core: a
+// 12-header INVITE with SDP, parsed alone and then with the accessors the
+// transaction layer calls on every request (branch, Call-ID, tags, CSeq).
+// The old parser is reproduced below, trimmed to what it did per message, so
+// both run on the same machine and input.
+//
+//   sip_parse_bench [messages]
+
+#include "sip/SipParser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const std::string kInvite =
+    "INVITE sip:bot@gw.example.com:5060 SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP 192.0.2.10:5060;branch=z9hG4bK776asdhds;rport\r\n"
+    "Max-Forwards: 70\r\n"
+    "From: \"Alice\" <sip:alice@example.com>;tag=1928301774\r\n"
+    "To: <sip:bot@gw.example.com>\r\n"
+    "Call-ID: a84b4c76e66710@pc33.example.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "Contact: <sip:alice@192.0.2.10:5060>\r\n"
+    "Allow: INVITE, ACK, CANCEL, BYE, OPTIONS, REFER\r\n"
+    "Supported: replaces, timer\r\n"
+    "User-Agent: bench-phone/1.0\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 146\r\n"
+    "\r\n"
+    "v=0\r\n"
+    "o=alice 2890844526 2890844526 IN IP4 192.0.2.10\r\n"
+    "s=-\r\n"
+    "c=IN IP4 192.0.2.10\r\n"
+    "t=0 0\r\n"
+    "m=audio 49170 RTP/AVP 0\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n";
+
+// The replaced parser: the datagram copied into an istringstream, each line
+// trimmed into new strings, headers in a lower-cased multimap, and accessors
+// that copy the header out before searching it
+namespace legacy {
+
+struct Message {
+  bool isRequest = false;
+  std::string methodStr, uri, version = "SIP/2.0", statusPhrase, body;
+  int statusCode = 0;
+  std::multimap<std::string, std::string> headers;
+
+  static std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+  }
+  std::string get(const std::string &name) const {
+    auto it = headers.find(lower(name));
+    return it == headers.end() ? std::string() : it->second;
+  }
+  static std::string param(const std::string &value, const std::string &key) {
+    auto pos = value.find(key);
+    if (pos == std::string::npos)
+      return "";
+    auto end = value.find(';', pos);
+    return value.substr(pos + key.size(), end == std::string::npos
+                                              ? std::string::npos
+                                              : end - pos - key.size());
+  }
+  std::string branch() const { return param(get("Via"), "branch="); }
+  std::string callId() const { return get("Call-ID"); }
+  std::string fromTag() const { return param(get("From"), "tag="); }
+  std::string toTag() const { return param(get("To"), "tag="); }
+  int cseq() const {
+    std::istringstream iss(get("CSeq"));
+    int seq = 0;
+    iss >> seq;
+    return seq;
+  }
+};
+
+std::string trim(const std::string &s) {
+  auto start = s.find_first_not_of(" \t\r\n");
+  auto end = s.find_last_not_of(" \t\r\n");
+  return start == std::string::npos ? "" : s.substr(start, end - start + 1);
+}
+
+bool parse(const char *buffer, size_t length, Message &msg) {
+  std::string rawStr(buffer, length);
+  std::istringstream stream(rawStr);
+  std::string line;
+  if (!std::getline(stream, line))
+    return false;
+  if (!line.empty() && line.back() == '\r')
+    line.pop_back();
+  auto firstSpace = line.find(' ');
+  auto lastSpace = line.rfind(' ');
+  if (firstSpace == std::string::npos || firstSpace == lastSpace)
+    return false;
+  msg.isRequest = true;
+  msg.methodStr = line.substr(0, firstSpace);
+  std::transform(msg.methodStr.begin(), msg.methodStr.end(),
+                 msg.methodStr.begin(), ::toupper);
+  msg.uri = line.substr(firstSpace + 1, lastSpace - firstSpace - 1);
+  msg.version = line.substr(lastSpace + 1);
+
+  int contentLength = 0;
+  while (std::getline(stream, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty())
+      break;
+    auto colon = line.find(':');
+    if (colon == std::string::npos)
+      continue;
+    std::string name = Message::lower(trim(line.substr(0, colon)));
+    std::string value = trim(line.substr(colon + 1));
+    if (name == "content-length")
+      contentLength = std::stoi(value);
+    msg.headers.insert({name, value});
+  }
+  if (contentLength > 0) {
+    std::string body(contentLength, '\0');
+    stream.read(&body[0], contentLength);
+    body.resize(stream.gcount());
+    msg.body = body;
+  }
+  return true;
+}
+
+} // namespace legacy
+
+struct Result {
+  double perSecond;
+  uint64_t checksum;
+};
+
+template <typename Fn> Result run(size_t messages, Fn fn) {
+  uint64_t checksum = 0;
+  for (size_t i = 0; i < messages / 10 + 1; ++i) // warm up
+    checksum += fn();
+  auto start = Clock::now();
+  for (size_t i = 0; i < messages; ++i)
+    checksum += fn();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return {messages / seconds, checksum};
+}
+
+size_t legacyParse() {
+  legacy::Message msg;
+  legacy::parse(kInvite.data(), kInvite.size(), msg);
+  return msg.body.size();
+}
+
+size_t legacyParseAndRead() {
+  legacy::Message msg;
+  legacy::parse(kInvite.data(), kInvite.size(), msg);
+  return msg.branch().size() + msg.callId().size() + msg.fromTag().size() +
+         msg.toTag().size() + msg.cseq();
+}
+
+size_t currentParse() {
+  auto msg = SipParser::parse(kInvite.data(), kInvite.size());
+  return msg->body().size();
+}
+
+size_t currentParseAndRead() {
+  auto msg = SipParser::parse(kInvite.data(), kInvite.size());
+  return msg->getBranch().size() + msg->getCallId().size() +
+         msg->getFromTag().size() + msg->getToTag().size() + msg->getCSeq();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t messages = argc > 1 ? strtoul(argv[1], nullptr, 10) : 500000;
+
+  // Both parsers must agree on what they read
+  legacy::Message old;
+  auto msg = SipParser::parse(kInvite.data(), kInvite.size());
+  if (!msg || !legacy::parse(kInvite.data(), kInvite.size(), old) ||
+      old.branch() != msg->getBranch() || old.callId() != msg->getCallId() ||
+      old.fromTag() != msg->getFromTag() || old.cseq() != msg->getCSeq() ||
+      old.body != msg->body()) {
+    std::fprintf(stderr, "parsers disagree on the benchmark message\n");
+    return 1;
+  }
+
+  std::printf("%zu messages of %zu bytes per run\n\n", messages,
+              kInvite.size());
+  std::printf("%-16s %14s %14s %8s\n", "", "old parses/s", "new parses/s",
+              "speedup");
+  uint64_t checksum = 0;
+  auto report = [&](const char *what, Result before, Result after) {
+    checksum += before.checksum + after.checksum;
+    std::printf("%-16s %14.0f %14.0f %7.1fx\n", what, before.perSecond,
+                after.perSecond, after.perSecond / before.perSecond);
+  };
+  report("parse", run(messages, legacyParse), run(messages, currentParse));
+  report("parse+accessors", run(messages, legacyParseAndRead),
+         run(messages, currentParseAndRead));
+  std::printf("\n(checksum %llu)\n", (unsigned long long)checksum);
+  return 0;
+}
@@ -5,6 +5,9 @@ import time
 from proto import voicebot_pb2
 from proto import voicebot_pb2_grpc
 
+# StreamHello protocol version; 2 added multiplexing
+PROTOCOL_VERSION = 2
+
 
 class VoiceBotServicer(voicebot_pb2_grpc.VoiceBotServicer):
     def StreamCall(self, request_iterator, context):
@@ -12,19 +15,39 @@ class VoiceBotServicer(voicebot_pb2_grpc.VoiceBotServicer):
         Echo back:
         - Any incoming AudioChunk -> send it back as CallAction.audio
         - If ControlEvent.HANGUP -> send CallAction.control(HANGUP) and end
+
+        A stream that opens with StreamHello is multiplexed: it carries many
+        calls, every action names its call_id, and HANGUP only ends that call.
         """
 
         call_id = None
         got_config = False
+        multiplexed = False
+        configured = set()  # calls seen on a multiplexed stream
 
         for event in request_iterator:
-            call_id = event.call_id or call_id
-
             which = event.WhichOneof("payload")
 
+            if which == "hello":
+                hello = event.hello
+                multiplexed = hello.multiplex and hello.protocol_version >= PROTOCOL_VERSION
+                print(f"Stream hello: version={hello.protocol_version}, multiplexed={multiplexed}")
+                yield voicebot_pb2.CallAction(
+                    hello=voicebot_pb2.StreamHello(
+                        protocol_version=PROTOCOL_VERSION,
+                        multiplex=multiplexed
+                    )
+                )
+                continue
+
+            call_id = event.call_id or call_id
+            if multiplexed:
+                got_config = call_id in configured
+
             if which == "config":
                 cfg = event.config
                 got_config = True
+                configured.add(call_id)
                 print(f"[{call_id}] Config received: sample_rate={cfg.sample_rate}, codec={cfg.codec}")
                 # No response needed for config, but you could send an acknowledgement if you wanted
                 continue
@@ -38,6 +61,7 @@ class VoiceBotServicer(voicebot_pb2_grpc.VoiceBotServicer):
 
                 # Echo it back directly
                 yield voicebot_pb2.CallAction(
+                    call_id=call_id if multiplexed else "",
                     audio=voicebot_pb2.AudioChunk(
                         seq=audio.seq,
                         timestamp=audio.timestamp,
@@ -49,8 +73,15 @@ class VoiceBotServicer(voicebot_pb2_grpc.VoiceBotServicer):
                 ctrl = event.control
                 print(f"[{call_id}] Control event: {ctrl.type}")
 
-                # Echo hangup action back and stop streaming
                 if ctrl.type == voicebot_pb2.ControlEvent.Type.HANGUP:
+                    # On a multiplexed stream the gateway has already
+                    # forgotten the call, so just forget it too
+                    if multiplexed:
+                        configured.discard(call_id)
+                        print(f"[{call_id}] Call ended")
+                        continue
+
+                    # Echo hangup action back and stop streaming
                     yield voicebot_pb2.CallAction(
                         control=voicebot_pb2.BotControl(
                             type=voicebot_pb2.BotControl.Type.HANGUP
@@ -58,7 +89,7 @@ class VoiceBotServicer(voicebot_pb2_grpc.VoiceBotServicer):
                     )
                     break
 
-        print(f"[{call_id}] StreamCall ended")
+        print(f"[{call_id if not multiplexed else 'multiplexed'}] StreamCall ended")
 
 
 def serve():
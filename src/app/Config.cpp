@@ -1,7 +1,11 @@
 #include "Config.h"
 #include "Logger.h"
+#include <cstdlib>
 #include <iostream>
 
+// Windows UplinkAggregator can fill, up to its 800-byte (100 ms) chunk
+static const int kUplinkAggregationMs[] = {20, 40, 60, 100};
+
 Config &Config::instance() {
   static Config instance;
   return instance;
@@ -13,10 +17,41 @@ bool Config::load(const std::string &path) {
 
     bindIp = config["bind_ip"].as<std::string>("0.0.0.0");
     sipPort = config["sip_port"].as<int>(5060);
+    sipThreads = config["sip_threads"].as<int>(1);
     rtpPortStart = config["rtp_port_start"].as<int>(20000);
     rtpPortEnd = config["rtp_port_end"].as<int>(30000);
     maxCalls = config["max_calls"].as<int>(200);
+    rtpIoBackend = config["rtp_io_backend"].as<std::string>("epoll");
+    rtpBatchIo = config["rtp_batch_io"].as<bool>(true);
+    rtpBatchSize = config["rtp_batch_size"].as<int>(32);
+    rtpSocketPoolSize = config["rtp_socket_pool_size"].as<int>(16);
+    rtpPortQuarantineMs = config["rtp_port_quarantine_ms"].as<int>(2000);
+    rtpCommandQueueSize = config["rtp_command_queue_size"].as<int>(4096);
+    rtpMediaTickMs = config["rtp_media_tick_ms"].as<int>(5);
+    rtpMediaClock = config["rtp_media_clock"].as<std::string>("real");
+    jitterMinDelayMs = config["jitter_min_delay_ms"].as<int>(20);
+    jitterMaxDelayMs = config["jitter_max_delay_ms"].as<int>(200);
+    g711Kernel = config["g711_kernel"].as<std::string>("auto");
+    uplinkAggregationMs = config["uplink_aggregation_ms"].as<int>(20);
+    int aggregationMs = kUplinkAggregationMs[0];
+    for (int ms : kUplinkAggregationMs) {
+      if (std::abs(ms - uplinkAggregationMs) <
+          std::abs(aggregationMs - uplinkAggregationMs))
+        aggregationMs = ms;
+    }
+    if (aggregationMs != uplinkAggregationMs) {
+      LOG_WARN("Unsupported uplink_aggregation_ms " << uplinkAggregationMs
+                                                    << ", using "
+                                                    << aggregationMs);
+      uplinkAggregationMs = aggregationMs;
+    }
     grpcTarget = config["grpc_target"].as<std::string>("127.0.0.1:50051");
+    grpcUplinkQueueFrames = config["grpc_uplink_queue_frames"].as<int>(50);
+    grpcChannelPoolSize = config["grpc_channel_pool_size"].as<int>(4);
+    grpcKeepaliveMs = config["grpc_keepalive_ms"].as<int>(300000);
+    grpcStreamPoolSize = config["grpc_stream_pool_size"].as<int>(4);
+    grpcMuxStreams = config["grpc_mux_streams"].as<int>(0);
+    grpcMuxCallsPerStream = config["grpc_mux_calls_per_stream"].as<int>(64);
 
     if (config["codec_preference"]) {
       codecPreference =
@@ -34,6 +69,12 @@ bool Config::load(const std::string &path) {
     }
 
     audiosocketTarget = config["audiosocket_target"].as<std::string>(config["tcp_target"].as<std::string>(""));
+    audiosocketUplinkGain = config["audiosocket_uplink_gain"].as<float>(3.0f);
+    audiosocketDownlinkGain = config["audiosocket_downlink_gain"].as<float>(3.0f);
+    audiosocketReactorThreads = config["audiosocket_reactor_threads"].as<int>(2);
+    audiosocketPoolMin = config["audiosocket_pool_min"].as<int>(2);
+    audiosocketPoolMax = config["audiosocket_pool_max"].as<int>(16);
+    audiosocketPoolMaxIdleMs = config["audiosocket_pool_max_idle_ms"].as<int>(30000);
     recordingMode = config["recording_mode"].as<bool>(false);
     recordingPath = config["recording_path"].as<std::string>("./recordings");
     logLevel = config["log_level"].as<std::string>("INFO");
@@ -11,14 +11,39 @@ public:
 
   std::string bindIp;
   int sipPort;
+  int sipThreads;
   int rtpPortStart;
   int rtpPortEnd;
   int maxCalls;
+  std::string rtpIoBackend;
+  bool rtpBatchIo;
+  int rtpBatchSize;
+  int rtpSocketPoolSize;
+  int rtpPortQuarantineMs;
+  int rtpCommandQueueSize;
+  int rtpMediaTickMs;
+  std::string rtpMediaClock;
+  int jitterMinDelayMs;
+  int jitterMaxDelayMs;
+  std::string g711Kernel;
+  int uplinkAggregationMs;
   std::string grpcTarget;
+  int grpcUplinkQueueFrames;
+  int grpcChannelPoolSize;
+  int grpcKeepaliveMs;
+  int grpcStreamPoolSize;
+  int grpcMuxStreams;
+  int grpcMuxCallsPerStream;
   std::vector<std::string> codecPreference;
   enum class GatewayMode { ECHO, GRPC, AUDIOSOCKET };
   GatewayMode mode;
   std::string audiosocketTarget;
+  float audiosocketUplinkGain;
+  float audiosocketDownlinkGain;
+  int audiosocketReactorThreads;
+  int audiosocketPoolMin;
+  int audiosocketPoolMax;
+  int audiosocketPoolMaxIdleMs;
   bool recordingMode;
   std::string recordingPath;
   std::string logLevel;
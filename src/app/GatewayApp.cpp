@@ -1,17 +1,27 @@
 #include "GatewayApp.h"
+#include "../audiosocket/AudioSocketPool.h"
+#include "../audiosocket/AudioSocketReactor.h"
 #include "../call/CallRegistry.h"
 #include "../call/CallSession.h"
+#include "../grpc/ChannelPool.h"
+#include "../grpc/StreamPool.h"
 #include "../rtp/RtpServer.h"
 #include "../sdp/SdpAnswer.h"
 #include "../sdp/SdpParser.h"
-#include "../sip/SipResponseBuilder.h"
+#include "../util/G711Utils.h"
 #include "../util/Net.h"
 #include "Config.h"
 #include "Logger.h"
 #include "SignalHandler.h"
+#include <algorithm>
 #include <csignal>
+#include <cstdlib>
 #include <iostream>
 
+// SipServer::poll returns as soon as a datagram arrives; the timeout only
+// bounds how late transaction timers and shutdown are noticed
+static const int kSipPollTimeoutMs = 100;
+
 GatewayApp::GatewayApp() {}
 
 GatewayApp::~GatewayApp() {
@@ -36,20 +46,85 @@ bool GatewayApp::init(const std::string &configPath) {
     Logger::instance().setLevel(LogLevel::INFO);
 
   // Init RTP Server
-  RtpServer::instance().init(config.rtpPortStart, config.rtpPortEnd);
-  RtpServer::instance().setPacketHandler(
-      [this](int port, const RtpPacket &pkt, const sockaddr_in &sender) {
-        this->handleRtpPacket(port, pkt, sender);
-      });
+  RtpWorkerOptions rtpOptions;
+  rtpOptions.ioBackend = config.rtpIoBackend == "io_uring"
+                             ? RtpIoBackend::IO_URING
+                             : RtpIoBackend::EPOLL;
+  rtpOptions.batchIo = config.rtpBatchIo;
+  rtpOptions.batchSize = config.rtpBatchSize;
+  rtpOptions.socketPoolSize = config.rtpSocketPoolSize;
+  rtpOptions.portQuarantineMs = config.rtpPortQuarantineMs;
+  rtpOptions.commandQueueSize = config.rtpCommandQueueSize;
+  rtpOptions.mediaTickMs = config.rtpMediaTickMs;
+  rtpOptions.virtualClock = config.rtpMediaClock == "virtual";
+  RtpServer::instance().init(config.rtpPortStart, config.rtpPortEnd, rtpOptions);
+
+  if (config.g711Kernel != "auto") {
+    using Kernel = G711Utils::Kernel;
+    bool found = false;
+    for (Kernel k : {Kernel::Scalar, Kernel::Lut, Kernel::Sse41, Kernel::Avx2,
+                     Kernel::Neon}) {
+      if (config.g711Kernel == G711Utils::kernelName(k)) {
+        found = true;
+        if (!G711Utils::setKernel(k))
+          LOG_WARN("G.711 kernel " << config.g711Kernel
+                                   << " not supported on this CPU");
+      }
+    }
+    if (!found)
+      LOG_WARN("Unknown g711_kernel " << config.g711Kernel);
+  }
+  LOG_INFO("G.711 kernel: " << G711Utils::kernelName(G711Utils::kernel()));
+
+  // Connect to the bot up front so calls don't wait on the handshake or
+  // the stream setup
+  ChannelPool::instance().init(config.grpcChannelPoolSize,
+                               config.grpcKeepaliveMs);
+  StreamPool::instance().init(
+      config.grpcStreamPoolSize, config.grpcUplinkQueueFrames,
+      config.grpcMuxStreams, config.grpcMuxCallsPerStream);
+  if (config.mode == Config::GatewayMode::GRPC) {
+    ChannelPool::instance().warm(config.grpcTarget);
+    StreamPool::instance().warm(config.grpcTarget);
+  }
+  AudioSocketPool::instance().init(config.audiosocketPoolMin,
+                                   config.audiosocketPoolMax,
+                                   config.audiosocketPoolMaxIdleMs);
+  if (config.mode == Config::GatewayMode::AUDIOSOCKET) {
+    AudioSocketReactor::instance().init(config.audiosocketReactorThreads);
+    AudioSocketPool::instance().warm(config.audiosocketTarget);
+  }
 
   // Init SIP Server
-  sipServer_ = std::make_unique<SipServer>(config.sipPort);
-  sipServer_->setRequestHandler(
-      [this](const SipMessage &msg, const sockaddr_in &sender) {
-        this->handleSipMessage(msg, sender);
+  sdpAnswerHeaders_ = "Content-Type: application/sdp\r\nContact: <sip:" +
+                      config.bindIp + ":" + std::to_string(config.sipPort) +
+                      ">\r\n";
+  int sipThreads = std::max(1, config.sipThreads);
+  for (int i = 0; i < sipThreads; ++i) {
+    auto shard = std::make_unique<SipShard>();
+    shard->server = std::make_unique<SipServer>(config.sipPort, sipThreads > 1);
+    SipShard *owner = shard.get();
+    shard->transactions.setRetransmit(
+        [owner](const std::string &wire, const sockaddr_in &dest) {
+          owner->server->resendResponse(wire, dest);
+        });
+    shard->server->setRequestHandler(
+        [this, owner](const SipMessage &msg, const sockaddr_in &sender) {
+          this->handleSipMessage(*owner, msg, sender);
+        });
+    if (sipThreads > 1) {
+      shard->server->setRouter([this](std::string_view callId) {
+        size_t h = std::hash<std::string_view>()(callId);
+        return sipShards_[h % sipShards_.size()]->server.get();
       });
-
-  return sipServer_->start();
+    }
+    if (!shard->server->start())
+      return false;
+    sipShards_.push_back(std::move(shard));
+  }
+  if (sipThreads > 1)
+    LOG_INFO("SIP handled by " << sipThreads << " threads");
+  return true;
 }
 
 void GatewayApp::run() {
@@ -58,200 +133,155 @@ void GatewayApp::run() {
 
   LOG_INFO("Gateway running. Press Ctrl+C to exit.");
 
-  while (running_ && !SignalHandler::shouldExit()) {
-    sipServer_->poll();
-    cleanupTransactions();
-    std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Reduce CPU spin
-  }
+  // The main thread runs the first shard
+  for (size_t i = 1; i < sipShards_.size(); ++i)
+    sipShards_[i]->thread =
+        std::thread(&GatewayApp::runShard, this, std::ref(*sipShards_[i]));
+  runShard(*sipShards_[0]);
 
   running_ = false;
+  for (auto &shard : sipShards_) {
+    if (shard->thread.joinable())
+      shard->thread.join();
+  }
   LOG_INFO("Shutting down...");
+  CallRegistry::instance().removeAll();
+  if (Config::instance().mode == Config::GatewayMode::GRPC)
+    StreamPool::instance().logStats();
+  else if (Config::instance().mode == Config::GatewayMode::AUDIOSOCKET)
+    AudioSocketPool::instance().logStats();
+  StreamPool::instance().shutdown();
+  AudioSocketPool::instance().shutdown();
+  AudioSocketReactor::instance().shutdown();
+}
+
+void GatewayApp::runShard(SipShard &shard) {
+  while (running_ && !SignalHandler::shouldExit()) {
+    shard.server->poll(kSipPollTimeoutMs);
+    shard.transactions.advance(std::chrono::steady_clock::now());
+  }
 }
 
-void GatewayApp::handleSipMessage(const SipMessage &msg,
+void GatewayApp::handleSipMessage(SipShard &shard, const SipMessage &msg,
                                   const sockaddr_in &sender) {
-  std::string callId = msg.getCallId();
+  std::string callId(msg.getCallId());
   if (callId.empty())
     return;
 
-  std::string branch = msg.getBranch();
-  std::string txKey = callId + ":" + branch + ":" + msg.methodStr;
+  uint64_t transaction = SipTransactionTable::keyFor(msg);
 
   auto session = CallRegistry::instance().getCall(callId);
 
-  {
-    std::lock_guard<std::mutex> lock(transactionsMutex_);
-    if (msg.isRequest) {
-      auto txIt = transactions_.find(txKey);
-      if (txIt != transactions_.end()) {
-        if (txIt->second->shouldResendResponse(msg)) {
-          auto res = txIt->second->getLastResponse();
-          if (res) {
-            LOG_INFO("Resending retransmission for " << txKey);
-            sipServer_->sendResponse(*res, sender);
-            return;
-          }
+  if (msg.isRequest) {
+    if (msg.method == SipMethod::ACK) {
+      // Matches the INVITE only when it acknowledges a non-2xx; an ACK
+      // for a 2xx is its own transaction and finds nothing
+      shard.transactions.requestReceived(transaction, msg);
+      return;
+    }
+    if (auto *existing = shard.transactions.find(transaction)) {
+      if (existing->shouldResendResponse(msg)) {
+        const auto &res = existing->getLastResponse();
+        if (!res.empty()) {
+          LOG_INFO("Resending retransmission for " << callId << " "
+                                                   << msg.methodStr());
+          shard.server->resendResponse(res, sender);
         }
-        if (msg.method != SipMethod::ACK) return;
       }
+      return;
+    }
+    shard.transactions.insert(transaction, msg);
 
-      auto transaction = std::make_shared<SipTransaction>(msg);
-      if (msg.method != SipMethod::ACK) {
-        transactions_[txKey] = transaction;
+    if (msg.method == SipMethod::INVITE) {
+      if (!session) {
+        if (CallRegistry::instance().count() >= Config::instance().maxCalls) {
+          respond(shard, msg, transaction, sender, 486, "Busy Here");
+          return;
+        }
+        session = std::make_shared<CallSession>(callId);
+        session->init(msg, sender);
+        CallRegistry::instance().addCall(callId, session);
       }
 
-      if (msg.method == SipMethod::INVITE) {
-        if (!session) {
-          if (CallRegistry::instance().count() >= Config::instance().maxCalls) {
-            auto res = SipResponseBuilder::createResponse(msg, 486, "Busy Here");
-            transaction->sendResponse(res);
-            sipServer_->sendResponse(res, sender);
-            return;
-          }
-          session = std::make_shared<CallSession>(callId);
-          session->init(msg, sender);
-          CallRegistry::instance().addCall(callId, session);
-        }
+      respond(shard, msg, transaction, sender, 100, "Trying");
 
-        auto tryingRes = SipResponseBuilder::createResponse(msg, 100, "Trying");
-        transaction->sendResponse(tryingRes);
-        sipServer_->sendResponse(tryingRes, sender);
+      auto sdpOpt = SdpParser::parse(std::string(msg.body()));
+      if (!sdpOpt) {
+        respond(shard, msg, transaction, sender, 400, "Bad Request (No SDP)");
+        CallRegistry::instance().removeCall(callId);
+        return;
+      }
 
-        auto sdpOpt = SdpParser::parse(msg.body);
-        if (!sdpOpt) {
-          auto badRes = SipResponseBuilder::createResponse(msg, 400, "Bad Request (No SDP)");
-          transaction->sendResponse(badRes);
-          sipServer_->sendResponse(badRes, sender);
-          CallRegistry::instance().removeCall(callId);
-          return;
-        }
+      NegotiatedCodec codec;
+      int localRtpPort = RtpServer::instance().allocatePort(session);
+      if (localRtpPort < 0) {
+        respond(shard, msg, transaction, sender, 500, "Internal Server Error (No Ports)");
+        CallRegistry::instance().removeCall(callId);
+        return;
+      }
 
-        NegotiatedCodec codec;
-        int localRtpPort = RtpServer::instance().allocatePort();
-        if (localRtpPort < 0) {
-          auto errRes = SipResponseBuilder::createResponse(msg, 500, "Internal Server Error (No Ports)");
-          transaction->sendResponse(errRes);
-          sipServer_->sendResponse(errRes, sender);
-          CallRegistry::instance().removeCall(callId);
-          return;
-        }
+      LOG_DEBUG("Allocated RTP port " << localRtpPort << " for call " << callId);
 
-        CallRegistry::instance().registerRtpPort(localRtpPort, callId);
-        LOG_DEBUG("Allocated RTP port " << localRtpPort << " for call " << callId);
+      std::string sdpAnswer = SdpAnswer::generate(
+          *sdpOpt, Config::instance().bindIp, localRtpPort,
+          Config::instance().codecPreference, codec);
 
-        std::string sdpAnswer = SdpAnswer::generate(
-            *sdpOpt, Config::instance().bindIp, localRtpPort,
-            Config::instance().codecPreference, codec);
+      if (sdpAnswer.empty()) {
+        respond(shard, msg, transaction, sender, 488, "Not Acceptable Here");
+        RtpServer::instance().releasePort(localRtpPort);
+        CallRegistry::instance().removeCall(callId);
+        return;
+      }
 
-        if (sdpAnswer.empty()) {
-          auto errRes = SipResponseBuilder::createResponse(msg, 488, "Not Acceptable Here");
-          transaction->sendResponse(errRes);
-          sipServer_->sendResponse(errRes, sender);
-          RtpServer::instance().releasePort(localRtpPort);
-          CallRegistry::instance().removeCall(callId);
-          return;
-        }
+      std::string remoteIp = sdpOpt->connectionIp;
+      int remotePort = 0;
+      for (auto &m : sdpOpt->media)
+        if (m.type == "audio")
+          remotePort = m.port;
 
-        std::string remoteIp = sdpOpt->connectionIp;
-        int remotePort = 0;
-        for (auto &m : sdpOpt->media)
-          if (m.type == "audio")
-            remotePort = m.port;
-
-        session->startPipeline(localRtpPort, remoteIp, remotePort,
-                               codec.payloadType);
-
-        auto res = SipResponseBuilder::createResponse(msg, 200, "OK");
-        res.addHeader("Content-Type", "application/sdp");
-        res.addHeader("Contact", "<sip:" + Config::instance().bindIp + ":" +
-                                     std::to_string(Config::instance().sipPort) +
-                                     ">");
-        res.body = sdpAnswer;
-        transaction->sendResponse(res);
-        sipServer_->sendResponse(res, sender);
-
-      } else if (msg.method == SipMethod::BYE) {
-        auto res = SipResponseBuilder::createResponse(msg, 200, "OK");
-        transaction->sendResponse(res);
-        sipServer_->sendResponse(res, sender);
-        if (session) {
-          session->onSipMessage(msg, sender);
-          CallRegistry::instance().removeCall(callId);
-        }
-      } else if (msg.method == SipMethod::CANCEL) {
-        auto res = SipResponseBuilder::createResponse(msg, 200, "OK");
-        transaction->sendResponse(res);
-        sipServer_->sendResponse(res, sender);
-        if (session) {
-          CallRegistry::instance().removeCall(callId);
-        }
-      } else if (msg.method == SipMethod::ACK) {
-        std::string inviteTxKey = callId + ":" + branch + ":INVITE";
-        auto it = transactions_.find(inviteTxKey);
-        if (it != transactions_.end()) {
-            it->second->receiveRequest(msg);
-        }
-      } else if (msg.method == SipMethod::REFER) {
-        auto res = SipResponseBuilder::createResponse(msg, 202, "Accepted");
-        transaction->sendResponse(res);
-        sipServer_->sendResponse(res, sender);
-        LOG_INFO("Received REFER, blind transfer support minimal.");
-      } else if (msg.method == SipMethod::OPTIONS) {
-        auto res = SipResponseBuilder::createResponse(msg, 200, "OK");
-        transaction->sendResponse(res);
-        sipServer_->sendResponse(res, sender);
-      } else {
-        auto res = SipResponseBuilder::createResponse(msg, 501, "Not Implemented");
-        transaction->sendResponse(res);
-        sipServer_->sendResponse(res, sender);
+      session->startPipeline(localRtpPort, remoteIp, remotePort,
+                             codec.payloadType);
+
+      respond(shard, msg, transaction, sender, 200, "OK", sdpAnswerHeaders_,
+              sdpAnswer);
+
+    } else if (msg.method == SipMethod::BYE) {
+      respond(shard, msg, transaction, sender, 200, "OK");
+      if (session) {
+        session->onSipMessage(msg, sender);
+        CallRegistry::instance().removeCall(callId);
       }
-    } else {
-      std::string resBranch = msg.getBranch();
-      std::string resTxKey = callId + ":" + resBranch + ":" + msg.methodStr;
-      auto it = transactions_.find(resTxKey);
-      if (it != transactions_.end()) {
-        LOG_DEBUG("Received response " << msg.statusCode << " for transaction " << resTxKey);
-        it->second->receiveResponse(msg);
-      } else {
-        LOG_WARN("Received response for unknown transaction: " << resTxKey);
+    } else if (msg.method == SipMethod::CANCEL) {
+      respond(shard, msg, transaction, sender, 200, "OK");
+      if (session) {
+        CallRegistry::instance().removeCall(callId);
       }
+    } else if (msg.method == SipMethod::REFER) {
+      respond(shard, msg, transaction, sender, 202, "Accepted");
+      LOG_INFO("Received REFER, blind transfer support minimal.");
+    } else if (msg.method == SipMethod::OPTIONS) {
+      respond(shard, msg, transaction, sender, 200, "OK");
+    } else {
+      respond(shard, msg, transaction, sender, 501, "Not Implemented");
     }
-  }
-}
-
-void GatewayApp::cleanupTransactions() {
-  static auto lastCleanup = std::chrono::steady_clock::now();
-  auto now = std::chrono::steady_clock::now();
-  
-  if (std::chrono::duration_cast<std::chrono::seconds>(now - lastCleanup).count() < 5) {
-    return;
-  }
-  lastCleanup = now;
-
-  std::lock_guard<std::mutex> lock(transactionsMutex_);
-  for (auto it = transactions_.begin(); it != transactions_.end(); ) {
-    auto state = it->second->getState();
-    auto lastActive = it->second->getLastActive();
-    auto age = std::chrono::duration_cast<std::chrono::seconds>(now - lastActive).count();
-
-    if ((state == TransactionState::TERMINATED || state == TransactionState::COMPLETED || state == TransactionState::CONFIRMED) && age > 32) {
-      LOG_DEBUG("Cleaning up transaction " << it->first);
-      it = transactions_.erase(it);
-    } else if (age > 64) {
-      LOG_DEBUG("Cleaning up expired transaction " << it->first);
-      it = transactions_.erase(it);
+  } else {
+    if (shard.transactions.find(transaction)) {
+      LOG_DEBUG("Received response " << msg.statusCode << " for call " << callId);
+      shard.transactions.responseReceived(transaction, msg);
     } else {
-      ++it;
+      LOG_WARN("Received response for unknown transaction in call " << callId);
     }
   }
 }
 
-void GatewayApp::handleRtpPacket(int localPort, const RtpPacket &pkt,
-                                 const sockaddr_in &sender) {
-  auto session = CallRegistry::instance().getCallByPort(localPort);
-  if (session) {
-    session->onRtpPacket(pkt, sender);
-  }
+void GatewayApp::respond(SipShard &shard, const SipMessage &req,
+                         uint64_t transaction, const sockaddr_in &dest,
+                         int code, std::string_view phrase,
+                         std::string_view extraHeaders,
+                         std::string_view body) {
+  auto wire =
+      shard.server->sendResponse(req, code, phrase, dest, extraHeaders, body);
+  shard.transactions.responseSent(transaction, code, wire, dest);
 }
 
 void GatewayApp::cliLoop() {
@@ -260,6 +290,13 @@ void GatewayApp::cliLoop() {
     if (line == "list") {
       LOG_INFO("Active Calls: " << CallRegistry::instance().count());
       // TODO: List IDs
+    } else if (line == "stats") {
+      RtpServer::instance().logStats();
+      StreamPool::instance().logStats();
+      AudioSocketPool::instance().logStats();
+    } else if (line.find("tick ") == 0) {
+      // Step the media clock when running with rtp_media_clock: "virtual"
+      RtpServer::instance().advanceVirtualClock(std::atoi(line.substr(5).c_str()));
     } else if (line.find("cut ") == 0) {
       std::string id = line.substr(4);
       CallRegistry::instance().removeCall(id);
@@ -2,13 +2,16 @@
 
 #include "../rtp/RtpPacket.h"
 #include "../sip/SipServer.h"
-#include "../sip/SipTransaction.h"
+#include "../sip/SipTransactionTable.h"
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <memory>
-#include <mutex>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 class GatewayApp {
 public:
@@ -19,17 +22,26 @@ public:
   void run();
 
 private:
-  void handleSipMessage(const SipMessage &msg, const sockaddr_in &sender);
-  void handleRtpPacket(int localPort, const RtpPacket &pkt,
-                      const sockaddr_in &sender);
+  // One per SIP thread. Messages are routed to a shard by Call-ID, so a
+  // shard's transactions are only ever touched by its own thread.
+  struct SipShard {
+    std::unique_ptr<SipServer> server;
+    SipTransactionTable transactions;
+    std::thread thread;
+  };
+
+  void runShard(SipShard &shard);
+  void handleSipMessage(SipShard &shard, const SipMessage &msg,
+                        const sockaddr_in &sender);
+  // Sends the response and records it on the transaction
+  void respond(SipShard &shard, const SipMessage &req, uint64_t transaction,
+               const sockaddr_in &dest, int code, std::string_view phrase,
+               std::string_view extraHeaders = {}, std::string_view body = {});
   void cliLoop();
 
-  std::unique_ptr<SipServer> sipServer_;
+  std::vector<std::unique_ptr<SipShard>> sipShards_;
+  // Content-Type and Contact of the 200 OK to an INVITE, built once
+  std::string sdpAnswerHeaders_;
   std::atomic<bool> running_{false};
   std::thread cliThread_;
-
-  std::mutex transactionsMutex_;
-  std::map<std::string, std::shared_ptr<SipTransaction>> transactions_;
-  
-  void cleanupTransactions();
 };
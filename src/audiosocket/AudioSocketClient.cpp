@@ -1,16 +1,27 @@
 #include "AudioSocketClient.h"
 #include "../app/Logger.h"
 #include <sys/socket.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <cerrno>
 #include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <chrono>
 
+// AudioSocket frame types
+static const uint8_t kTypeTerminate = 0x00;
+static const uint8_t kTypeUuid = 0x01;
+static const uint8_t kTypeAudio = 0x10;
+
+// Enough for 100 ms of PCM16 per read before the buffer has to grow
+static const size_t kRxInitialBytes = 4096;
+
 AudioSocketClient::AudioSocketClient(const std::string& target, const std::string& callId, 
                                      const std::string& fromUser, const std::string& toUser)
-    : target_(target), callId_(callId), fromUser_(fromUser), toUser_(toUser) {}
+    : target_(target), callId_(callId), fromUser_(fromUser), toUser_(toUser),
+      rx_(kRxInitialBytes) {}
 
 AudioSocketClient::~AudioSocketClient() {
     stop();
@@ -38,37 +49,78 @@ bool AudioSocketClient::connect() {
         return false;
     }
 
+    // Audio frames are small and latency bound, don't let Nagle hold them
+    int one = 1;
+    if (setsockopt(sockfd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+        LOG_WARN("Failed to set TCP_NODELAY for AudioSocket " << describe());
+    }
+    // A connection can sit idle in the pool, so notice a dead server well
+    // before the call needs it
+    setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+#ifdef __linux__
+    int idleSec = 10, intervalSec = 5, probes = 3;
+    setsockopt(sockfd_, IPPROTO_TCP, TCP_KEEPIDLE, &idleSec, sizeof(idleSec));
+    setsockopt(sockfd_, IPPROTO_TCP, TCP_KEEPINTVL, &intervalSec, sizeof(intervalSec));
+    setsockopt(sockfd_, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes));
+#endif
+
     running_ = true;
-    readerThread_ = std::thread(&AudioSocketClient::readerLoop, this);
-    
-    sendUuid();
-    
+    if (!AudioSocketReactor::instance().add(sockfd_, this)) {
+        running_ = false;
+        close(sockfd_);
+        sockfd_ = -1;
+        return false;
+    }
+    registered_ = true;
     return true;
 }
 
+void AudioSocketClient::bind(const std::string& callId, const std::string& fromUser,
+                             const std::string& toUser) {
+    std::lock_guard<std::mutex> lock(idMutex_);
+    callId_ = callId;
+    fromUser_ = fromUser;
+    toUser_ = toUser;
+}
+
+std::string AudioSocketClient::describe() const {
+    std::lock_guard<std::mutex> lock(idMutex_);
+    return "for call " + (callId_.empty() ? std::string("(unbound)") : callId_);
+}
+
+void AudioSocketClient::setAudioCallback(AudioCallback cb) {
+    std::lock_guard<std::mutex> lock(callbackMutex_);
+    audioCb_ = std::move(cb);
+}
+
 void AudioSocketClient::stop() {
-    if (!running_) return;
+    // After remove() returns no read is in flight and none will start
+    if (registered_) {
+        AudioSocketReactor::instance().remove(sockfd_);
+        registered_ = false;
+    }
     running_ = false;
 
+    std::lock_guard<std::mutex> lock(sendMutex_);
     if (sockfd_ >= 0) {
-        // Send terminate packet 0x00 0x00 0x00
-        char terminate[3] = {0, 0, 0};
-        sendAll(terminate, 3);
+        sendFrame(kTypeTerminate, nullptr, 0);
         shutdown(sockfd_, SHUT_RDWR);
         close(sockfd_);
         sockfd_ = -1;
     }
-
-    if (readerThread_.joinable()) {
-        readerThread_.join();
-    }
 }
 
 void AudioSocketClient::sendUuid() {
     // Required format: dialer (10) + epoch (7) + dialed (15) = 32 chars
-    
+    std::string callId, dialer, dialed;
+    {
+        std::lock_guard<std::mutex> lock(idMutex_);
+        callId = callId_;
+        dialer = fromUser_;
+        dialed = toUser_;
+    }
+
     // 1. Format Dialer (10 digits, zero-padded)
-    std::string dialer = fromUser_;
     if (dialer.size() > 10) dialer = dialer.substr(dialer.size() - 10);
     std::ostringstream ds;
     ds << std::setw(10) << std::setfill('0') << dialer;
@@ -82,77 +134,120 @@ void AudioSocketClient::sendUuid() {
     es << std::setw(7) << std::setfill('0') << epochStr;
     
     // 3. Format Dialed (15 digits, zero-padded)
-    std::string dialed = toUser_;
     if (dialed.size() > 15) dialed = dialed.substr(dialed.size() - 15);
     std::ostringstream dds;
     dds << std::setw(15) << std::setfill('0') << dialed;
     
     std::string payload = ds.str() + es.str() + dds.str();
-    
-    unsigned char header[3];
-    header[0] = 0x01; // UUID Type
-    header[1] = 0x00;
-    header[2] = 0x20; // Length 32 (0x20)
-
-    std::vector<char> packet;
-    packet.insert(packet.end(), header, header + 3);
-    packet.insert(packet.end(), payload.begin(), payload.end());
 
-    LOG_INFO("Sending UUID: " << payload << " for call " << callId_);
-    sendAll(packet.data(), packet.size());
+    LOG_INFO("Sending UUID: " << payload << " for call " << callId);
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    if (sockfd_ < 0) return;
+    sendFrame(kTypeUuid, payload.data(), payload.size());
 }
 
 void AudioSocketClient::sendAudio(const std::vector<char>& pcmData) {
-    if (sockfd_ < 0 || pcmData.empty()) return;
+    sendAudio(reinterpret_cast<const int16_t*>(pcmData.data()), pcmData.size() / 2);
+}
 
-    size_t len = pcmData.size();
-    if (len > 0xFFFF) len = 0xFFFF; // Cap at max 16-bit length
+void AudioSocketClient::sendAudio(const int16_t* pcm, size_t samples) {
+    if (samples == 0) return;
 
-    unsigned char header[3];
-    header[0] = 0x10; // Audio Type
-    header[1] = (len >> 8) & 0xFF;
-    header[2] = len & 0xFF;
+    size_t len = samples * 2;
+    if (len > 0xFFFF) len = 0xFFFF; // Cap at max 16-bit length
 
     std::lock_guard<std::mutex> lock(sendMutex_);
-    sendAll((const char*)header, 3);
-    sendAll(pcmData.data(), len);
+    if (sockfd_ < 0) return;
+    sendFrame(kTypeAudio, pcm, len);
 }
 
-bool AudioSocketClient::sendAll(const char* data, size_t len) {
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t n = send(sockfd_, data + sent, len - sent, 0);
+// sendMutex_ held. Header and payload go out in one sendmsg, so each frame
+// is a single segment; a peer that went away fails the send rather than
+// raising SIGPIPE.
+bool AudioSocketClient::sendFrame(uint8_t type, const void *payload, size_t len) {
+    unsigned char header[kHeaderBytes];
+    header[0] = type;
+    header[1] = (len >> 8) & 0xFF;
+    header[2] = len & 0xFF;
+
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = kHeaderBytes;
+    iov[1].iov_base = const_cast<void *>(payload);
+    iov[1].iov_len = len;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = len > 0 ? 2 : 1;
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t n = sendmsg(sockfd_, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
         if (n <= 0) return false;
-        sent += n;
+        // Partial write: skip what went out
+        while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov->iov_len) {
+            n -= msg.msg_iov->iov_len;
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = static_cast<char *>(msg.msg_iov->iov_base) + n;
+            msg.msg_iov->iov_len -= n;
+        }
     }
     return true;
 }
 
-void AudioSocketClient::readerLoop() {
-    while (running_) {
-        unsigned char header[3];
-        ssize_t n = recv(sockfd_, header, 3, MSG_WAITALL);
-        if (n <= 0) break;
-
-        unsigned char type = header[0];
-        uint16_t len = (header[1] << 8) | header[2];
-
-        if (len > 0) {
-            std::vector<char> payload(len);
-            ssize_t pn = recv(sockfd_, payload.data(), len, MSG_WAITALL);
-            if (pn <= 0) break;
-
-            if (type == 0x10 && audioCb_) {
-                audioCb_(payload);
-            } else if (type == 0x00) {
-                LOG_INFO("AudioSocket received terminate");
-                break;
-            }
-        } else if (type == 0x00) {
-            LOG_INFO("AudioSocket received terminate (no payload)");
-            break;
+bool AudioSocketClient::onReadable() {
+    for (;;) {
+        ssize_t n = recv(sockfd_, rx_.data() + rxFill_, rx_.size() - rxFill_,
+                         MSG_DONTWAIT);
+        if (n > 0) {
+            rxFill_ += n;
+            if (!parseFrames()) break;
+            continue;
         }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        break; // closed or failed
     }
     running_ = false;
-    LOG_INFO("AudioSocket reader loop stopped for call " << callId_);
+    LOG_INFO("AudioSocket connection ended " << describe());
+    return false;
+}
+
+// Hands every complete frame in rx_ to its consumer and keeps a trailing
+// partial one, growing rx_ if that frame doesn't fit. Returns false on
+// terminate.
+bool AudioSocketClient::parseFrames() {
+    size_t pos = 0;
+    bool open = true;
+    while (rxFill_ - pos >= kHeaderBytes) {
+        const unsigned char *header =
+            reinterpret_cast<const unsigned char *>(rx_.data() + pos);
+        size_t len = (header[1] << 8) | header[2];
+        if (rxFill_ - pos < kHeaderBytes + len) break;
+
+        if (header[0] == kTypeAudio) {
+            std::lock_guard<std::mutex> lock(callbackMutex_);
+            if (audioCb_) audioCb_(rx_.data() + pos + kHeaderBytes, len);
+        } else if (header[0] == kTypeTerminate) {
+            LOG_INFO("AudioSocket received terminate");
+            open = false;
+            break;
+        }
+        pos += kHeaderBytes + len;
+    }
+
+    if (pos > 0) {
+        memmove(rx_.data(), rx_.data() + pos, rxFill_ - pos);
+        rxFill_ -= pos;
+    }
+    if (open && rxFill_ >= kHeaderBytes) {
+        const unsigned char *header =
+            reinterpret_cast<const unsigned char *>(rx_.data());
+        size_t need = kHeaderBytes + ((header[1] << 8) | header[2]);
+        if (need > rx_.size()) rx_.resize(need);
+    }
+    return open;
 }
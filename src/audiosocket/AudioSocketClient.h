@@ -1,39 +1,73 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <thread>
 #include <atomic>
 #include <functional>
 #include <mutex>
 #include <netinet/in.h>
 
-class AudioSocketClient {
+#include "AudioSocketReactor.h"
+
+// One call's AudioSocket connection. Incoming frames are read by the shared
+// AudioSocketReactor; sends happen on the caller's thread. A connection may
+// be opened ahead of its call (see AudioSocketPool): the call is attached
+// with bind() and announced to the server with sendUuid().
+class AudioSocketClient : private AudioSocketReactor::Handler {
 public:
-    using AudioCallback = std::function<void(const std::vector<char>&)>;
+    // Audio payload (PCM16 little endian), valid only during the call.
+    // Runs on a reactor thread and must not block.
+    using AudioCallback = std::function<void(const char *data, size_t len)>;
 
-    AudioSocketClient(const std::string& target, const std::string& callId, 
-                       const std::string& fromUser, const std::string& toUser);
+    // The call may be left empty for a pre-opened connection and set later
+    // with bind()
+    AudioSocketClient(const std::string& target, const std::string& callId = "",
+                       const std::string& fromUser = "", const std::string& toUser = "");
     ~AudioSocketClient();
 
+    // Opens the TCP connection; nothing is sent until sendUuid()
     bool connect();
+    void bind(const std::string& callId, const std::string& fromUser,
+              const std::string& toUser);
     void stop();
+    // False once the server has closed the connection
+    bool isOpen() const { return running_.load(std::memory_order_acquire); }
 
     void sendAudio(const std::vector<char>& pcmData);
+    void sendAudio(const int16_t* pcm, size_t samples);
+    // Must be the first frame of a call
     void sendUuid();
-    void setAudioCallback(AudioCallback cb) { audioCb_ = cb; }
+    void setAudioCallback(AudioCallback cb);
 
 private:
-    void readerLoop();
-    bool sendAll(const char* data, size_t len);
+    static constexpr size_t kHeaderBytes = 3;
+
+    // AudioSocketReactor::Handler
+    bool onReadable() override;
+    bool parseFrames();
+    bool sendFrame(uint8_t type, const void *payload, size_t len);
+
+    std::string describe() const;
 
     std::string target_;
+    // Written by bind(); read for logging on the reactor thread
     std::string callId_;
     std::string fromUser_;
     std::string toUser_;
+    mutable std::mutex idMutex_;
+
     int sockfd_ = -1;
-    std::atomic<bool> running_{false};
-    std::thread readerThread_;
+    std::atomic<bool> running_{false}; // false once the peer hung up
+    bool registered_ = false;          // watched by the reactor
+    std::mutex sendMutex_;             // also guards sockfd_ against stop()
+
+    // May be installed while the reactor is already reading
     AudioCallback audioCb_;
-    std::mutex sendMutex_;
+    std::mutex callbackMutex_;
+
+    // Received bytes not yet parsed into frames; reactor thread only. Grows
+    // to the largest frame seen, so steady-state reads don't allocate.
+    std::vector<char> rx_;
+    size_t rxFill_ = 0;
 };
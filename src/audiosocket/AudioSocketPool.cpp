@@ -0,0 +1,246 @@
+#include "AudioSocketPool.h"
+#include "../app/Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// How often idle connections are checked when nothing is claimed
+static const auto kMaintainInterval = std::chrono::seconds(1);
+
+AudioSocketPool &AudioSocketPool::instance() {
+  static AudioSocketPool instance;
+  return instance;
+}
+
+void AudioSocketPool::init(int minIdle, int maxIdle, int maxIdleMs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  maxIdle_ = maxIdle > 0 ? maxIdle : 0;
+  minIdle_ = std::min(minIdle > 0 ? minIdle : 0, maxIdle_);
+  maxIdleAge_ = std::chrono::milliseconds(maxIdleMs > 0 ? maxIdleMs : 30000);
+}
+
+void AudioSocketPool::warm(const std::string &target) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (shutdown_ || maxIdle_ == 0)
+    return;
+  targetFor(target);
+  LOG_INFO("Keeping " << minIdle_ << "-" << maxIdle_
+                      << " AudioSocket connections open to " << target);
+}
+
+std::shared_ptr<AudioSocketClient>
+AudioSocketPool::acquire(const std::string &target, const std::string &callId,
+                         const std::string &fromUser,
+                         const std::string &toUser) {
+  std::shared_ptr<AudioSocketClient> client;
+  std::vector<std::shared_ptr<AudioSocketClient>> stale;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!shutdown_ && maxIdle_ > 0) {
+      auto now = Clock::now();
+      Target &t = targetFor(target);
+      updateRate(t, now);
+      t.acquiresThisSecond++;
+      while (!t.idle.empty() && !client) {
+        if (t.idle.front().client->isOpen())
+          client = std::move(t.idle.front().client);
+        else
+          stale.push_back(std::move(t.idle.front().client));
+        t.idle.pop_front();
+      }
+      if (client)
+        t.owed.push_back(now);
+    }
+  }
+  wake_.notify_one();
+
+  for (auto &s : stale) {
+    s->stop();
+    stale_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (client) {
+    hits_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    // Nothing ready: connect on this thread, as without the pool
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    client = open(target);
+    if (!client)
+      return nullptr;
+  }
+  client->bind(callId, fromUser, toUser);
+  return client;
+}
+
+void AudioSocketPool::shutdown() {
+  std::map<std::string, Target> targets;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+    targets.swap(targets_);
+  }
+  wake_.notify_all();
+  if (refillThread_.joinable())
+    refillThread_.join();
+  for (auto &entry : targets) {
+    for (auto &idle : entry.second.idle)
+      idle.client->stop();
+  }
+}
+
+void AudioSocketPool::logStats() const {
+  size_t idle = 0;
+  size_t desired = 0;
+  double callsPerSecond = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &entry : targets_) {
+      idle += entry.second.idle.size();
+      desired += desiredIdle(entry.second);
+      callsPerSecond += entry.second.callsPerSecond;
+    }
+  }
+  uint64_t replaced = refillLatencyCount_.load(std::memory_order_relaxed);
+  uint64_t avgMs =
+      replaced ? refillLatencyTotalMs_.load(std::memory_order_relaxed) / replaced
+               : 0;
+  LOG_INFO("AudioSocket pool: "
+           << hits() << " hits, " << misses() << " misses, "
+           << stale_.load(std::memory_order_relaxed) << " stale, " << idle
+           << " idle (want " << desired << " at " << callsPerSecond
+           << " calls/s), " << refills_.load(std::memory_order_relaxed)
+           << " refills (" << refillFailures_.load(std::memory_order_relaxed)
+           << " failed), refill latency avg " << avgMs << " ms max "
+           << refillLatencyMaxMs_.load(std::memory_order_relaxed) << " ms");
+}
+
+AudioSocketPool::Target &AudioSocketPool::targetFor(const std::string &target) {
+  auto it = targets_.find(target);
+  if (it == targets_.end()) {
+    it = targets_.emplace(target, Target()).first;
+    it->second.secondStart = Clock::now();
+  }
+  if (!refillThread_.joinable())
+    refillThread_ = std::thread(&AudioSocketPool::refillLoop, this);
+  return it->second;
+}
+
+size_t AudioSocketPool::desiredIdle(const Target &t) const {
+  // Cover the calls that arrive while a replacement connects, with at least
+  // a second's worth of headroom for bursts
+  double windowSec =
+      std::max(1.0, 2.0 * connectMs_.load(std::memory_order_relaxed) / 1000.0);
+  size_t want = (size_t)std::ceil(t.callsPerSecond * windowSec);
+  return std::min(std::max(want, (size_t)minIdle_), (size_t)maxIdle_);
+}
+
+void AudioSocketPool::updateRate(Target &t, Clock::time_point now) {
+  double elapsed = std::chrono::duration<double>(now - t.secondStart).count();
+  if (elapsed < 1.0)
+    return;
+  // Moving average with a time constant of about five seconds
+  double weight = std::pow(0.8, elapsed);
+  t.callsPerSecond = t.callsPerSecond * weight +
+                     (t.acquiresThisSecond / elapsed) * (1.0 - weight);
+  t.acquiresThisSecond = 0;
+  t.secondStart = now;
+}
+
+void AudioSocketPool::refillLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!shutdown_) {
+    auto now = Clock::now();
+    std::vector<std::shared_ptr<AudioSocketClient>> retired;
+    const std::string *missing = nullptr;
+
+    for (auto &entry : targets_) {
+      Target &t = entry.second;
+      updateRate(t, now);
+      for (auto it = t.idle.begin(); it != t.idle.end();) {
+        if (!it->client->isOpen() || now - it->since > maxIdleAge_) {
+          stale_.fetch_add(1, std::memory_order_relaxed);
+          retired.push_back(std::move(it->client));
+          it = t.idle.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      // The call rate dropped, let the oldest go
+      size_t desired = desiredIdle(t);
+      while (t.idle.size() > desired) {
+        retired.push_back(std::move(t.idle.front().client));
+        t.idle.pop_front();
+      }
+      if (t.idle.size() + t.connecting >= desired)
+        t.owed.clear(); // nothing left to replace
+      else if (!missing)
+        missing = &entry.first;
+    }
+
+    if (retired.empty() && !missing) {
+      wake_.wait_for(lock, kMaintainInterval);
+      continue;
+    }
+
+    // Closing and connecting block, so neither happens under the lock
+    std::string target = missing ? *missing : std::string();
+    if (missing)
+      targets_[target].connecting++;
+    lock.unlock();
+    for (auto &client : retired)
+      client->stop();
+    std::shared_ptr<AudioSocketClient> client;
+    if (!target.empty()) {
+      auto start = Clock::now();
+      client = open(target);
+      connectMs_.store(std::chrono::duration_cast<std::chrono::milliseconds>(
+                           Clock::now() - start)
+                           .count(),
+                       std::memory_order_relaxed);
+    }
+    lock.lock();
+
+    if (target.empty())
+      continue;
+    auto it = targets_.find(target);
+    if (it == targets_.end()) {
+      // Shut down meanwhile
+      if (client)
+        retired.push_back(std::move(client));
+      lock.unlock();
+      retired.clear(); // closes the connection
+      lock.lock();
+      continue;
+    }
+    Target &t = it->second;
+    t.connecting--;
+    if (!client) {
+      refillFailures_.fetch_add(1, std::memory_order_relaxed);
+      wake_.wait_for(lock, kMaintainInterval); // don't hammer a dead server
+      continue;
+    }
+    now = Clock::now();
+    t.idle.push_back({std::move(client), now});
+    refills_.fetch_add(1, std::memory_order_relaxed);
+    if (!t.owed.empty()) {
+      uint64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        now - t.owed.front())
+                        .count();
+      t.owed.pop_front();
+      refillLatencyTotalMs_.fetch_add(ms, std::memory_order_relaxed);
+      refillLatencyCount_.fetch_add(1, std::memory_order_relaxed);
+      uint64_t max = refillLatencyMaxMs_.load(std::memory_order_relaxed);
+      while (ms > max && !refillLatencyMaxMs_.compare_exchange_weak(
+                             max, ms, std::memory_order_relaxed)) {
+      }
+    }
+  }
+}
+
+std::shared_ptr<AudioSocketClient>
+AudioSocketPool::open(const std::string &target) {
+  auto client = std::make_shared<AudioSocketClient>(target);
+  if (!client->connect())
+    return nullptr;
+  return client;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "AudioSocketClient.h"
+
+// Hands out AudioSocket connections for calls from a few kept connected
+// ahead of time, so an INVITE does not wait for a TCP handshake on the SIP
+// thread. Connecting blocks, so claimed connections are replaced by a
+// background thread. How many are kept idle follows the observed call rate:
+// enough to cover the calls arriving while replacements connect, within
+// [minIdle, maxIdle]. Idle connections the server closed, or that sat idle
+// past maxIdleMs, are dropped; keepalive catches servers that vanished.
+class AudioSocketPool {
+public:
+  static AudioSocketPool &instance();
+
+  // maxIdle 0 disables the pool and every call connects on its own
+  void init(int minIdle, int maxIdle, int maxIdleMs);
+
+  // Start keeping connections to target
+  void warm(const std::string &target);
+
+  // A connected client bound to the call, or null if connecting failed. The
+  // caller installs its audio callback and then sends the UUID frame.
+  std::shared_ptr<AudioSocketClient> acquire(const std::string &target,
+                                             const std::string &callId,
+                                             const std::string &fromUser,
+                                             const std::string &toUser);
+
+  // Stop refilling and close the idle connections
+  void shutdown();
+
+  void logStats() const;
+
+  uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+  AudioSocketPool() = default;
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Idle {
+    std::shared_ptr<AudioSocketClient> client;
+    Clock::time_point since;
+  };
+
+  struct Target {
+    std::deque<Idle> idle;
+    size_t connecting = 0;
+    // Claims not yet replaced, oldest first, for the refill latency
+    std::deque<Clock::time_point> owed;
+    // Call rate: acquires in the current second, and a moving average
+    uint64_t acquiresThisSecond = 0;
+    Clock::time_point secondStart;
+    double callsPerSecond = 0;
+  };
+
+  // mutex_ held
+  Target &targetFor(const std::string &target);
+  size_t desiredIdle(const Target &t) const;
+  void updateRate(Target &t, Clock::time_point now);
+  void refillLoop();
+  static std::shared_ptr<AudioSocketClient> open(const std::string &target);
+
+  int minIdle_ = 0;
+  int maxIdle_ = 0;
+  std::chrono::milliseconds maxIdleAge_{30000};
+
+  std::map<std::string, Target> targets_;
+  bool shutdown_ = false;
+  std::thread refillThread_; // started with the first target
+  std::condition_variable wake_;
+  mutable std::mutex mutex_;
+
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> stale_{0}; // idle connections closed or aged out
+  std::atomic<uint64_t> refills_{0};
+  std::atomic<uint64_t> refillFailures_{0};
+  // Claim to replacement connected, for claims that were replaced
+  std::atomic<uint64_t> refillLatencyTotalMs_{0};
+  std::atomic<uint64_t> refillLatencyMaxMs_{0};
+  std::atomic<uint64_t> refillLatencyCount_{0};
+  // Last measured connect time, which sizes the pool
+  std::atomic<uint64_t> connectMs_{0};
+};
@@ -0,0 +1,154 @@
+#include "AudioSocketReactor.h"
+#include "../app/Logger.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#ifdef __linux__
+// How often a loop checks for shutdown while its sockets are idle
+static const int kWaitTimeoutMs = 100;
+#endif
+
+AudioSocketReactor &AudioSocketReactor::instance() {
+  static AudioSocketReactor instance;
+  return instance;
+}
+
+void AudioSocketReactor::init(int threads) {
+  std::lock_guard<std::mutex> lock(initMutex_);
+  if (started_)
+    return;
+  if (threads < 1)
+    threads = 1;
+
+  running_ = true;
+  for (int i = 0; i < threads; ++i) {
+    auto loop = std::make_unique<Loop>();
+#ifdef __linux__
+    loop->pollFd = epoll_create1(0);
+    if (loop->pollFd < 0)
+      LOG_ERROR("Failed to create epoll instance for AudioSocket loop " << i);
+#endif
+    loop->thread = std::thread(&AudioSocketReactor::run, this, std::ref(*loop));
+    loops_.push_back(std::move(loop));
+  }
+  started_ = true;
+  LOG_INFO("AudioSocket reactor started with " << threads << " threads");
+}
+
+void AudioSocketReactor::shutdown() {
+  std::lock_guard<std::mutex> lock(initMutex_);
+  if (!running_)
+    return;
+  running_ = false;
+  // The loops stay allocated: a late remove() must still find its loop
+  for (auto &loop : loops_) {
+    if (loop->thread.joinable())
+      loop->thread.join();
+    std::lock_guard<std::mutex> loopLock(loop->mutex);
+    loop->handlers.clear();
+#ifdef __linux__
+    if (loop->pollFd >= 0) {
+      close(loop->pollFd);
+      loop->pollFd = -1;
+    }
+#endif
+  }
+}
+
+bool AudioSocketReactor::add(int fd, Handler *handler) {
+  if (!started_)
+    init(1);
+
+  Loop &loop = loopFor(fd);
+  std::lock_guard<std::mutex> lock(loop.mutex);
+#ifdef __linux__
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.fd = fd;
+  if (epoll_ctl(loop.pollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    LOG_ERROR("epoll_ctl add failed for AudioSocket fd " << fd << ": "
+                                                         << strerror(errno));
+    return false;
+  }
+#endif
+  loop.handlers[fd] = handler;
+  return true;
+}
+
+void AudioSocketReactor::remove(int fd) {
+  if (!started_)
+    return;
+  Loop &loop = loopFor(fd);
+  // Taking the lock waits out a handler that is running right now
+  std::lock_guard<std::mutex> lock(loop.mutex);
+  if (loop.handlers.erase(fd) == 0)
+    return; // already finished
+#ifdef __linux__
+  epoll_ctl(loop.pollFd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+}
+
+#ifdef __linux__
+void AudioSocketReactor::run(Loop &loop) {
+  const int MAX_EVENTS = 64;
+  struct epoll_event events[MAX_EVENTS];
+  if (loop.pollFd < 0)
+    return;
+
+  while (running_) {
+    int nfds = epoll_wait(loop.pollFd, events, MAX_EVENTS, kWaitTimeoutMs);
+    if (nfds <= 0)
+      continue;
+
+    std::lock_guard<std::mutex> lock(loop.mutex);
+    for (int i = 0; i < nfds; ++i) {
+      // A connection removed since epoll_wait returned is skipped; if its
+      // fd was already reused, the new handler just sees a spurious wakeup
+      int fd = events[i].data.fd;
+      auto it = loop.handlers.find(fd);
+      if (it == loop.handlers.end())
+        continue;
+      if (!it->second->onReadable()) {
+        epoll_ctl(loop.pollFd, EPOLL_CTL_DEL, fd, nullptr);
+        loop.handlers.erase(it);
+      }
+    }
+  }
+}
+#else
+void AudioSocketReactor::run(Loop &loop) {
+  // Fallback for non-Linux (macOS/Development) using poll over the
+  // registered sockets; additions are picked up on the next pass
+  std::vector<struct pollfd> fds;
+  while (running_) {
+    fds.clear();
+    {
+      std::lock_guard<std::mutex> lock(loop.mutex);
+      for (const auto &entry : loop.handlers)
+        fds.push_back({entry.first, POLLIN, 0});
+    }
+    if (fds.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    if (::poll(fds.data(), fds.size(), 10) <= 0)
+      continue;
+
+    std::lock_guard<std::mutex> lock(loop.mutex);
+    for (const auto &p : fds) {
+      if (!(p.revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      auto it = loop.handlers.find(p.fd);
+      if (it != loop.handlers.end() && !it->second->onReadable())
+        loop.handlers.erase(it);
+    }
+  }
+}
+#endif
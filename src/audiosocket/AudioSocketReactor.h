@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Process-wide set of event loops that read every AudioSocket connection, so
+// a call doesn't need a thread of its own. A connection always lands on the
+// same loop (picked by its fd) and its handler only ever runs there.
+class AudioSocketReactor {
+public:
+  class Handler {
+  public:
+    virtual ~Handler() = default;
+    // The socket is readable or the peer went away. Must not block. Return
+    // false once the connection is finished to stop watching it.
+    virtual bool onReadable() = 0;
+  };
+
+  static AudioSocketReactor &instance();
+
+  // Starts the loops; the first add() starts one if init() never ran
+  void init(int threads);
+  void shutdown();
+
+  // Watches fd until remove() or until handler->onReadable() returns false
+  bool add(int fd, Handler *handler);
+  // Stops watching fd. Once it returns the handler is not running and won't
+  // be called again, so it may be destroyed. Must not be called from a
+  // handler.
+  void remove(int fd);
+
+private:
+  AudioSocketReactor() = default;
+
+  struct Loop {
+    std::thread thread;
+    int pollFd = -1; // epoll instance, Linux only
+    // Held while handlers run, which is what remove() waits on
+    std::mutex mutex;
+    std::unordered_map<int, Handler *> handlers;
+  };
+
+  Loop &loopFor(int fd) { return *loops_[(size_t)fd % loops_.size()]; }
+  void run(Loop &loop);
+
+  // Filled once by init() and never shrunk; started_ publishes it
+  std::vector<std::unique_ptr<Loop>> loops_;
+  std::atomic<bool> started_{false};
+  std::atomic<bool> running_{false};
+  std::mutex initMutex_;
+};
@@ -23,34 +23,28 @@ std::shared_ptr<CallSession> CallRegistry::getCall(const std::string &callId) {
 }
 
 void CallRegistry::removeCall(const std::string &callId) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  
-  auto it = callToPorts_.find(callId);
-  if (it != callToPorts_.end()) {
-    for (int port : it->second) {
-      portMap_.erase(port);
-    }
-    callToPorts_.erase(it);
+  std::shared_ptr<CallSession> session;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = calls_.find(callId);
+    if (it == calls_.end())
+      return;
+    session = std::move(it->second);
+    calls_.erase(it);
   }
-  
-  calls_.erase(callId);
-}
-
-void CallRegistry::registerRtpPort(int port, const std::string &callId) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  portMap_[port] = callId;
-  callToPorts_[callId].push_back(port);
+  // The RTP worker holds its own reference until the port is released
+  session->terminate();
 }
 
-std::shared_ptr<CallSession> CallRegistry::getCallByPort(int port) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto it = portMap_.find(port);
-  if (it != portMap_.end()) {
-    auto cit = calls_.find(it->second);
-    if (cit != calls_.end())
-      return cit->second;
+void CallRegistry::removeAll() {
+  std::map<std::string, std::shared_ptr<CallSession>> calls;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    calls.swap(calls_);
+  }
+  for (auto &[callId, session] : calls) {
+    session->terminate();
   }
-  return nullptr;
 }
 
 size_t CallRegistry::count() {
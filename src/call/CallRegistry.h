@@ -6,23 +6,22 @@
 #include <string>
 #include <vector>
 
+// Call-ID keyed registry used by the SIP side. RTP packets never come through
+// here, they are dispatched by the owning RtpWorker's port table.
 class CallRegistry {
 public:
   static CallRegistry &instance();
 
   bool addCall(const std::string &callId, std::shared_ptr<CallSession> session);
   std::shared_ptr<CallSession> getCall(const std::string &callId);
-  void removeCall(const std::string &callId);
 
-  // Lookup by RTP port
-  std::shared_ptr<CallSession> getCallByPort(int port);
-  void registerRtpPort(int port, const std::string &callId);
+  // Removes and terminates the session (releasing its RTP port)
+  void removeCall(const std::string &callId);
+  void removeAll();
 
   size_t count();
 
 private:
   std::map<std::string, std::shared_ptr<CallSession>> calls_;
-  std::map<int, std::string> portMap_; // rtp port -> call id
-  std::map<std::string, std::vector<int>> callToPorts_; // call id -> ports
   std::mutex mutex_;
 };
@@ -6,9 +6,16 @@
 #include "../media/stages/GrpcBridgeStage.h"
 #include "../media/stages/AudioSocketStage.h"
 #include "../media/stages/RecorderStage.h"
+#include "../audiosocket/AudioSocketPool.h"
+#include "../grpc/StreamPool.h"
 #include "../rtp/RtpServer.h"
+#include "../util/G711Utils.h"
+#include <algorithm>
 
-CallSession::CallSession(const std::string &callId) : callId_(callId) {
+CallSession::CallSession(const std::string &callId)
+    : callId_(callId),
+      jitterBuffer_(Config::instance().jitterMinDelayMs,
+                    Config::instance().jitterMaxDelayMs) {
   // Generate random SSRC
   ssrc_ = (uint32_t)std::chrono::system_clock::now().time_since_epoch().count();
   outgoingSeq_ = (uint16_t)(ssrc_ & 0xFFFF);
@@ -43,6 +50,10 @@ void CallSession::terminate() {
 void CallSession::startPipeline(int localRtpPort, const std::string &remoteIp,
                                 int remotePort, int payloadType) {
   std::lock_guard<std::mutex> lock(mutex_);
+  if (localRtpPort_ > 0 && localRtpPort_ != localRtpPort) {
+    // re-INVITE moved us to a new port
+    RtpServer::instance().releasePort(localRtpPort_);
+  }
   localRtpPort_ = localRtpPort;
   payloadType_ = payloadType;
 
@@ -55,17 +66,26 @@ void CallSession::startPipeline(int localRtpPort, const std::string &remoteIp,
 
   // 1. Core Logic (Source for DL, Sink for UL)
   if (config.mode == Config::GatewayMode::GRPC) {
-    botClient_ = std::make_shared<VoiceBotClient>(config.grpcTarget, callId_);
-    if (botClient_->connect()) {
+    botClient_ = StreamPool::instance().acquire(config.grpcTarget, callId_);
+    if (botClient_) {
+      // Stage first, so its audio callback is in place before the bot
+      // learns about the call
+      pipeline_->addStage(std::make_shared<GrpcBridgeStage>(
+          botClient_, config.uplinkAggregationMs));
       botClient_->sendConfig(8000, payloadType == 8 ? 8 : 0);
-      pipeline_->addStage(std::make_shared<GrpcBridgeStage>(botClient_));
     } else {
       LOG_ERROR("Failed to connect to gRPC bot for call " << callId_);
     }
   } else if (config.mode == Config::GatewayMode::AUDIOSOCKET) {
-    tcpClient_ = std::make_shared<AudioSocketClient>(config.audiosocketTarget, callId_, fromUser_, toUser_);
-    if (tcpClient_->connect()) {
-      pipeline_->addStage(std::make_shared<AudioSocketStage>(tcpClient_, payloadType));
+    tcpClient_ = AudioSocketPool::instance().acquire(
+        config.audiosocketTarget, callId_, fromUser_, toUser_);
+    if (tcpClient_) {
+      // Stage first, so its audio callback is in place before the server
+      // learns about the call
+      pipeline_->addStage(std::make_shared<AudioSocketStage>(
+          tcpClient_, payloadType, config.audiosocketUplinkGain,
+          config.audiosocketDownlinkGain, config.uplinkAggregationMs));
+      tcpClient_->sendUuid();
     } else {
       LOG_ERROR("Failed to connect to TCP AudioSocket for call " << callId_);
     }
@@ -80,7 +100,8 @@ void CallSession::startPipeline(int localRtpPort, const std::string &remoteIp,
   }
 }
 
-void CallSession::onRtpPacket(const RtpPacket &pkt, const sockaddr_in &sender) {
+void CallSession::onRtpPacket(const RtpPacketRef &pkt,
+                              const sockaddr_in &sender) {
   {
     std::lock_guard<std::mutex> lock(mutex_);
     // Symmetric RTP lock
@@ -90,32 +111,83 @@ void CallSession::onRtpPacket(const RtpPacket &pkt, const sockaddr_in &sender) {
       LOG_INFO("Locked remote RTP source for call " << callId_);
     }
     
-    // Audio Processing
-    if (pkt.getPayloadType() == payloadType_) {
-      jitterBuffer_.push(pkt);
-    } else {
+    if (pkt->getPayloadType() != payloadType_)
       return;
-    }
   }
 
-  // Process outside lock if possible, but jitterBuffer and processRtpFrame 
-  // currently rely on state that might be shared.
-  // However, processRtpFrame() is where the heavy work is.
-  processRtpFrame();
+  // Played out by onMediaTick once its deadline is reached. The jitter
+  // buffer is only touched from the worker thread, so no lock is needed.
+  jitterBuffer_.push(pkt, pkt->arrivalMs);
 }
 
-void CallSession::processRtpFrame() {
-  auto pktOpt = jitterBuffer_.pop();
-  if (!pktOpt)
+void CallSession::processRtpFrame(uint64_t nowMs) {
+  JitterBuffer::Frame frame = jitterBuffer_.pop(nowMs);
+  if (!frame.packet && !frame.lost)
     return;
-
-  auto &pkt = *pktOpt;
   
-  // Pipeline processing
+  // Uplink only, downlink frames are produced by onMediaTick
+  std::shared_ptr<MediaPipeline> pipelineCopy;
+  int pType;
+  {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pipelineCopy = pipeline_;
+      pType = payloadType_;
+  }
+  if (!pipelineCopy)
+    return;
+
+  bool g711 = pType == 0 || pType == 8;
+  AudioFrame &out = uplinkFrame_;
+  out.payloadType = pType;
+  if (frame.packet) {
+    out.assign(frame.packet->getPayload(), frame.packet->getPayloadSize());
+    out.timestamp = frame.packet->getTimestamp();
+    out.seq = frame.packet->getSequenceNumber();
+    out.concealed = false;
+    out.marker = frame.packet->getMarker();
+    if (g711) {
+      // Keep the concealment history current; the first frame after a loss
+      // is cross-faded and needs re-encoding.
+      int16_t pcm[AudioFrame::kCapacity];
+      if (pType == 8)
+        G711Utils::decodeALaw(out.data, pcm, out.size);
+      else
+        G711Utils::decodeULaw(out.data, pcm, out.size);
+      if (plc_.receive(pcm, out.size)) {
+        if (pType == 8)
+          G711Utils::encodeALaw(pcm, out.data, out.size);
+        else
+          G711Utils::encodeULaw(pcm, out.data, out.size);
+      }
+    }
+  } else if (g711) {
+    size_t samples = std::min<size_t>(8 * ptimeMs_, AudioFrame::kCapacity);
+    int16_t pcm[AudioFrame::kCapacity];
+    plc_.conceal(pcm, samples);
+    if (pType == 8)
+      G711Utils::encodeALaw(pcm, out.data, samples);
+    else
+      G711Utils::encodeULaw(pcm, out.data, samples);
+    out.size = samples;
+    out.timestamp += 8 * ptimeMs_;
+    out.seq++;
+    out.concealed = true;
+    out.marker = false;
+  } else {
+    return;
+  }
+
+  pipelineCopy->processUplink(out);
+}
+
+void CallSession::onMediaTick(uint64_t nowMs) {
+  processRtpFrame(nowMs);
+
   std::shared_ptr<MediaPipeline> pipelineCopy;
   sockaddr_in remoteAddr;
   int localPort;
   int pType;
+  uint32_t ts;
 
   {
       std::lock_guard<std::mutex> lock(mutex_);
@@ -123,35 +195,36 @@ void CallSession::processRtpFrame() {
       remoteAddr = remoteRtpAddr_;
       localPort = localRtpPort_;
       pType = payloadType_;
+      // The timestamp follows the sampling clock (8 kHz), silence included
+      outgoingTimestamp_ += 8 * ptimeMs_;
+      ts = outgoingTimestamp_;
   }
 
-  if (pipelineCopy) {
-      // Avoid vector copy if possible, but pipeline needs copy for now as per its interface
-      std::vector<char> payload(pkt.getPayload(),
-                                pkt.getPayload() + pkt.getPayloadSize());
-      
-      pipelineCopy->processUplink(payload);
-      
-      // Pipeline Downlink
-      auto dlPayload = pipelineCopy->processDownlink();
-      if (!dlPayload.empty() && localPort > 0) {
-        RtpPacket sendPkt;
-        
-        uint32_t ts;
-        uint16_t seq;
-        uint32_t ssrc;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            ts = (outgoingTimestamp_ += 160); // Assuming 20ms G711
-            seq = ++outgoingSeq_;
-            ssrc = ssrc_;
-        }
-
-        sendPkt.setHeader(pType, seq, ts, ssrc);
-        sendPkt.setPayload((uint8_t *)dlPayload.data(), dlPayload.size());
-        RtpServer::instance().send(localPort, sendPkt, remoteAddr);
+  if (!pipelineCopy || localPort <= 0)
+    return;
+
+  AudioFrame &dl = downlinkFrame_;
+  pipelineCopy->processDownlink(dl);
+  uint16_t seq;
+  uint32_t ssrc;
+  bool marker;
+  {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (dl.empty()) {
+        talkspurt_ = false;
+        return;
       }
+      seq = ++outgoingSeq_;
+      ssrc = ssrc_;
+      marker = !talkspurt_;
+      talkspurt_ = true;
   }
+
+  RtpPacketRef sendPkt = RtpPacketPool::allocate();
+  sendPkt->setHeader(pType, seq, ts, ssrc);
+  sendPkt->setMarker(marker);
+  sendPkt->setPayload(dl.data, dl.size);
+  RtpServer::instance().send(localPort, std::move(sendPkt), remoteAddr);
 }
 
 void CallSession::onSipMessage(const SipMessage &msg,
@@ -5,17 +5,20 @@
 #include <netinet/in.h>
 #include <string>
 
-#include "../grpc/VoiceBotClient.h"
+#include "../grpc/BotSession.h"
 #include "../audiosocket/AudioSocketClient.h"
+#include "../media/G711Plc.h"
 #include "../media/MediaPipeline.h"
 #include "../rtp/JitterBuffer.h"
+#include "../rtp/RtpSink.h"
 #include "../sip/SipDialog.h"
 #include "../sip/SipServer.h"
 
 // Forward declaration
 class CallRegistry;
 
-class CallSession : public std::enable_shared_from_this<CallSession> {
+class CallSession : public std::enable_shared_from_this<CallSession>,
+                    public RtpSink {
 public:
   CallSession(const std::string &callId);
   ~CallSession();
@@ -28,8 +31,12 @@ public:
   // SIP Events
   void onSipMessage(const SipMessage &msg, const sockaddr_in &sender);
 
-  // RTP Events
-  void onRtpPacket(const RtpPacket &pkt, const sockaddr_in &sender);
+  // RTP Events (called on the owning RtpWorker thread)
+  void onRtpPacket(const RtpPacketRef &pkt,
+                   const sockaddr_in &sender) override;
+  // Downlink: one frame per packetization interval, paced by the worker
+  int mediaTickIntervalMs() const override { return ptimeMs_; }
+  void onMediaTick(uint64_t nowMs) override;
 
   // Stop/Cleanup
   void terminate();
@@ -46,9 +53,13 @@ private:
 
   // Media
   std::shared_ptr<MediaPipeline> pipeline_;
-  std::shared_ptr<VoiceBotClient> botClient_;
+  std::shared_ptr<BotSession> botClient_;
   std::shared_ptr<AudioSocketClient> tcpClient_;
   JitterBuffer jitterBuffer_;
+  G711Plc plc_;
+  // Reused every interval; only touched on the RtpWorker thread
+  AudioFrame uplinkFrame_;
+  AudioFrame downlinkFrame_;
 
   std::mutex mutex_;
   int localRtpPort_ = 0;
@@ -57,9 +68,12 @@ private:
   int payloadType_ = 0;
 
   // RTP Stream State
+  int ptimeMs_ = 20;
   uint32_t ssrc_ = 0;
   uint32_t outgoingTimestamp_ = 0;
   uint16_t outgoingSeq_ = 0;
+  bool talkspurt_ = false; // marker bit goes on the first frame after silence
 
-  void processRtpFrame();
+  // Uplink playout: next frame from the jitter buffer, concealed if lost
+  void processRtpFrame(uint64_t nowMs);
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "voicebot.pb.h"
+
+// A call's conversation with the bot, whether it has a StreamCall stream to
+// itself (VoiceBotClient) or shares a multiplexed one (MuxCall).
+class BotSession {
+public:
+  using AudioCallback = std::function<void(const std::string &data)>;
+  using ControlCallback = std::function<void(const voicebot::BotControl &)>;
+
+  virtual ~BotSession() = default;
+
+  // Callbacks run on gRPC threads and must not block
+  virtual void setAudioCallback(AudioCallback cb) = 0;
+  virtual void setControlCallback(ControlCallback cb) = 0;
+
+  // Sending to Bot. These only queue the message and never block on the
+  // network. sendAudio returns false if the frame was dropped because the
+  // bot fell behind; timestamp is the RTP timestamp of its first sample.
+  virtual void sendConfig(int rate, int codec) = 0; // 0=PCMU, 8=PCMA
+  virtual bool sendAudio(const uint8_t *data, size_t len, uint64_t seq,
+                         uint32_t timestamp) = 0;
+  virtual void sendHangup() = 0;
+
+  virtual uint64_t droppedFrames() const = 0;
+
+  // Ends the call's side of the conversation; no callbacks run afterwards
+  virtual void stop() = 0;
+};
@@ -0,0 +1,196 @@
+#include "BotStream.h"
+#include "../app/Logger.h"
+#include "ChannelPool.h"
+#include <grpcpp/impl/codegen/proto_utils.h>
+#include <grpcpp/support/proto_buffer_reader.h>
+#include <thread>
+
+static const char *kStreamCallMethod = "/voicebot.VoiceBot/StreamCall";
+
+BotStream::BotStream(const std::string &target, size_t queueCapacity)
+    : uplink_(queueCapacity) {
+  channel_ = ChannelPool::instance().get(target);
+  stub_ = std::make_unique<grpc::GenericStub>(channel_);
+}
+
+BotStream::~BotStream() = default;
+
+bool BotStream::open() {
+  if (started_)
+    return true;
+  context_ = std::make_unique<grpc::ClientContext>();
+  running_ = true;
+  started_ = true;
+
+  // The hold keeps the RPC open until close(), since writes are started
+  // from outside reactions
+  stub_->PrepareBidiStreamingCall(context_.get(), kStreamCallMethod,
+                                  grpc::StubOptions(), this);
+  AddHold();
+  StartRead(&readBuf_);
+  StartCall();
+  return true;
+}
+
+void BotStream::close() {
+  if (!started_)
+    return;
+  started_ = false;
+  running_ = false;
+  closing_ = true;
+
+  // Cancel so pending writes fail fast and the read completes
+  context_->TryCancel();
+
+  // Queue a STOP marker behind anything pending and wait for the writer to
+  // reach it; afterwards no further StartWrite can be issued. The writer
+  // now discards everything, so room appears quickly.
+  Outbound marker;
+  marker.type = Outbound::Type::STOP;
+  while (!uplink_.push(std::move(marker)))
+    std::this_thread::yield();
+  if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+    writeNext();
+
+  std::unique_lock<std::mutex> lock(doneMutex_);
+  doneCv_.wait(lock, [this] { return writerParked_; });
+  lock.unlock();
+
+  RemoveHold();
+
+  lock.lock();
+  doneCv_.wait(lock, [this] { return done_; });
+}
+
+void BotStream::OnReadDone(bool ok) {
+  if (!ok) {
+    LOG_INFO("VoiceBot stream closed for " << describe());
+    running_ = false;
+    return;
+  }
+  if (parseAction())
+    onAction(action_);
+  else
+    LOG_WARN("Malformed VoiceBot message on " << describe());
+  StartRead(&readBuf_);
+}
+
+// Parses readBuf_ into action_ while keeping the memory of the previous
+// message: Clear() would free an audio chunk along with its payload buffer,
+// so in the common audio-after-audio case only the chunk is cleared and the
+// new message is merged on top.
+bool BotStream::parseAction() {
+  if (action_.has_audio()) {
+    action_.mutable_audio()->Clear();
+    action_.clear_call_id();
+  } else {
+    action_.Clear();
+  }
+  grpc::ProtoBufferReader reader(&readBuf_);
+  bool ok = action_.MergeFromBoundedZeroCopyStream(&reader,
+                                                   (int)readBuf_.Length());
+  readBuf_.Clear();
+  return ok;
+}
+
+void BotStream::OnDone(const grpc::Status &status) {
+  if (!status.ok() && status.error_code() != grpc::StatusCode::CANCELLED) {
+    LOG_WARN("VoiceBot stream for " << describe()
+                                    << " ended: " << status.error_message());
+  }
+  std::lock_guard<std::mutex> lock(doneMutex_);
+  done_ = true;
+  doneCv_.notify_all();
+}
+
+bool BotStream::enqueue(Outbound &&out) {
+  if (!uplink_.push(std::move(out)))
+    return false;
+  if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+    writeNext();
+  return true;
+}
+
+bool BotStream::enqueueWait(Outbound &&out) {
+  // push() leaves out untouched when the queue is full
+  while (!uplink_.push(std::move(out))) {
+    if (closing_)
+      return false; // the writer may already be parked
+    std::this_thread::yield();
+  }
+  if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+    writeNext();
+  return true;
+}
+
+void BotStream::OnWriteDone(bool ok) {
+  if (!ok && !writeFailed_) {
+    if (running_)
+      LOG_WARN("VoiceBot stream write failed for " << describe());
+    writeFailed_ = true;
+  }
+  if (pending_.fetch_sub(1, std::memory_order_acq_rel) > 1)
+    writeNext();
+}
+
+// Writer only: starts the write for the next queued message, discarding any
+// that can no longer be sent
+void BotStream::writeNext() {
+  Outbound out;
+  do {
+    // pending_ counts completed pushes, but a slower producer may still be
+    // filling the slot at the head of the ring
+    while (!uplink_.pop(out))
+      std::this_thread::yield();
+
+    if (out.type == Outbound::Type::STOP) {
+      parkWriter(); // keeps the writer role forever
+      return;
+    }
+    onDequeued(out, event_);
+    if (writeFailed_ || !running_)
+      continue; // drain and discard
+
+    switch (out.type) {
+    case Outbound::Type::AUDIO: {
+      // assign() keeps the buffer of the previous frame; set_data() would
+      // build a temporary string each time
+      auto audio = event_.mutable_audio();
+      audio->mutable_data()->assign(reinterpret_cast<const char *>(out.data),
+                                    out.len);
+      audio->set_seq(out.seq);
+      audio->set_timestamp(out.timestamp);
+      break;
+    }
+    case Outbound::Type::CONFIG: {
+      auto cfg = event_.mutable_config();
+      cfg->set_sample_rate(out.sampleRate);
+      cfg->set_codec(out.codec == 0 ? voicebot::PCMU : voicebot::PCMA);
+      break;
+    }
+    case Outbound::Type::HANGUP:
+      event_.mutable_control()->set_type(voicebot::ControlEvent::HANGUP);
+      break;
+    case Outbound::Type::HELLO: {
+      auto hello = event_.mutable_hello();
+      hello->set_protocol_version(kMuxProtocolVersion);
+      hello->set_multiplex(true);
+      break;
+    }
+    case Outbound::Type::STOP:
+      break;
+    }
+    bool ownBuffer;
+    writeBuf_.Clear(); // the previous write has completed
+    grpc::SerializationTraits<voicebot::CallEvent>::Serialize(
+        event_, &writeBuf_, &ownBuffer);
+    StartWrite(&writeBuf_);
+    return;
+  } while (pending_.fetch_sub(1, std::memory_order_acq_rel) > 1);
+}
+
+void BotStream::parkWriter() {
+  std::lock_guard<std::mutex> lock(doneMutex_);
+  writerParked_ = true;
+  doneCv_.notify_all();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "../media/UplinkAggregator.h"
+#include "../util/MpscQueue.h"
+
+#include "voicebot.pb.h"
+#include <grpcpp/generic/generic_stub.h>
+#include <grpcpp/grpcpp.h>
+
+// One StreamCall stream driven by the gRPC callback API: reads and writes
+// complete on gRPC's shared callback executor, so no thread is dedicated to
+// a stream. Outgoing messages go through a bounded queue; the caller that
+// takes pending_ from 0 to 1 becomes the writer until it drops back to 0,
+// so at most one StartWrite is in flight and later writes are issued from
+// OnWriteDone.
+//
+// Messages cross the reactor as serialized ByteBuffers, so the protobufs on
+// either side are kept and reused: in steady state a frame costs no heap
+// allocation outside gRPC core.
+//
+// Derived classes must call close() in their destructor, since reactions
+// call back into them.
+class BotStream
+    : protected grpc::ClientBidiReactor<grpc::ByteBuffer, grpc::ByteBuffer> {
+public:
+  // First StreamHello protocol version that supports multiplexing
+  static constexpr uint32_t kMuxProtocolVersion = 2;
+
+  // False once the bot has closed the stream
+  bool isOpen() const { return running_.load(std::memory_order_acquire); }
+
+protected:
+  struct Outbound {
+    enum class Type : uint8_t { AUDIO, CONFIG, HANGUP, HELLO, STOP };
+    Type type = Type::AUDIO;
+    bool endsCall = false; // last message of a call on a multiplexed stream
+    uint32_t slot = 0;     // call on a multiplexed stream
+    uint64_t seq = 0;
+    uint32_t timestamp = 0; // RTP timestamp of the first sample
+    int sampleRate = 0;
+    int codec = 0;
+    size_t len = 0;
+    uint8_t data[UplinkAggregator::kMaxBytes];
+  };
+
+  BotStream(const std::string &target, size_t queueCapacity);
+  ~BotStream();
+
+  bool open();
+  // Cancels the RPC and waits until it has finished. Idempotent.
+  void close();
+
+  // Any thread. Returns false if the queue is full.
+  bool enqueue(Outbound &&out);
+  // As enqueue, but waits for room; for messages that must not be lost.
+  // Gives up (returns false) only once the stream is closing.
+  bool enqueueWait(Outbound &&out);
+
+  // Every message read from the bot
+  virtual void onAction(const voicebot::CallAction &action) = 0;
+  // Every message taken off the queue, before it is written or discarded;
+  // fills per-message fields of event such as call_id
+  virtual void onDequeued(const Outbound &out, voicebot::CallEvent &event) = 0;
+  // Names the stream in log messages
+  virtual std::string describe() const = 0;
+
+  std::atomic<bool> running_{false};
+
+private:
+  std::shared_ptr<grpc::Channel> channel_;
+  std::unique_ptr<grpc::GenericStub> stub_;
+  std::unique_ptr<grpc::ClientContext> context_;
+  bool started_ = false;
+  std::atomic<bool> closing_{false};
+
+  // Signalled when the writer parks on close, and by OnDone; the reactor
+  // must outlive the RPC
+  std::mutex doneMutex_;
+  std::condition_variable doneCv_;
+  bool writerParked_ = false;
+  bool done_ = false;
+
+  MpscQueue<Outbound> uplink_;
+  std::atomic<size_t> pending_{0};
+  bool writeFailed_ = false; // writer only
+  voicebot::CallEvent event_;
+  grpc::ByteBuffer writeBuf_;
+  voicebot::CallAction action_;
+  grpc::ByteBuffer readBuf_;
+
+  void writeNext();
+  void parkWriter();
+  bool parseAction();
+
+  // ClientBidiReactor
+  void OnReadDone(bool ok) override;
+  void OnWriteDone(bool ok) override;
+  void OnDone(const grpc::Status &status) override;
+};
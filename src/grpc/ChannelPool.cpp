@@ -0,0 +1,57 @@
+#include "ChannelPool.h"
+#include "../app/Logger.h"
+#include <climits>
+
+ChannelPool &ChannelPool::instance() {
+  static ChannelPool instance;
+  return instance;
+}
+
+void ChannelPool::init(int channelsPerTarget, int keepaliveMs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  channelsPerTarget_ = channelsPerTarget > 0 ? channelsPerTarget : 1;
+  keepaliveMs_ = keepaliveMs;
+}
+
+void ChannelPool::warm(const std::string &target) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entryFor(target);
+}
+
+std::shared_ptr<grpc::Channel> ChannelPool::get(const std::string &target) {
+  Entry *entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry = &entryFor(target);
+  }
+  size_t i = entry->next.fetch_add(1, std::memory_order_relaxed);
+  return entry->channels[i % entry->channels.size()];
+}
+
+ChannelPool::Entry &ChannelPool::entryFor(const std::string &target) {
+  auto it = entries_.find(target);
+  if (it != entries_.end())
+    return *it->second;
+
+  auto entry = std::make_unique<Entry>();
+  for (int i = 0; i < channelsPerTarget_; ++i) {
+    grpc::ChannelArguments args;
+    // Without a local subchannel pool gRPC would share one connection
+    // between all channels to the same target
+    args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    args.SetInt(GRPC_ARG_CLIENT_IDLE_TIMEOUT_MS, INT_MAX);
+    if (keepaliveMs_ > 0) {
+      args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, keepaliveMs_);
+      args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, 10000);
+      args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+      args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+    }
+    auto channel = grpc::CreateCustomChannel(
+        target, grpc::InsecureChannelCredentials(), args);
+    channel->GetState(true); // start connecting now
+    entry->channels.push_back(std::move(channel));
+  }
+  LOG_INFO("gRPC channel pool for " << target << ": " << channelsPerTarget_
+                                    << " channels");
+  return *(entries_[target] = std::move(entry));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+// Process-wide pool of gRPC channels keyed by target. Each target gets a
+// fixed set of channels with their own HTTP/2 connection, kept connected with
+// keepalive; calls are spread over them round-robin so call setup never pays
+// for a handshake.
+class ChannelPool {
+public:
+  static ChannelPool &instance();
+
+  // channelsPerTarget connections per target. keepaliveMs is the ping
+  // interval on idle connections; bot servers reject pings more often than
+  // every 5 minutes unless configured to permit them.
+  void init(int channelsPerTarget, int keepaliveMs);
+
+  // Create the channels for target and start connecting them
+  void warm(const std::string &target);
+
+  // Next channel for target, warming it on first use
+  std::shared_ptr<grpc::Channel> get(const std::string &target);
+
+private:
+  ChannelPool() = default;
+
+  struct Entry {
+    std::vector<std::shared_ptr<grpc::Channel>> channels;
+    std::atomic<size_t> next{0};
+  };
+
+  Entry &entryFor(const std::string &target); // mutex_ held
+
+  int channelsPerTarget_ = 4;
+  int keepaliveMs_ = 300000;
+  std::map<std::string, std::unique_ptr<Entry>> entries_;
+  std::mutex mutex_;
+};
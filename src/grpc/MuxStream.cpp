@@ -0,0 +1,215 @@
+#include "MuxStream.h"
+#include "../app/Logger.h"
+#include <algorithm>
+#include <cstring>
+
+// Config, hangup and the closing hangup of each call
+static constexpr size_t kControlPerCall = 3;
+
+MuxStream::MuxStream(const std::string &target, size_t maxCalls,
+                     size_t uplinkQueueFrames)
+    : BotStream(target,
+                maxCalls * (uplinkQueueFrames + kControlPerCall) + 1),
+      maxQueuedAudio_(uplinkQueueFrames), slots_(new Slot[maxCalls]) {
+  freeSlots_.reserve(maxCalls);
+  for (size_t i = maxCalls; i > 0; --i)
+    freeSlots_.push_back((uint32_t)(i - 1));
+  routes_.reserve(maxCalls);
+}
+
+MuxStream::~MuxStream() { close(); }
+
+bool MuxStream::open() {
+  if (!BotStream::open())
+    return false;
+  Outbound hello;
+  hello.type = Outbound::Type::HELLO;
+  enqueueWait(std::move(hello));
+  return true;
+}
+
+size_t MuxStream::activeCalls() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return routes_.size();
+}
+
+std::shared_ptr<BotSession> MuxStream::attach(const std::string &callId) {
+  if (!ready())
+    return nullptr;
+  uint32_t slot;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (freeSlots_.empty() || routes_.count(callId))
+      return nullptr;
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    // The writer finished with this slot's previous call before freeing it
+    slots_[slot].callId = callId;
+    slots_[slot].queuedAudio.store(0, std::memory_order_relaxed);
+    routes_[callId] = slot;
+  }
+  return std::make_shared<MuxCall>(shared_from_this(), slot, callId);
+}
+
+std::string MuxStream::describe() const {
+  return "multiplexed stream " + std::to_string((uintptr_t)this);
+}
+
+void MuxStream::onAction(const voicebot::CallAction &action) {
+  if (action.has_hello()) {
+    const auto &hello = action.hello();
+    bool accepted =
+        hello.multiplex() && hello.protocol_version() >= kMuxProtocolVersion;
+    state_.store(accepted ? State::READY : State::DECLINED,
+                 std::memory_order_release);
+    LOG_INFO("VoiceBot protocol version " << hello.protocol_version() << ", "
+                                          << (accepted ? "multiplexing"
+                                                       : "declined multiplexing"));
+    return;
+  }
+
+  BotSession::AudioCallback audioCb;
+  BotSession::ControlCallback controlCb;
+  uint32_t slot;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = routes_.find(action.call_id());
+    if (it == routes_.end()) {
+      if (unroutable_++ == 0)
+        LOG_WARN("VoiceBot action for unknown call '" << action.call_id()
+                                                      << "' on " << describe());
+      return;
+    }
+    slot = it->second;
+    if (action.has_audio())
+      audioCb = slots_[slot].audioCb;
+    else if (action.has_control())
+      controlCb = slots_[slot].controlCb;
+    if (!audioCb && !controlCb)
+      return;
+    dispatchingSlot_ = slot;
+    dispatchingThread_ = std::this_thread::get_id();
+  }
+
+  // Not under the lock: the callback may stop or send on its call
+  if (audioCb)
+    audioCb(action.audio().data());
+  else
+    controlCb(action.control());
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dispatchingSlot_ = kNoSlot;
+  }
+  dispatched_.notify_all();
+}
+
+void MuxStream::onDequeued(const Outbound &out, voicebot::CallEvent &event) {
+  if (out.type == Outbound::Type::HELLO) {
+    event.clear_call_id();
+    return;
+  }
+  Slot &slot = slots_[out.slot];
+  if (out.type == Outbound::Type::AUDIO)
+    slot.queuedAudio.fetch_sub(1, std::memory_order_relaxed);
+  event.set_call_id(slot.callId);
+  if (out.endsCall) {
+    // Last message of the call; the id is already copied into event
+    std::lock_guard<std::mutex> lock(mutex_);
+    freeSlots_.push_back(out.slot);
+  }
+}
+
+MuxCall::MuxCall(std::shared_ptr<MuxStream> stream, uint32_t slot,
+                 const std::string &callId)
+    : stream_(std::move(stream)), slot_(slot), callId_(callId) {}
+
+MuxCall::~MuxCall() { stop(); }
+
+void MuxCall::setAudioCallback(AudioCallback cb) {
+  std::lock_guard<std::mutex> lock(stream_->mutex_);
+  stream_->slots_[slot_].audioCb = std::move(cb);
+}
+
+void MuxCall::setControlCallback(ControlCallback cb) {
+  std::lock_guard<std::mutex> lock(stream_->mutex_);
+  stream_->slots_[slot_].controlCb = std::move(cb);
+}
+
+bool MuxCall::enqueue(Outbound &&out) {
+  if (stopped_.load(std::memory_order_relaxed))
+    return false;
+  out.slot = slot_;
+  return stream_->enqueue(std::move(out));
+}
+
+void MuxCall::sendConfig(int rate, int codec) {
+  Outbound out;
+  out.type = Outbound::Type::CONFIG;
+  out.sampleRate = rate;
+  out.codec = codec;
+  if (!enqueue(std::move(out)))
+    LOG_ERROR("VoiceBot uplink queue full, config dropped for call " << callId_);
+}
+
+bool MuxCall::sendAudio(const uint8_t *data, size_t len, uint64_t seq,
+                        uint32_t timestamp) {
+  auto &queued = stream_->slots_[slot_].queuedAudio;
+  if (queued.fetch_add(1, std::memory_order_relaxed) >=
+      stream_->maxQueuedAudio_) {
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    droppedFrames_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  Outbound out;
+  out.type = Outbound::Type::AUDIO;
+  out.seq = seq;
+  out.timestamp = timestamp;
+  out.len = std::min(len, sizeof(out.data));
+  memcpy(out.data, data, out.len);
+  if (!enqueue(std::move(out))) {
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    droppedFrames_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void MuxCall::sendHangup() {
+  Outbound out;
+  out.type = Outbound::Type::HANGUP;
+  if (!enqueue(std::move(out)))
+    LOG_ERROR("VoiceBot uplink queue full, hangup dropped for call " << callId_);
+}
+
+void MuxCall::stop() {
+  if (stopped_.exchange(true))
+    return;
+  {
+    std::unique_lock<std::mutex> lock(stream_->mutex_);
+    stream_->routes_.erase(callId_);
+    auto &slot = stream_->slots_[slot_];
+    slot.audioCb = nullptr;
+    slot.controlCb = nullptr;
+    // Don't return while the reader is still in one of this call's
+    // callbacks, unless that callback is what is stopping the call
+    stream_->dispatched_.wait(lock, [this] {
+      return stream_->dispatchingSlot_ != slot_ ||
+             stream_->dispatchingThread_ == std::this_thread::get_id();
+    });
+  }
+
+  // The stream outlives the call, so say goodbye explicitly; the writer
+  // frees the slot once this is dequeued
+  Outbound out;
+  out.type = Outbound::Type::HANGUP;
+  out.endsCall = true;
+  out.slot = slot_;
+  stream_->enqueueWait(std::move(out));
+
+  uint64_t dropped = droppedFrames();
+  if (dropped > 0) {
+    LOG_WARN("VoiceBot uplink for call " << callId_ << " dropped " << dropped
+                                         << " frames, bot fell behind");
+  }
+}
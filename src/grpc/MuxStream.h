@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BotSession.h"
+#include "BotStream.h"
+
+// A long-lived StreamCall stream shared by many calls, routed by call_id in
+// both directions. The stream opens with a StreamHello; calls are only put
+// on it once the bot has answered that it multiplexes.
+class MuxStream : public BotStream,
+                  public std::enable_shared_from_this<MuxStream> {
+public:
+  enum class State { NEGOTIATING, READY, DECLINED };
+
+  // maxCalls calls may share the stream, each allowed uplinkQueueFrames of
+  // backlog toward the bot
+  MuxStream(const std::string &target, size_t maxCalls,
+            size_t uplinkQueueFrames);
+  ~MuxStream();
+
+  // Open the stream and send the StreamHello
+  bool open();
+  void close() { BotStream::close(); }
+
+  State state() const { return state_.load(std::memory_order_acquire); }
+  bool ready() const { return state() == State::READY && isOpen(); }
+  size_t activeCalls() const;
+
+  // A session for callId on this stream, or nullptr if the stream is not
+  // ready or has no free slot
+  std::shared_ptr<BotSession> attach(const std::string &callId);
+
+private:
+  friend class MuxCall;
+
+  struct Slot {
+    std::string callId; // set on attach, read by the writer
+    BotSession::AudioCallback audioCb;
+    BotSession::ControlCallback controlCb;
+    std::atomic<size_t> queuedAudio{0};
+  };
+
+  size_t maxQueuedAudio_;
+  std::atomic<State> state_{State::NEGOTIATING};
+  uint64_t unroutable_ = 0; // actions for unknown calls, reader only
+
+  std::unique_ptr<Slot[]> slots_;
+  std::vector<uint32_t> freeSlots_;
+  std::unordered_map<std::string, uint32_t> routes_;
+  mutable std::mutex mutex_; // routes_, freeSlots_, callbacks, dispatch
+
+  // The slot whose callback the reader is running, outside mutex_ so the
+  // callback may call back into its MuxCall; MuxCall::stop() waits it out
+  static constexpr uint32_t kNoSlot = UINT32_MAX;
+  uint32_t dispatchingSlot_ = kNoSlot;
+  std::thread::id dispatchingThread_;
+  std::condition_variable dispatched_;
+
+  // BotStream
+  void onAction(const voicebot::CallAction &action) override;
+  void onDequeued(const Outbound &out, voicebot::CallEvent &event) override;
+  std::string describe() const override;
+};
+
+// One call on a MuxStream. Stopping it tells the bot the call is over with
+// a HANGUP event and frees the slot once that has been sent.
+class MuxCall : public BotSession {
+public:
+  MuxCall(std::shared_ptr<MuxStream> stream, uint32_t slot,
+          const std::string &callId);
+  ~MuxCall();
+
+  void setAudioCallback(AudioCallback cb) override;
+  void setControlCallback(ControlCallback cb) override;
+
+  void sendConfig(int rate, int codec) override;
+  bool sendAudio(const uint8_t *data, size_t len, uint64_t seq,
+                 uint32_t timestamp) override;
+  void sendHangup() override;
+
+  uint64_t droppedFrames() const override {
+    return droppedFrames_.load(std::memory_order_relaxed);
+  }
+
+  void stop() override;
+
+private:
+  using Outbound = MuxStream::Outbound;
+
+  bool enqueue(Outbound &&out);
+
+  std::shared_ptr<MuxStream> stream_;
+  uint32_t slot_;
+  std::string callId_;
+  std::atomic<bool> stopped_{false};
+  std::atomic<uint64_t> droppedFrames_{0};
+};
@@ -0,0 +1,247 @@
+#include "StreamPool.h"
+#include "../app/Logger.h"
+#include <vector>
+
+// How often idle streams are checked when nothing is claimed, and the pause
+// after a failed open
+static const auto kMaintainInterval = std::chrono::seconds(1);
+
+StreamPool &StreamPool::instance() {
+  static StreamPool instance;
+  return instance;
+}
+
+void StreamPool::init(int streamsPerTarget, size_t uplinkQueueFrames,
+                      int muxStreamsPerTarget, int callsPerMuxStream) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  streamsPerTarget_ = streamsPerTarget > 0 ? streamsPerTarget : 0;
+  uplinkQueueFrames_ = uplinkQueueFrames;
+  muxStreamsPerTarget_ = muxStreamsPerTarget > 0 ? muxStreamsPerTarget : 0;
+  callsPerMuxStream_ = callsPerMuxStream > 0 ? callsPerMuxStream : 1;
+}
+
+void StreamPool::warm(const std::string &target) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  watch(target);
+  if (streamsPerTarget_ > 0)
+    LOG_INFO("Keeping " << streamsPerTarget_ << " idle bot streams open to "
+                        << target);
+  auto &mux = mux_[target];
+  while (mux.size() < (size_t)muxStreamsPerTarget_)
+    mux.push_back(openMux(target));
+  if (muxStreamsPerTarget_ > 0)
+    LOG_INFO("Offering " << muxStreamsPerTarget_
+                         << " multiplexed bot streams to " << target);
+}
+
+std::shared_ptr<BotSession>
+StreamPool::acquire(const std::string &target, const std::string &callId) {
+  if (auto session = attachMux(target, callId)) {
+    multiplexed_.fetch_add(1, std::memory_order_relaxed);
+    return session;
+  }
+
+  std::shared_ptr<VoiceBotClient> client;
+  std::vector<std::shared_ptr<VoiceBotClient>> stale;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = idle_.find(target);
+    if (it != idle_.end()) {
+      auto &idle = it->second;
+      while (!idle.empty() && !client) {
+        if (idle.front()->isOpen())
+          client = std::move(idle.front());
+        else
+          stale.push_back(std::move(idle.front()));
+        idle.pop_front();
+      }
+    }
+    watch(target);
+  }
+  wake_.notify_one();
+
+  // Reap outside the lock, stop() waits for the RPC to finish
+  for (auto &s : stale) {
+    s->stop();
+    stale_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (client) {
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    client->bind(callId);
+    return client;
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return open(target, callId);
+}
+
+void StreamPool::shutdown() {
+  std::map<std::string, std::deque<std::shared_ptr<VoiceBotClient>>> idle;
+  std::map<std::string, std::vector<std::shared_ptr<MuxStream>>> mux;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+    idle.swap(idle_);
+    mux.swap(mux_);
+  }
+  wake_.notify_all();
+  if (refillThread_.joinable())
+    refillThread_.join();
+  for (auto &entry : idle) {
+    for (auto &client : entry.second)
+      client->stop();
+  }
+  for (auto &entry : mux) {
+    for (auto &stream : entry.second)
+      stream->close();
+  }
+}
+
+void StreamPool::logStats() const {
+  size_t idle = 0;
+  size_t muxReady = 0;
+  size_t muxCalls = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &entry : idle_)
+      idle += entry.second.size();
+    for (const auto &entry : mux_) {
+      for (const auto &stream : entry.second) {
+        if (stream->ready()) {
+          muxReady++;
+          muxCalls += stream->activeCalls();
+        }
+      }
+    }
+  }
+  LOG_INFO("Bot stream pool: " << hits() << " hits, " << misses()
+                               << " misses, "
+                               << stale_.load(std::memory_order_relaxed)
+                               << " stale, " << idle << " idle ("
+                               << refillFailures_.load(std::memory_order_relaxed)
+                               << " refills failed), "
+                               << multiplexed() << " multiplexed ("
+                               << muxCalls << " active on " << muxReady
+                               << " streams)");
+}
+
+std::shared_ptr<VoiceBotClient> StreamPool::open(const std::string &target,
+                                                 const std::string &callId) {
+  auto client =
+      std::make_shared<VoiceBotClient>(target, callId, uplinkQueueFrames_);
+  if (!client->connect())
+    return nullptr;
+  return client;
+}
+
+void StreamPool::watch(const std::string &target) {
+  if (shutdown_ || streamsPerTarget_ == 0)
+    return;
+  idle_[target];
+  if (!refillThread_.joinable())
+    refillThread_ = std::thread(&StreamPool::refillLoop, this);
+}
+
+void StreamPool::refillLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!shutdown_) {
+    std::vector<std::shared_ptr<VoiceBotClient>> stale;
+    const std::string *missing = nullptr;
+    for (auto &entry : idle_) {
+      auto &idle = entry.second;
+      for (auto it = idle.begin(); it != idle.end();) {
+        if ((*it)->isOpen()) {
+          ++it;
+          continue;
+        }
+        stale.push_back(std::move(*it));
+        it = idle.erase(it);
+      }
+      if (!missing &&
+          idle.size() + opening_[entry.first] < (size_t)streamsPerTarget_)
+        missing = &entry.first;
+    }
+
+    if (stale.empty() && !missing) {
+      wake_.wait_for(lock, kMaintainInterval);
+      continue;
+    }
+
+    // Opening and stopping streams is not done under the lock
+    std::string target = missing ? *missing : std::string();
+    if (missing)
+      opening_[target]++;
+    lock.unlock();
+    for (auto &s : stale) {
+      s->stop();
+      stale_.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::shared_ptr<VoiceBotClient> client;
+    if (!target.empty())
+      client = open(target, "");
+    lock.lock();
+
+    if (target.empty())
+      continue;
+    opening_[target]--;
+    auto it = idle_.find(target);
+    if (it == idle_.end()) {
+      // Shut down meanwhile
+      if (client) {
+        lock.unlock();
+        client->stop();
+        lock.lock();
+      }
+      continue;
+    }
+    if (!client) {
+      refillFailures_.fetch_add(1, std::memory_order_relaxed);
+      wake_.wait_for(lock, kMaintainInterval);
+      continue;
+    }
+    it->second.push_back(std::move(client));
+  }
+}
+
+std::shared_ptr<BotSession>
+StreamPool::attachMux(const std::string &target, const std::string &callId) {
+  std::vector<std::shared_ptr<MuxStream>> retired;
+  std::shared_ptr<BotSession> session;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (shutdown_ || muxStreamsPerTarget_ == 0)
+      return nullptr;
+    auto it = mux_.find(target);
+    if (it == mux_.end())
+      return nullptr;
+    auto &streams = it->second;
+
+    // Reopen streams the bot has closed, and stop offering multiplexing
+    // once it has declined. Calls still on a retired stream keep it alive.
+    for (size_t i = 0; i < streams.size();) {
+      if (streams[i]->state() == MuxStream::State::DECLINED) {
+        retired.push_back(std::move(streams[i]));
+        streams.erase(streams.begin() + i);
+        continue;
+      }
+      if (!streams[i]->isOpen()) {
+        retired.push_back(std::move(streams[i]));
+        streams[i] = openMux(target);
+      }
+      ++i;
+    }
+
+    for (size_t i = 0; i < streams.size() && !session; ++i)
+      session = streams[nextMux_++ % streams.size()]->attach(callId);
+  }
+  // Closing a stream waits for its RPC, so not under the lock
+  retired.clear();
+  return session;
+}
+
+std::shared_ptr<MuxStream> StreamPool::openMux(const std::string &target) {
+  auto stream = std::make_shared<MuxStream>(target, callsPerMuxStream_,
+                                            uplinkQueueFrames_);
+  stream->open();
+  return stream;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MuxStream.h"
+#include "VoiceBotClient.h"
+
+// Hands out bot sessions for calls. When multiplexing is enabled and the bot
+// agrees to it, calls share a few long-lived MuxStreams. Otherwise each call
+// gets its own StreamCall stream, claimed from a few kept open ahead of time
+// so an INVITE does not pay the stream setup round trip before the bot
+// hears any audio. Claimed streams are replaced by a background thread, so
+// acquire() never sets up a stream under the pool lock; on a miss the call
+// opens its own, as without the pool.
+class StreamPool {
+public:
+  static StreamPool &instance();
+
+  // streamsPerTarget idle streams are kept open per target; 0 disables
+  // pre-opening and every call opens its own stream. muxStreamsPerTarget
+  // multiplexed streams carrying up to callsPerMuxStream calls each are
+  // offered to the bot; 0 disables multiplexing.
+  void init(int streamsPerTarget, size_t uplinkQueueFrames,
+            int muxStreamsPerTarget = 0, int callsPerMuxStream = 64);
+
+  // Open the idle and multiplexed streams for target
+  void warm(const std::string &target);
+
+  // A session for callId: on a multiplexed stream if one has room, else on
+  // a stream of its own, pre-opened if one is available
+  std::shared_ptr<BotSession> acquire(const std::string &target,
+                                      const std::string &callId);
+
+  // Stop refilling and close the idle streams; later acquires open streams
+  // on demand
+  void shutdown();
+
+  void logStats() const;
+
+  uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+  uint64_t multiplexed() const {
+    return multiplexed_.load(std::memory_order_relaxed);
+  }
+
+private:
+  StreamPool() = default;
+
+  std::shared_ptr<VoiceBotClient> open(const std::string &target,
+                                       const std::string &callId);
+  // mutex_ held: keep target's idle streams topped up
+  void watch(const std::string &target);
+  void refillLoop();
+  std::shared_ptr<BotSession> attachMux(const std::string &target,
+                                        const std::string &callId);
+  std::shared_ptr<MuxStream> openMux(const std::string &target);
+
+  int streamsPerTarget_ = 0;
+  size_t uplinkQueueFrames_ = 50;
+  int muxStreamsPerTarget_ = 0;
+  int callsPerMuxStream_ = 64;
+  bool shutdown_ = false;
+  std::map<std::string, std::deque<std::shared_ptr<VoiceBotClient>>> idle_;
+  std::map<std::string, size_t> opening_; // by the refill thread, per target
+  std::thread refillThread_;              // started with the first target
+  std::condition_variable wake_;
+  std::map<std::string, std::vector<std::shared_ptr<MuxStream>>> mux_;
+  size_t nextMux_ = 0;
+  mutable std::mutex mutex_;
+
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> stale_{0}; // idle streams the bot had closed
+  std::atomic<uint64_t> refillFailures_{0};
+  std::atomic<uint64_t> multiplexed_{0};
+};
@@ -1,95 +1,143 @@
 #include "VoiceBotClient.h"
 #include "../app/Logger.h"
+#include <algorithm>
+#include <cstring>
 
 VoiceBotClient::VoiceBotClient(const std::string &target,
-                               const std::string &callId)
-    : target_(target), callId_(callId) {
-  channel_ = grpc::CreateChannel(target_, grpc::InsecureChannelCredentials());
-  stub_ = voicebot::VoiceBot::NewStub(channel_);
-}
+                               const std::string &callId,
+                               size_t uplinkQueueFrames)
+    : BotStream(target, uplinkQueueFrames + kControlSlack), callId_(callId),
+      maxQueuedAudio_(uplinkQueueFrames) {}
 
 VoiceBotClient::~VoiceBotClient() { stop(); }
 
-bool VoiceBotClient::connect() {
-  context_ = std::make_unique<grpc::ClientContext>();
-  stream_ = stub_->StreamCall(context_.get());
+bool VoiceBotClient::connect() { return open(); }
 
-  if (!stream_)
-    return false;
+void VoiceBotClient::bind(const std::string &callId) {
+  std::lock_guard<std::mutex> lock(idMutex_);
+  callId_ = callId;
+}
 
-  running_ = true;
-  readerThread_ = std::thread(&VoiceBotClient::readerLoop, this);
-  return true;
+std::string VoiceBotClient::describe() const {
+  std::lock_guard<std::mutex> lock(idMutex_);
+  return "call " + (callId_.empty() ? std::string("(unbound)") : callId_);
 }
 
 void VoiceBotClient::stop() {
-  if (!running_)
+  if (stopped_.exchange(true))
     return;
-  running_ = false;
+  {
+    std::unique_lock<std::mutex> lock(callbackMutex_);
+    audioCb_ = nullptr;
+    controlCb_ = nullptr;
+    waitForDispatch(lock);
+  }
+  close();
 
-  // Cancel context to unblock reader
-  if (context_)
-    context_->TryCancel();
+  uint64_t dropped = droppedFrames();
+  if (dropped > 0) {
+    LOG_WARN("VoiceBot uplink for " << describe() << " dropped " << dropped
+                                    << " frames, bot fell behind");
+  }
+}
 
-  if (stream_) {
-    // stream_->WritesDone(); // Can deadlock if reader is blocked
-    // context cancel is better
+void VoiceBotClient::onAction(const voicebot::CallAction &action) {
+  AudioCallback audioCb;
+  ControlCallback controlCb;
+  {
+    std::lock_guard<std::mutex> lock(callbackMutex_);
+    if (action.has_audio())
+      audioCb = audioCb_;
+    else if (action.has_control())
+      controlCb = controlCb_;
+    if (!audioCb && !controlCb)
+      return;
+    dispatching_ = true;
+    dispatchingThread_ = std::this_thread::get_id();
   }
 
-  if (readerThread_.joinable()) {
-    readerThread_.join();
+  // Not under the lock: the callback may stop or send on its call
+  if (audioCb)
+    audioCb(action.audio().data());
+  else
+    controlCb(action.control());
+
+  {
+    std::lock_guard<std::mutex> lock(callbackMutex_);
+    dispatching_ = false;
   }
+  dispatched_.notify_all();
 }
 
-void VoiceBotClient::readerLoop() {
-  voicebot::CallAction action;
-  while (running_ && stream_->Read(&action)) {
-    if (action.has_audio()) {
-      if (audioCb_) {
-        audioCb_(action.audio().data());
-      }
-    } else if (action.has_control()) {
-      if (controlCb_) {
-        controlCb_(action.control());
-      }
-    }
-  }
-  LOG_INFO("VoiceBot stream closed for call " << callId_);
-  running_ = false;
+void VoiceBotClient::waitForDispatch(std::unique_lock<std::mutex> &lock) {
+  dispatched_.wait(lock, [this] {
+    return !dispatching_ || dispatchingThread_ == std::this_thread::get_id();
+  });
 }
 
-void VoiceBotClient::setAudioCallback(AudioCallback cb) { audioCb_ = cb; }
+void VoiceBotClient::onDequeued(const Outbound &out,
+                                voicebot::CallEvent &event) {
+  if (out.type == Outbound::Type::AUDIO)
+    queuedAudio_.fetch_sub(1, std::memory_order_relaxed);
+  // Every event names its call. event is reused, so this copies into the
+  // capacity of the last id rather than allocating. bind() happens before
+  // the first enqueue, so no lock is needed here.
+  event.set_call_id(callId_);
+}
 
-void VoiceBotClient::setControlCallback(ControlCallback cb) { controlCb_ = cb; }
+// Once these return, the callback they replaced is no longer running
+void VoiceBotClient::setAudioCallback(AudioCallback cb) {
+  std::unique_lock<std::mutex> lock(callbackMutex_);
+  audioCb_ = std::move(cb);
+  waitForDispatch(lock);
+}
+
+void VoiceBotClient::setControlCallback(ControlCallback cb) {
+  std::unique_lock<std::mutex> lock(callbackMutex_);
+  controlCb_ = std::move(cb);
+  waitForDispatch(lock);
+}
 
 void VoiceBotClient::sendConfig(int rate, int codec) {
   if (!running_)
     return;
-  voicebot::CallEvent event;
-  event.set_call_id(callId_);
-  auto cfg = event.mutable_config();
-  cfg->set_sample_rate(rate);
-  cfg->set_codec(codec == 0 ? voicebot::PCMU : voicebot::PCMA);
-  stream_->Write(event);
+  Outbound out;
+  out.type = Outbound::Type::CONFIG;
+  out.sampleRate = rate;
+  out.codec = codec;
+  if (!enqueue(std::move(out)))
+    LOG_ERROR("VoiceBot uplink queue full, config dropped for " << describe());
 }
 
-void VoiceBotClient::sendAudio(const std::vector<char> &data, uint64_t seq) {
+bool VoiceBotClient::sendAudio(const uint8_t *data, size_t len, uint64_t seq,
+                               uint32_t timestamp) {
   if (!running_)
-    return;
-  voicebot::CallEvent event;
-  event.set_call_id(callId_);
-  auto audio = event.mutable_audio();
-  audio->set_data(data.data(), data.size());
-  audio->set_seq(seq);
-  // Timestamp logic if needed
-  stream_->Write(event);
+    return false;
+  // Audio may use all but kControlSlack slots
+  if (queuedAudio_.fetch_add(1, std::memory_order_relaxed) >= maxQueuedAudio_) {
+    queuedAudio_.fetch_sub(1, std::memory_order_relaxed);
+    droppedFrames_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  Outbound out;
+  out.type = Outbound::Type::AUDIO;
+  out.seq = seq;
+  out.timestamp = timestamp;
+  out.len = std::min(len, sizeof(out.data));
+  memcpy(out.data, data, out.len);
+  if (!enqueue(std::move(out))) {
+    queuedAudio_.fetch_sub(1, std::memory_order_relaxed);
+    droppedFrames_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
 }
 
 void VoiceBotClient::sendHangup() {
   if (!running_)
     return;
-  voicebot::CallEvent event;
-  event.set_call_id(callId_);
-  event.mutable_control()->set_type(voicebot::ControlEvent::HANGUP);
-  stream_->Write(event);
+  Outbound out;
+  out.type = Outbound::Type::HANGUP;
+  if (!enqueue(std::move(out)))
+    LOG_ERROR("VoiceBot uplink queue full, hangup dropped for " << describe());
 }
@@ -1,50 +1,72 @@
 #pragma once
 
 #include <atomic>
-#include <functional>
-#include <memory>
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <thread>
 
-#include "voicebot.grpc.pb.h"
-#include "voicebot.pb.h"
-#include <grpcpp/grpcpp.h>
+#include "BotSession.h"
+#include "BotStream.h"
 
-class VoiceBotClient {
+// A call with a StreamCall stream of its own
+class VoiceBotClient : public BotSession, private BotStream {
 public:
-  using AudioCallback = std::function<void(const std::string &data)>;
-  using ControlCallback = std::function<void(const voicebot::BotControl &)>;
-
-  VoiceBotClient(const std::string &target, const std::string &callId);
+  // uplinkQueueFrames bounds how far the bot may fall behind before new
+  // audio is dropped. callId may be left empty for a pre-opened stream and
+  // set later with bind().
+  VoiceBotClient(const std::string &target, const std::string &callId,
+                 size_t uplinkQueueFrames = 50);
   ~VoiceBotClient();
 
   bool connect();
-  void setAudioCallback(AudioCallback cb);
-  void setControlCallback(ControlCallback cb);
+  // Attach the stream to a call; must precede the first send
+  void bind(const std::string &callId);
+  using BotStream::isOpen;
 
-  // Sending to Bot
-  void sendConfig(int rate, int codec); // 0=PCMU, 8=PCMA
-  void sendAudio(const std::vector<char> &data, uint64_t seq);
-  void sendHangup();
+  void setAudioCallback(AudioCallback cb) override;
+  void setControlCallback(ControlCallback cb) override;
 
-  void stop();
+  void sendConfig(int rate, int codec) override;
+  bool sendAudio(const uint8_t *data, size_t len, uint64_t seq,
+                 uint32_t timestamp) override;
+  void sendHangup() override;
 
-private:
-  std::string target_;
-  std::string callId_;
+  uint64_t droppedFrames() const override {
+    return droppedFrames_.load(std::memory_order_relaxed);
+  }
 
-  std::shared_ptr<grpc::Channel> channel_;
-  std::unique_ptr<voicebot::VoiceBot::Stub> stub_;
-  std::unique_ptr<grpc::ClientContext> context_;
-  std::unique_ptr<
-      grpc::ClientReaderWriter<voicebot::CallEvent, voicebot::CallAction>>
-      stream_;
+  void stop() override;
 
-  std::thread readerThread_;
-  std::atomic<bool> running_{false};
+private:
+  // Written by bind() before anything is queued; describe() may run
+  // concurrently on gRPC threads, hence idMutex_
+  std::string callId_;
+  mutable std::mutex idMutex_;
 
+  // Set by the call while the reactor may be delivering actions. The
+  // reactor runs a copy outside callbackMutex_, so a callback may call back
+  // into the client; the setters and stop() wait for it to finish unless
+  // they are called from inside it.
   AudioCallback audioCb_;
   ControlCallback controlCb_;
+  std::mutex callbackMutex_;
+  bool dispatching_ = false;
+  std::thread::id dispatchingThread_;
+  std::condition_variable dispatched_;
+  // stop() may run on a SIP thread, the stream pool or the last owner
+  std::atomic<bool> stopped_{false};
+
+  static constexpr size_t kControlSlack = 8; // queue room kept for control
+
+  size_t maxQueuedAudio_;
+  std::atomic<size_t> queuedAudio_{0};
+  std::atomic<uint64_t> droppedFrames_{0};
+
+  void waitForDispatch(std::unique_lock<std::mutex> &lock);
 
-  void readerLoop();
+  // BotStream
+  void onAction(const voicebot::CallAction &action) override;
+  void onDequeued(const Outbound &out, voicebot::CallEvent &event) override;
+  std::string describe() const override;
 };
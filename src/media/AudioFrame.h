@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// One packetization interval of encoded audio flowing through the
+// MediaPipeline. Storage is inline and fixed, so frames are owned by the call
+// and reused every interval; stages read and rewrite them in place.
+struct AudioFrame {
+  static constexpr size_t kCapacity = 480; // 60 ms of G.711 at 8 kHz
+
+  enum class Direction : uint8_t { UPLINK, DOWNLINK };
+
+  uint8_t data[kCapacity];
+  size_t size = 0;
+  uint32_t timestamp = 0; // RTP timestamp of the first sample
+  uint16_t seq = 0;
+  int payloadType = -1;   // RTP payload type of data
+  Direction direction = Direction::UPLINK;
+  bool concealed = false; // synthesised by loss concealment
+  bool marker = false;    // first frame of a talkspurt (RTP marker bit)
+
+  bool empty() const { return size == 0; }
+
+  void clear() {
+    size = 0;
+    concealed = false;
+    marker = false;
+  }
+
+  // Replaces the payload, truncating to kCapacity. Returns the bytes kept.
+  size_t assign(const void *src, size_t len) {
+    size = len < kCapacity ? len : kCapacity;
+    memcpy(data, src, size);
+    return size;
+  }
+
+  // Payload and metadata, without touching the unused tail of data
+  void copyFrom(const AudioFrame &other) {
+    assign(other.data, other.size);
+    timestamp = other.timestamp;
+    seq = other.seq;
+    payloadType = other.payloadType;
+    direction = other.direction;
+    concealed = other.concealed;
+    marker = other.marker;
+  }
+};
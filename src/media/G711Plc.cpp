@@ -0,0 +1,99 @@
+#include "G711Plc.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static int16_t saturate(float v) {
+  if (v > 32767.0f)
+    return 32767;
+  if (v < -32768.0f)
+    return -32768;
+  return (int16_t)lrintf(v);
+}
+
+void G711Plc::saveHistory(const int16_t *pcm, size_t len) {
+  if (len >= (size_t)kHistoryLen) {
+    memcpy(history_, pcm + len - kHistoryLen, sizeof(history_));
+    return;
+  }
+  memmove(history_, history_ + len, (kHistoryLen - len) * sizeof(int16_t));
+  memcpy(history_ + kHistoryLen - len, pcm, len * sizeof(int16_t));
+}
+
+int G711Plc::findPitch() const {
+  // Average magnitude difference between the newest kCorrLen samples and the
+  // same window one candidate period earlier; the best period minimises it.
+  const int16_t *recent = history_ + kHistoryLen - kCorrLen;
+  int best = kPitchMin;
+  long bestScore = -1;
+  for (int lag = kPitchMin; lag <= kPitchMax; ++lag) {
+    const int16_t *past = recent - lag;
+    long score = 0;
+    for (int i = 0; i < kCorrLen; ++i) {
+      score += std::abs(recent[i] - past[i]);
+    }
+    if (bestScore < 0 || score < bestScore) {
+      bestScore = score;
+      best = lag;
+    }
+  }
+  return best;
+}
+
+float G711Plc::gainAt(size_t erased) const {
+  if (erased < (size_t)kUnattenuated)
+    return 1.0f;
+  float gain = 1.0f - (float)(erased - kUnattenuated) / kFadeOut;
+  return gain > 0.0f ? gain : 0.0f;
+}
+
+void G711Plc::conceal(int16_t *pcm, size_t len) {
+  if (erasedSamples_ == 0) {
+    // Start of a loss: take the last pitch period and cross-fade its tail
+    // into the period before it. The sample preceding last[0] in the real
+    // signal is prev[pitch_ - 1], so looping the buffer stays continuous.
+    pitch_ = findPitch();
+    int overlap = pitch_ / 4;
+    const int16_t *last = history_ + kHistoryLen - pitch_;
+    const int16_t *prev = last - pitch_;
+    for (int i = 0; i < pitch_ - overlap; ++i) {
+      pitchBuf_[i] = last[i];
+    }
+    for (int i = pitch_ - overlap; i < pitch_; ++i) {
+      float w = (float)(i - (pitch_ - overlap) + 1) / (overlap + 1);
+      pitchBuf_[i] = (1.0f - w) * last[i] + w * prev[i];
+    }
+    pitchOffset_ = 0;
+  }
+
+  for (size_t i = 0; i < len; ++i) {
+    pcm[i] = saturate(pitchBuf_[pitchOffset_] * gainAt(erasedSamples_ + i));
+    if (++pitchOffset_ >= pitch_)
+      pitchOffset_ = 0;
+  }
+  erasedSamples_ += len;
+  saveHistory(pcm, len);
+}
+
+bool G711Plc::receive(int16_t *pcm, size_t len) {
+  bool merged = false;
+  if (erasedSamples_ > 0) {
+    // Fade from the synthetic signal into the real one. Longer losses get a
+    // longer cross-fade (4 ms per 10 ms lost on top of a quarter period).
+    size_t overlap = pitch_ / 4 + (erasedSamples_ / 80) * 32;
+    if (overlap > len)
+      overlap = len;
+    float gain = gainAt(erasedSamples_);
+    for (size_t i = 0; i < overlap; ++i) {
+      float w = (float)(i + 1) / (overlap + 1);
+      float synthetic = pitchBuf_[pitchOffset_] * gain;
+      pcm[i] = saturate(w * pcm[i] + (1.0f - w) * synthetic);
+      if (++pitchOffset_ >= pitch_)
+        pitchOffset_ = 0;
+    }
+    erasedSamples_ = 0;
+    merged = overlap > 0;
+  }
+  saveHistory(pcm, len);
+  return merged;
+}
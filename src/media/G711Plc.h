@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Packet loss concealment after ITU-T G.711 Appendix I, working on 8 kHz
+// linear PCM. Every good frame goes through receive() so the history stays
+// current; conceal() synthesises a missing frame by repeating the last pitch
+// period. Output is attenuated by 20% per 10 ms after the first 10 ms and is
+// silent after 60 ms. The first good frame after a loss is cross-faded with
+// the synthetic signal to avoid a click.
+class G711Plc {
+public:
+  // Returns true if the frame was modified (merged with the concealment)
+  bool receive(int16_t *pcm, size_t len);
+  void conceal(int16_t *pcm, size_t len);
+
+  bool concealing() const { return erasedSamples_ > 0; }
+
+private:
+  static constexpr int kPitchMin = 40;   // 200 Hz
+  static constexpr int kPitchMax = 120;  // 66 Hz
+  static constexpr int kCorrLen = 160;   // 20 ms correlation window
+  static constexpr int kHistoryLen = 390; // 3.25 x kPitchMax
+  static constexpr int kUnattenuated = 80;  // first 10 ms at full level
+  static constexpr int kFadeOut = 400;      // then 50 ms down to silence
+
+  void saveHistory(const int16_t *pcm, size_t len);
+  int findPitch() const;
+  float gainAt(size_t erased) const;
+
+  int16_t history_[kHistoryLen] = {};
+  float pitchBuf_[kPitchMax] = {};
+  int pitch_ = kPitchMin;
+  int pitchOffset_ = 0;
+  size_t erasedSamples_ = 0;
+};
@@ -4,26 +4,20 @@ void MediaPipeline::addStage(std::shared_ptr<Stage> stage) {
   stages_.push_back(stage);
 }
 
-void MediaPipeline::processUplink(const std::vector<char> &input) {
+void MediaPipeline::processUplink(AudioFrame &frame) {
   // Pipeline: Stage1 -> Stage2 -> ...
-  std::vector<char> current = input;
+  frame.direction = AudioFrame::Direction::UPLINK;
   for (auto &stage : stages_) {
-    stage->processUplink(current);
+    stage->processUplink(frame);
   }
 }
 
-std::vector<char> MediaPipeline::processDownlink() {
-  // Pipeline: Stage1 <- Stage2 <- ...
-  // Wait, typically downlink generation starts from a source (like GrpcBridge)
-  // and flows through modifiers (like Recorder).
-  // Let's iterate normally: Stage 1 fills, Stage 2 detects it..
-  // Or Reverse?
-  // Let's assume order is [Bridge, Echo, Recorder]
-  // Bridge fills downlink. Echo fills if empty. Recorder records.
-
-  std::vector<char> current; // Start empty
+void MediaPipeline::processDownlink(AudioFrame &frame) {
+  // Stages run in order too: a source (Bridge, Echo) fills the empty frame
+  // and the ones after it (Recorder) observe it.
+  frame.clear();
+  frame.direction = AudioFrame::Direction::DOWNLINK;
   for (auto &stage : stages_) {
-    stage->processDownlink(current);
+    stage->processDownlink(frame);
   }
-  return current;
 }
@@ -1,15 +1,21 @@
 #pragma once
 
+#include "AudioFrame.h"
 #include "stages/Stage.h"
 #include <memory>
 #include <vector>
 
+// Runs each frame through the stages in order. Frames are owned by the
+// caller and processed in place, so a steady-state frame costs no heap
+// allocation here.
 class MediaPipeline {
 public:
   void addStage(std::shared_ptr<Stage> stage);
 
-  void processUplink(const std::vector<char> &input);
-  std::vector<char> processDownlink();
+  void processUplink(AudioFrame &frame);
+  // Clears frame, then lets the stages fill it. Empty on return means there
+  // is nothing to send this interval.
+  void processDownlink(AudioFrame &frame);
 
 private:
   std::vector<std::shared_ptr<Stage>> stages_;
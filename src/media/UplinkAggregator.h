@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "AudioFrame.h"
+
+// Coalesces consecutive uplink frames of 8 kHz G.711 into chunks of up to
+// windowMs, so the bot side gets one message per window instead of one per
+// packet. A chunk is cut early at talkspurt boundaries (RTP marker, timestamp
+// gap, payload type change) and when the caller reports an interval without
+// uplink audio, so speech onsets and ends are never held back. A 20 ms window
+// passes every frame straight through.
+class UplinkAggregator {
+public:
+  static constexpr size_t kMaxBytes = 800; // 100 ms
+
+  explicit UplinkAggregator(int windowMs) {
+    size_t bytes = windowMs > 0 ? (size_t)windowMs * 8 : 0;
+    windowBytes_ = bytes < kMaxBytes ? bytes : kMaxBytes;
+  }
+
+  // Adds frame; emit(const uint8_t *data, size_t len, uint32_t timestamp)
+  // runs for every chunk completed by it
+  template <typename Emit> void push(const AudioFrame &frame, Emit &&emit) {
+    if (frame.empty())
+      return;
+    if (size_ > 0 &&
+        (frame.marker || frame.payloadType != payloadType_ ||
+         frame.timestamp != timestamp_ + (uint32_t)size_ ||
+         size_ + frame.size > kMaxBytes))
+      flush(emit);
+    if (size_ == 0) {
+      timestamp_ = frame.timestamp;
+      payloadType_ = frame.payloadType;
+    }
+    size_t n = frame.size < kMaxBytes ? frame.size : kMaxBytes;
+    memcpy(buf_ + size_, frame.data, n);
+    size_ += n;
+    if (size_ >= windowBytes_)
+      flush(emit);
+  }
+
+  // Sends whatever is pending, e.g. when an interval passed without audio
+  template <typename Emit> void flush(Emit &&emit) {
+    if (size_ == 0)
+      return;
+    emit(buf_, size_, timestamp_);
+    size_ = 0;
+  }
+
+  size_t pending() const { return size_; }
+
+private:
+  uint8_t buf_[kMaxBytes];
+  size_t size_ = 0;
+  size_t windowBytes_;
+  uint32_t timestamp_ = 0; // RTP timestamp of the first pending sample
+  int payloadType_ = -1;
+};
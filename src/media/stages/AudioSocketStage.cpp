@@ -1,78 +1,84 @@
 #include "AudioSocketStage.h"
+#include "../../app/Logger.h"
 #include "../../util/G711Utils.h"
+#include <algorithm>
 #include <cstring>
 
-AudioSocketStage::AudioSocketStage(std::shared_ptr<AudioSocketClient> client, int payloadType)
-    : client_(client), payloadType_(payloadType) {
-    client_->setAudioCallback([this](const std::vector<char> &data) {
-        this->onAudioSocketData(data);
+AudioSocketStage::AudioSocketStage(std::shared_ptr<AudioSocketClient> client, int payloadType,
+                                   float uplinkGain, float downlinkGain,
+                                   int aggregationMs)
+    : client_(client), payloadType_(payloadType),
+      uplinkGainQ8_(G711Utils::gainToQ8(uplinkGain)),
+      downlinkGainQ8_(G711Utils::gainToQ8(downlinkGain)),
+      aggregator_(aggregationMs),
+      downlink_(kDownlinkCapacity, kDownlinkMaxBacklog) {
+    client_->setAudioCallback([this](const char *data, size_t len) {
+        this->onAudioSocketData(data, len);
     });
 }
 
-void AudioSocketStage::onAudioSocketData(const std::vector<char> &data) {
-    // data is PCM16 Little Endian (based on user feedback)
-    if (data.size() % 2 != 0) return;
-
-    std::vector<int16_t> pcm(data.size() / 2);
-    memcpy(pcm.data(), data.data(), data.size());
-
-    // Apply gain (3x to address 'low voice')
-    for (auto &sample : pcm) {
-        int32_t val = static_cast<int32_t>(sample) * 3;
-        if (val > 32767) val = 32767;
-        if (val < -32768) val = -32768;
-        sample = static_cast<int16_t>(val);
-    }
+AudioSocketStage::~AudioSocketStage() {
+    LOG_DEBUG("AudioSocket downlink: dropped " << downlink_.overflowBytes()
+              << " bytes, " << downlink_.underruns() << " underruns");
+}
 
-    std::vector<char> encoded;
-    if (payloadType_ == 0) { // PCMU
-        G711Utils::encodeULaw(pcm, encoded);
-    } else { // PCMA (8)
-        G711Utils::encodeALaw(pcm, encoded);
-    }
+void AudioSocketStage::onAudioSocketData(const char *data, size_t len) {
+    // data is PCM16 Little Endian (based on user feedback)
+    if (len % 2 != 0) return;
+    size_t samples = len / 2;
 
-    std::lock_guard<std::mutex> lock(mutex_);
-    downlinkBuffer_.insert(downlinkBuffer_.end(), encoded.begin(), encoded.end());
-    
-    // Bounded buffer: 2 seconds of audio (8kHz * 1 byte/sample = 8000 bytes/sec)
-    if (downlinkBuffer_.size() > 16000) {
-        downlinkBuffer_.erase(downlinkBuffer_.begin(), downlinkBuffer_.begin() + (downlinkBuffer_.size() - 16000));
+    // Gain and encode in one pass, a stack-sized chunk at a time, then hand
+    // the bytes to the media thread through the ring. data sits in the
+    // client's receive buffer at any alignment, so samples are copied out
+    // first.
+    int16_t pcm[1024];
+    uint8_t encoded[1024];
+    while (samples > 0) {
+        size_t n = std::min(samples, sizeof(encoded));
+        memcpy(pcm, data, n * 2);
+        if (payloadType_ == 0) { // PCMU
+            G711Utils::encodeULaw(pcm, encoded, n, downlinkGainQ8_);
+        } else { // PCMA (8)
+            G711Utils::encodeALaw(pcm, encoded, n, downlinkGainQ8_);
+        }
+        downlink_.write(encoded, n);
+        data += n * 2;
+        samples -= n;
     }
 }
 
-void AudioSocketStage::processUplink(std::vector<char> &audio) {
-    if (audio.empty()) return;
-
-    // audio is G.711 (PCMU/PCMA)
-    // We need to decode it to PCM16 for AudioSocket
-    std::vector<int16_t> pcm;
+void AudioSocketStage::sendChunk(const uint8_t *data, size_t len) {
+    // data is G.711 (PCMU/PCMA); AudioSocket wants PCM16, so decode and
+    // apply the gain in one pass
+    int16_t pcm[UplinkAggregator::kMaxBytes];
     if (payloadType_ == 0) {
-        G711Utils::decodeULaw(audio, pcm);
+        G711Utils::decodeULaw(data, pcm, len, uplinkGainQ8_);
     } else {
-        G711Utils::decodeALaw(audio, pcm);
+        G711Utils::decodeALaw(data, pcm, len, uplinkGainQ8_);
     }
+    client_->sendAudio(pcm, len);
+}
 
-    // Apply gain (3x to address 'low voice')
-    for (auto &sample : pcm) {
-        int32_t val = static_cast<int32_t>(sample) * 3;
-        if (val > 32767) val = 32767;
-        if (val < -32768) val = -32768;
-        sample = static_cast<int16_t>(val);
-    }
+void AudioSocketStage::processUplink(AudioFrame &frame) {
+    if (frame.empty() || !client_) return;
 
-    std::vector<char> pcmBytes(pcm.size() * 2);
-    memcpy(pcmBytes.data(), pcm.data(), pcmBytes.size());
+    uplinkActive_ = true;
+    aggregator_.push(frame, [this](const uint8_t *data, size_t len, uint32_t) {
+        sendChunk(data, len);
+    });
+}
 
-    if (client_) {
-        client_->sendAudio(pcmBytes);
+void AudioSocketStage::processDownlink(AudioFrame &frame) {
+    // Runs every interval; no uplink audio since the last one means the
+    // talkspurt ended, so don't hold back its tail
+    if (!uplinkActive_ && aggregator_.pending() > 0) {
+        aggregator_.flush([this](const uint8_t *data, size_t len, uint32_t) {
+            sendChunk(data, len);
+        });
     }
-}
+    uplinkActive_ = false;
 
-void AudioSocketStage::processDownlink(std::vector<char> &audio) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (downlinkBuffer_.size() >= 160) {
-        audio.clear();
-        audio.insert(audio.end(), downlinkBuffer_.begin(), downlinkBuffer_.begin() + 160);
-        downlinkBuffer_.erase(downlinkBuffer_.begin(), downlinkBuffer_.begin() + 160);
+    if (downlink_.read(frame.data, 160)) {
+        frame.size = 160;
     }
 }
@@ -2,21 +2,36 @@
 
 #include "Stage.h"
 #include "../../audiosocket/AudioSocketClient.h"
+#include "../../util/SpscByteRing.h"
+#include "../UplinkAggregator.h"
 #include <memory>
-#include <mutex>
 
 class AudioSocketStage : public Stage {
 public:
-    AudioSocketStage(std::shared_ptr<AudioSocketClient> client, int payloadType);
+    // Gains are linear factors applied to the PCM exchanged with AudioSocket.
+    // Uplink audio is sent in frames of up to aggregationMs.
+    AudioSocketStage(std::shared_ptr<AudioSocketClient> client, int payloadType,
+                     float uplinkGain = 3.0f, float downlinkGain = 3.0f,
+                     int aggregationMs = 20);
+    ~AudioSocketStage();
     
-    void processUplink(std::vector<char> &audio) override;
-    void processDownlink(std::vector<char> &audio) override;
+    void processUplink(AudioFrame &frame) override;
+    void processDownlink(AudioFrame &frame) override;
 
 private:
-    void onAudioSocketData(const std::vector<char> &data);
+    void onAudioSocketData(const char *data, size_t len);
+    void sendChunk(const uint8_t *data, size_t len);
 
     std::shared_ptr<AudioSocketClient> client_;
     int payloadType_;
-    std::vector<char> downlinkBuffer_;
-    std::mutex mutex_;
+    int uplinkGainQ8_;
+    int downlinkGainQ8_;
+    UplinkAggregator aggregator_;
+    bool uplinkActive_ = false; // uplink audio seen since the last downlink tick
+
+    // Encoded downlink audio: written by the AudioSocket reader thread, read
+    // by the media thread. Backlog is capped at 2 s (8000 bytes/sec).
+    static constexpr size_t kDownlinkCapacity = 32768;
+    static constexpr size_t kDownlinkMaxBacklog = 16000;
+    SpscByteRing downlink_;
 };
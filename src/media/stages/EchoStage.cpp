@@ -1,17 +1,19 @@
 #include "EchoStage.h"
 
-void EchoStage::processUplink(std::vector<char> &audio) {
-  if (!audio.empty()) {
-    buffer_ = audio;
+void EchoStage::processUplink(AudioFrame &frame) {
+  if (!frame.empty()) {
+    buffer_.copyFrom(frame);
     hasData_ = true;
   }
 }
 
-void EchoStage::processDownlink(std::vector<char> &audio) {
+void EchoStage::processDownlink(AudioFrame &frame) {
   if (hasData_) {
     // If downlink is empty (usually is, coming from bot), fill it with echo
-    if (audio.empty()) {
-      audio = buffer_;
+    if (frame.empty()) {
+      frame.assign(buffer_.data, buffer_.size);
+      frame.payloadType = buffer_.payloadType;
+      frame.concealed = buffer_.concealed;
     }
     hasData_ = false;
   }
@@ -13,10 +13,11 @@
 
 class EchoStage : public Stage {
 public:
-  void processUplink(std::vector<char> &audio) override;
-  void processDownlink(std::vector<char> &audio) override;
+  void processUplink(AudioFrame &frame) override;
+  void processDownlink(AudioFrame &frame) override;
 
-  // Thread safe single frame buffer
-  std::vector<char> buffer_;
+  // Single frame buffer; uplink and downlink both run on the media thread,
+  // so it needs no lock
+  AudioFrame buffer_;
   bool hasData_ = false;
 };
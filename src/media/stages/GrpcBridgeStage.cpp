@@ -1,32 +1,49 @@
 #include "GrpcBridgeStage.h"
+#include "../../app/Logger.h"
 
-GrpcBridgeStage::GrpcBridgeStage(std::shared_ptr<VoiceBotClient> client)
-    : client_(client) {
+GrpcBridgeStage::GrpcBridgeStage(std::shared_ptr<BotSession> client,
+                                 int aggregationMs)
+    : client_(client), aggregator_(aggregationMs),
+      downlink_(kDownlinkCapacity, kDownlinkMaxBacklog) {
   client_->setAudioCallback(
       [this](const std::string &data) { this->onBotAudio(data); });
 }
 
+GrpcBridgeStage::~GrpcBridgeStage() {
+  LOG_DEBUG("Bot downlink: dropped " << downlink_.overflowBytes() << " bytes, "
+                                     << downlink_.underruns() << " underruns");
+}
+
 void GrpcBridgeStage::onBotAudio(const std::string &data) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  downlinkBuffer_.insert(downlinkBuffer_.end(), data.begin(), data.end());
-  
-  // Bounded buffer: 2 seconds of audio at 8kHz is 16000 bytes
-  if (downlinkBuffer_.size() > 16000) {
-    downlinkBuffer_.erase(downlinkBuffer_.begin(), downlinkBuffer_.begin() + (downlinkBuffer_.size() - 16000));
-  }
+  downlink_.write(data.data(), data.size());
 }
 
-void GrpcBridgeStage::processUplink(std::vector<char> &audio) {
-  if (client_ && !audio.empty()) {
-    client_->sendAudio(audio, seq_++);
+void GrpcBridgeStage::sendChunk(const uint8_t *data, size_t len,
+                                uint32_t timestamp) {
+  client_->sendAudio(data, len, seq_++, timestamp);
+}
+
+void GrpcBridgeStage::processUplink(AudioFrame &frame) {
+  if (client_ && !frame.empty()) {
+    uplinkActive_ = true;
+    aggregator_.push(frame,
+                     [this](const uint8_t *data, size_t len, uint32_t ts) {
+                       sendChunk(data, len, ts);
+                     });
   }
 }
 
-void GrpcBridgeStage::processDownlink(std::vector<char> &audio) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (downlinkBuffer_.size() >= 160) {
-    audio.clear();
-    audio.insert(audio.end(), downlinkBuffer_.begin(), downlinkBuffer_.begin() + 160);
-    downlinkBuffer_.erase(downlinkBuffer_.begin(), downlinkBuffer_.begin() + 160);
+void GrpcBridgeStage::processDownlink(AudioFrame &frame) {
+  // Runs every interval; no uplink audio since the last one means the
+  // talkspurt ended, so don't hold back its tail
+  if (!uplinkActive_ && aggregator_.pending() > 0) {
+    aggregator_.flush([this](const uint8_t *data, size_t len, uint32_t ts) {
+      sendChunk(data, len, ts);
+    });
+  }
+  uplinkActive_ = false;
+
+  if (downlink_.read(frame.data, 160)) {
+    frame.size = 160;
   }
 }
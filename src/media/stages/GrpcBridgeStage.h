@@ -1,24 +1,33 @@
 #pragma once
 
-#include "../../grpc/VoiceBotClient.h"
+#include "../../grpc/BotSession.h"
+#include "../../util/SpscByteRing.h"
+#include "../UplinkAggregator.h"
 #include "Stage.h"
-#include <deque>
-#include <mutex>
 
 class GrpcBridgeStage : public Stage {
 public:
-  GrpcBridgeStage(std::shared_ptr<VoiceBotClient> client);
+  // Uplink audio is sent in chunks of up to aggregationMs
+  GrpcBridgeStage(std::shared_ptr<BotSession> client, int aggregationMs = 20);
+  ~GrpcBridgeStage();
 
-  void processUplink(std::vector<char> &audio) override;
-  void processDownlink(std::vector<char> &audio) override;
+  void processUplink(AudioFrame &frame) override;
+  void processDownlink(AudioFrame &frame) override;
 
   // Callback from gRPC client to fill buffer
   void onBotAudio(const std::string &data);
 
 private:
-  std::shared_ptr<VoiceBotClient> client_;
+  void sendChunk(const uint8_t *data, size_t len, uint32_t timestamp);
 
-  std::mutex mutex_;
-  std::deque<char> downlinkBuffer_;
+  std::shared_ptr<BotSession> client_;
+  UplinkAggregator aggregator_;
+  bool uplinkActive_ = false; // uplink audio seen since the last downlink tick
+
+  // Bot audio: written from gRPC read callbacks, read by the media thread.
+  // Backlog is capped at 2 s of 8 kHz G.711.
+  static constexpr size_t kDownlinkCapacity = 32768;
+  static constexpr size_t kDownlinkMaxBacklog = 16000;
+  SpscByteRing downlink_;
   uint64_t seq_ = 0;
 };
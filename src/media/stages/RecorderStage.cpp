@@ -60,25 +60,27 @@ RecorderStage::~RecorderStage() {
   }
 }
 
-void RecorderStage::processUplink(std::vector<char> &audio) {
-  if (audio.empty()) return;
-  
-  std::lock_guard<std::mutex> lock(mutex_);
-  queue_.push_back({true, audio});
-  cv_.notify_one();
+void RecorderStage::processUplink(AudioFrame &frame) {
+  if (frame.empty()) return;
+  enqueue(frame);
 }
 
-void RecorderStage::processDownlink(std::vector<char> &audio) {
-  if (audio.empty()) return;
+void RecorderStage::processDownlink(AudioFrame &frame) {
+  if (frame.empty()) return;
+  enqueue(frame);
+}
 
+void RecorderStage::enqueue(const AudioFrame &frame) {
   std::lock_guard<std::mutex> lock(mutex_);
-  queue_.push_back({false, audio});
+  queue_.emplace_back();
+  queue_.back().copyFrom(frame);
   cv_.notify_one();
 }
 
 void RecorderStage::workerLoop() {
     while (true) {
-        std::vector<Chunk> buffer;
+        std::vector<AudioFrame> &buffer = drained_;
+        buffer.clear();
         {
             std::unique_lock<std::mutex> lock(mutex_);
             cv_.wait(lock, [this] { return !queue_.empty() || !running_; });
@@ -90,20 +92,18 @@ void RecorderStage::workerLoop() {
             buffer.swap(queue_);
         }
         
-        for (const auto& chunk : buffer) {
+        for (const AudioFrame &chunk : buffer) {
             if (recordingMode_) {
                 if (mixedFile_.is_open()) {
-                    std::vector<int16_t> pcm;
+                    // Decode straight onto the end of the direction's buffer
+                    bool isUplink = chunk.direction == AudioFrame::Direction::UPLINK;
+                    std::vector<int16_t> &target = isUplink ? ulBuffer_ : dlBuffer_;
+                    size_t offset = target.size();
+                    target.resize(offset + chunk.size);
                     if (payloadType_ == 0) {
-                        G711Utils::decodeULaw(chunk.data, pcm);
-                    } else {
-                        G711Utils::decodeALaw(chunk.data, pcm);
-                    }
-
-                    if (chunk.isUplink) {
-                        ulBuffer_.insert(ulBuffer_.end(), pcm.begin(), pcm.end());
+                        G711Utils::decodeULaw(chunk.data, target.data() + offset, chunk.size);
                     } else {
-                        dlBuffer_.insert(dlBuffer_.end(), pcm.begin(), pcm.end());
+                        G711Utils::decodeALaw(chunk.data, target.data() + offset, chunk.size);
                     }
 
                     // Simple mixer: write when we have data in both or one is much ahead
@@ -111,7 +111,8 @@ void RecorderStage::workerLoop() {
                     // Here we just mix what's available to keep it simple but effective.
                     size_t mixLen = std::min(ulBuffer_.size(), dlBuffer_.size());
                     if (mixLen > 0) {
-                        std::vector<int16_t> mixed(mixLen);
+                        std::vector<int16_t> &mixed = mixed_;
+                        mixed.resize(mixLen);
                         for (size_t i = 0; i < mixLen; ++i) {
                             int32_t sample = (int32_t)ulBuffer_[i] + (int32_t)dlBuffer_[i];
                             // Clamp to int16
@@ -135,10 +136,10 @@ void RecorderStage::workerLoop() {
                     }
                 }
             } else {
-                if (chunk.isUplink && uplinkFile_.is_open()) {
-                    uplinkFile_.write(chunk.data.data(), chunk.data.size());
-                } else if (!chunk.isUplink && downlinkFile_.is_open()) {
-                    downlinkFile_.write(chunk.data.data(), chunk.data.size());
+                if (chunk.direction == AudioFrame::Direction::UPLINK && uplinkFile_.is_open()) {
+                    uplinkFile_.write(reinterpret_cast<const char*>(chunk.data), chunk.size);
+                } else if (chunk.direction == AudioFrame::Direction::DOWNLINK && downlinkFile_.is_open()) {
+                    downlinkFile_.write(reinterpret_cast<const char*>(chunk.data), chunk.size);
                 }
             }
         }
@@ -13,15 +13,11 @@ public:
   RecorderStage(bool recordingMode, const std::string &pathPrefix, const std::string &callId, int payloadType);
   ~RecorderStage();
 
-  void processUplink(std::vector<char> &audio) override;
-  void processDownlink(std::vector<char> &audio) override;
+  void processUplink(AudioFrame &frame) override;
+  void processDownlink(AudioFrame &frame) override;
 
 private:
-  struct Chunk {
-      bool isUplink; // true = uplink, false = downlink
-      std::vector<char> data;
-  };
-
+  void enqueue(const AudioFrame &frame);
   void workerLoop();
 
   bool recordingMode_;
@@ -32,10 +28,14 @@ private:
   
   std::mutex mutex_;
   std::condition_variable cv_;
-  std::vector<Chunk> queue_;
+  // Swapped with drained_ by the worker, so both keep their capacity and
+  // steady-state enqueueing does not allocate
+  std::vector<AudioFrame> queue_;
+  std::vector<AudioFrame> drained_;
   bool running_ = false;
   std::thread worker_;
 
   std::vector<int16_t> ulBuffer_;
   std::vector<int16_t> dlBuffer_;
+  std::vector<int16_t> mixed_;
 };
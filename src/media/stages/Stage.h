@@ -1,15 +1,15 @@
 #pragma once
 
-#include <memory>
-#include <vector>
+#include "../AudioFrame.h"
 
 class Stage {
 public:
   virtual ~Stage() = default;
 
-  // Process audio chunk (uplink: IP -> Bot, downlink: Bot -> IP)
-  // For simplicity, we pass raw payload.
-  // Return modified or same payload.
-  virtual void processUplink(std::vector<char> &audio) = 0;
-  virtual void processDownlink(std::vector<char> &audio) = 0;
+  // Process one frame in place (uplink: IP -> Bot, downlink: Bot -> IP).
+  // Frames are owned by the call and reused, so stages must copy anything
+  // they keep. On downlink an empty frame means nothing has been produced
+  // yet; a stage may fill it.
+  virtual void processUplink(AudioFrame &frame) = 0;
+  virtual void processDownlink(AudioFrame &frame) = 0;
 };
@@ -0,0 +1,216 @@
+#include "IoUring.h"
+
+#ifdef RTP_HAVE_IO_URING
+
+#include "../app/Logger.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int sysSetup(unsigned entries, io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sysEnter(int fd, unsigned toSubmit, unsigned minComplete,
+                    unsigned flags, void *arg, size_t argSize) {
+  return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags,
+                      arg, argSize);
+}
+
+static int sysRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+IoUring::~IoUring() {
+  if (buffers_)
+    munmap(buffers_, buffersSize_);
+  if (bufRing_)
+    munmap(bufRing_, bufRingSize_);
+  if (sqes_)
+    munmap(sqes_, sqesSize_);
+  if (sqRing_)
+    munmap(sqRing_, sqRingSize_);
+  if (ringFd_ >= 0)
+    close(ringFd_);
+}
+
+bool IoUring::init(unsigned entries) {
+  io_uring_params p{};
+  // Multishot receives can complete far more often than we submit, so give
+  // the CQ headroom to avoid overflow.
+  p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+  p.cq_entries = entries * 8;
+  int fd = sysSetup(entries, &p);
+  if (fd < 0 && errno == EINVAL) {
+    // COOP_TASKRUN is 5.19+
+    p = {};
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 8;
+    fd = sysSetup(entries, &p);
+  }
+  if (fd < 0) {
+    LOG_WARN("io_uring_setup failed: " << strerror(errno));
+    return false;
+  }
+  if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+      !(p.features & IORING_FEAT_EXT_ARG)) {
+    LOG_WARN("io_uring kernel support too old (need single mmap + ext arg)");
+    close(fd);
+    return false;
+  }
+  ringFd_ = fd;
+
+  size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  sqRingSize_ = sqSize > cqSize ? sqSize : cqSize;
+  sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sqRing_ == MAP_FAILED) {
+    sqRing_ = nullptr;
+    LOG_WARN("io_uring ring mmap failed: " << strerror(errno));
+    return false;
+  }
+  cqRing_ = sqRing_;
+  cqRingSize_ = sqRingSize_;
+
+  sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    LOG_WARN("io_uring sqe mmap failed: " << strerror(errno));
+    return false;
+  }
+  sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  auto *sq = static_cast<uint8_t *>(sqRing_);
+  sqHead_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+  sqTail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+  sqMask_ = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+  sqArray_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+  sqEntries_ = p.sq_entries;
+  sqLocalTail_ = *sqTail_;
+
+  auto *cq = static_cast<uint8_t *>(cqRing_);
+  cqHead_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+  cqTail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+  cqMask_ = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+  return true;
+}
+
+io_uring_sqe *IoUring::getSqe() {
+  unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+  if (sqLocalTail_ - head >= sqEntries_) {
+    submit();
+    head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqLocalTail_ - head >= sqEntries_)
+      return nullptr;
+  }
+  unsigned idx = sqLocalTail_ & *sqMask_;
+  sqArray_[idx] = idx;
+  io_uring_sqe *sqe = &sqes_[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  sqLocalTail_++;
+  return sqe;
+}
+
+int IoUring::submit() {
+  unsigned toSubmit = sqLocalTail_ - *sqTail_;
+  if (toSubmit == 0)
+    return 0;
+  __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+  int ret = sysEnter(ringFd_, toSubmit, 0, 0, nullptr, 0);
+  return ret < 0 ? -errno : ret;
+}
+
+int IoUring::submitAndWait(unsigned waitNr, int timeoutMs) {
+  unsigned toSubmit = sqLocalTail_ - *sqTail_;
+  __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+
+  __kernel_timespec ts{};
+  ts.tv_sec = timeoutMs / 1000;
+  ts.tv_nsec = (long long)(timeoutMs % 1000) * 1000000;
+  io_uring_getevents_arg arg{};
+  arg.ts = (uint64_t)(uintptr_t)&ts;
+
+  int ret = sysEnter(ringFd_, toSubmit, waitNr,
+                     IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                     sizeof(arg));
+  if (ret < 0) {
+    // Timeouts and signals are part of normal operation
+    if (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY)
+      return 0;
+    return -errno;
+  }
+  return ret;
+}
+
+unsigned IoUring::reapCqes(io_uring_cqe *out, unsigned max) {
+  unsigned head = *cqHead_;
+  unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+  unsigned n = 0;
+  while (head != tail && n < max) {
+    out[n++] = cqes_[head & *cqMask_];
+    head++;
+  }
+  __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  return n;
+}
+
+bool IoUring::setupBufferRing(unsigned count, unsigned bufSize) {
+  bufRingSize_ = count * sizeof(io_uring_buf);
+  void *ring = mmap(nullptr, bufRingSize_, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    LOG_WARN("io_uring buffer ring mmap failed: " << strerror(errno));
+    return false;
+  }
+  bufRing_ = static_cast<io_uring_buf_ring *>(ring);
+
+  io_uring_buf_reg reg{};
+  reg.ring_addr = (uint64_t)(uintptr_t)bufRing_;
+  reg.ring_entries = count;
+  reg.bgid = kBufferGroup;
+  if (sysRegister(ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    LOG_WARN("io_uring provided buffer ring unsupported: " << strerror(errno));
+    return false;
+  }
+
+  buffersSize_ = (size_t)count * bufSize;
+  void *buffers = mmap(nullptr, buffersSize_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffers == MAP_FAILED) {
+    LOG_WARN("io_uring buffer mmap failed: " << strerror(errno));
+    return false;
+  }
+  buffers_ = static_cast<uint8_t *>(buffers);
+  bufCount_ = count;
+  bufSize_ = bufSize;
+
+  for (unsigned bid = 0; bid < count; ++bid) {
+    recycleBuffer((uint16_t)bid);
+  }
+  commitBuffers();
+  return true;
+}
+
+void IoUring::recycleBuffer(uint16_t bid) {
+  // Only addr/len/bid are written: the ring tail shares storage with the
+  // resv field of the first entry. Entries are indexed by hand because the
+  // header's flex-array-in-union trick gets a different offset under C++.
+  io_uring_buf *buf = reinterpret_cast<io_uring_buf *>(bufRing_) +
+                      (bufLocalTail_ & (bufCount_ - 1));
+  buf->addr = (uint64_t)(uintptr_t)bufferAddress(bid);
+  buf->len = bufSize_;
+  buf->bid = bid;
+  bufLocalTail_++;
+}
+
+void IoUring::commitBuffers() {
+  __atomic_store_n(&reinterpret_cast<io_uring_buf *>(bufRing_)->resv,
+                   bufLocalTail_, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+// Minimal io_uring wrapper used by RtpWorker's io_uring backend. Talks to the
+// kernel directly (no liburing dependency) and only covers what the worker
+// needs: SQE submission, CQE reaping and one provided-buffer ring.
+//
+// Multishot receive with provided-buffer rings needs Linux 6.0+ headers; on
+// anything else RTP_HAVE_IO_URING stays undefined and the worker only has the
+// epoll/poll loops.
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define RTP_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef RTP_HAVE_IO_URING
+
+#include <cstddef>
+#include <cstdint>
+
+class IoUring {
+public:
+  IoUring() = default;
+  ~IoUring();
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  bool init(unsigned entries);
+  bool isReady() const { return ringFd_ >= 0; }
+
+  // Next free SQE (zeroed), submitting pending ones first if the SQ is full.
+  // Returns nullptr only if the kernel refuses to take more.
+  io_uring_sqe *getSqe();
+
+  // Submit pending SQEs and wait for at least waitNr completions or the
+  // timeout. Returns the number submitted or -errno.
+  int submit();
+  int submitAndWait(unsigned waitNr, int timeoutMs);
+
+  // Copy up to max ready CQEs into out and consume them
+  unsigned reapCqes(io_uring_cqe *out, unsigned max);
+
+  // Provided buffer ring (group 0): count buffers of bufSize bytes each.
+  // count must be a power of two.
+  bool setupBufferRing(unsigned count, unsigned bufSize);
+  uint8_t *bufferAddress(uint16_t bid) const {
+    return buffers_ + (size_t)bid * bufSize_;
+  }
+  unsigned bufferSize() const { return bufSize_; }
+  // Hand a consumed buffer back to the kernel (published on the next
+  // commitBuffers)
+  void recycleBuffer(uint16_t bid);
+  void commitBuffers();
+
+  static constexpr uint16_t kBufferGroup = 0;
+
+private:
+  int ringFd_ = -1;
+
+  // SQ ring
+  void *sqRing_ = nullptr;
+  size_t sqRingSize_ = 0;
+  unsigned *sqHead_ = nullptr;
+  unsigned *sqTail_ = nullptr;
+  unsigned *sqMask_ = nullptr;
+  unsigned *sqArray_ = nullptr;
+  unsigned sqEntries_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+  size_t sqesSize_ = 0;
+  unsigned sqLocalTail_ = 0;
+
+  // CQ ring
+  void *cqRing_ = nullptr;
+  size_t cqRingSize_ = 0;
+  unsigned *cqHead_ = nullptr;
+  unsigned *cqTail_ = nullptr;
+  unsigned *cqMask_ = nullptr;
+  io_uring_cqe *cqes_ = nullptr;
+
+  // Provided buffers
+  io_uring_buf_ring *bufRing_ = nullptr;
+  size_t bufRingSize_ = 0;
+  uint8_t *buffers_ = nullptr;
+  size_t buffersSize_ = 0;
+  unsigned bufCount_ = 0;
+  unsigned bufSize_ = 0;
+  uint16_t bufLocalTail_ = 0;
+};
+
+#endif
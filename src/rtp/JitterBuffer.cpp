@@ -1,59 +1,184 @@
 #include "JitterBuffer.h"
+#include <algorithm>
+#include <cmath>
 
-// Super simple implementation: Just reorder/buffer slightly.
-// No fancy adaptive logic for V1.
+// The applied delay grows by at most one frame per kGrowFrames frames. It
+// shrinks more slowly, and only once it is two frames above the target (or
+// the target is back at the floor), so a noisy jitter estimate does not make
+// it oscillate.
+static const int kGrowFrames = 5;
+static const int kShrinkFrames = 50;
+// A late-packet spike wears off by 1 ms per this many frames played
+static const int kSpikeDecayFrames = 10;
 
-void JitterBuffer::push(const RtpPacket &pkt) {
-  std::lock_guard<std::mutex> lock(mutex_);
+JitterBuffer::JitterBuffer(int minDelayMs, int maxDelayMs, int clockRate,
+                           int frameMs)
+    : minDelayMs_(minDelayMs), maxDelayMs_(std::max(minDelayMs, maxDelayMs)),
+      clockRate_(clockRate), frameMs_(frameMs),
+      samplesPerFrame_((uint32_t)(clockRate * frameMs / 1000)) {
+  stats_.targetDelayMs = minDelayMs_;
+}
 
-  uint16_t seq = pkt.getSequenceNumber();
+void JitterBuffer::reset() {
+  for (auto &slot : ring_) {
+    slot.packet.reset();
+  }
+  pending_ = 0;
+}
 
-  if (buffer_.empty()) {
-    buffer_.push_back(pkt);
-    return;
+void JitterBuffer::updateJitter(uint32_t ts, uint64_t arrivalMs) {
+  // Transit time in timestamp units; only differences matter, so the
+  // 32-bit wrap of both clocks is harmless.
+  uint32_t arrival = (uint32_t)(arrivalMs * (uint64_t)clockRate_ / 1000);
+  int64_t transit = (int32_t)(arrival - ts);
+  if (haveTransit_) {
+    double d = std::fabs((double)(int32_t)(transit - lastTransit_));
+    jitter_ += (d - jitter_) / 16.0;
   }
+  lastTransit_ = transit;
+  haveTransit_ = true;
+}
 
-  // Basic ordering insertion with wrapping awareness
-  for (auto it = buffer_.begin(); it != buffer_.end(); ++it) {
-    uint16_t cur = it->getSequenceNumber();
-    if (seq == cur)
-      return; // Duplicate
+int JitterBuffer::targetDelayMs() const {
+  double jitterMs = jitter_ * 1000.0 / clockRate_;
+  int target = minDelayMs_ + (int)std::lround(3.0 * jitterMs) + spikeMs_;
+  return std::min(std::max(target, minDelayMs_), maxDelayMs_);
+}
+
+void JitterBuffer::anchor(uint32_t ts, uint64_t arrivalMs) {
+  delayMs_ = targetDelayMs();
+  stats_.targetDelayMs = stats_.delayMs = delayMs_;
+  slewWaitFrames_ = kGrowFrames;
+  anchorTs_ = ts;
+  anchorMs_ = (int64_t)arrivalMs + delayMs_;
+}
 
-    // If seq is "before" cur (taking wrapping into account)
-    // RFC 3550 style comparison: (uint16_t)(cur - seq) < 32768
-    if ((uint16_t)(cur - seq) < 32768) {
-      buffer_.insert(it, pkt);
+void JitterBuffer::advance(uint32_t ts) {
+  nextSeq_++;
+  nextTs_ = ts + samplesPerFrame_;
+  if (slewWaitFrames_ > 0)
+    slewWaitFrames_--;
+  if (spikeMs_ > 0 && ++spikeDecayFrames_ >= kSpikeDecayFrames) {
+    spikeMs_--;
+    spikeDecayFrames_ = 0;
+  }
+}
+
+int64_t JitterBuffer::deadlineMs(uint32_t ts) const {
+  return anchorMs_ + (int64_t)(int32_t)(ts - anchorTs_) * 1000 / clockRate_;
+}
+
+void JitterBuffer::push(const RtpPacketRef &pkt, uint64_t arrivalMs) {
+  uint16_t seq = pkt->getSequenceNumber();
+  uint32_t ts = pkt->getTimestamp();
+  updateJitter(ts, arrivalMs);
+
+  if (!started_) {
+    started_ = true;
+    nextSeq_ = seq;
+    nextTs_ = ts;
+    anchor(ts, arrivalMs);
+  } else {
+    int16_t ahead = (int16_t)(seq - nextSeq_);
+    if (ahead < 0) {
+      // Its slot was already played or concealed; wait longer from now on
+      stats_.late++;
+      spikeMs_ = std::min(spikeMs_ + frameMs_, maxDelayMs_);
       return;
     }
+    if (ahead >= kCapacity) {
+      // Sender restarted or a long outage: start over from this packet
+      reset();
+      nextSeq_ = seq;
+      nextTs_ = ts;
+      anchor(ts, arrivalMs);
+    } else if (pending_ == 0 && seq == nextSeq_ &&
+               (pkt->getMarker() || ts != nextTs_)) {
+      // Start of a talkspurt: re-anchor so the adapted target applies
+      nextTs_ = ts;
+      anchor(ts, arrivalMs);
+    }
   }
-  buffer_.push_back(pkt);
-}
-
-std::optional<RtpPacket> JitterBuffer::pop() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (buffer_.empty()) return std::nullopt;
-
-  // If buffer is large enough, or if the head packet is sufficiently "old" 
-  // (to avoid trapping at end of stream).
-  // For simplicity without a timer, we can just look at size or 
-  // a "force pop" flag if we had one.
-  // Better: pop if size > target, OR if we haven't seen a push in X ms.
-  // Actually, since we only call pop() after a push() or in a timer,
-  // let's just make it return the front if it's over TARGET_SIZE.
-  
-  if (buffer_.size() >= TARGET_SIZE) {
-    RtpPacket pkt = buffer_.front();
-    buffer_.pop_front();
-    return pkt;
+
+  Slot &slot = ring_[seq % kCapacity];
+  if (slot.packet) {
+    if (slot.seq == seq) {
+      stats_.duplicates++;
+      return;
+    }
+    slot.packet.reset();
+    pending_--;
+  }
+  slot.packet = pkt;
+  slot.seq = seq;
+  pending_++;
+}
+
+JitterBuffer::Frame JitterBuffer::pop(uint64_t nowMs) {
+  Frame out;
+  // Nothing buffered means silence (DTX or end of stream), not loss
+  if (!started_)
+    return out;
+  if (pending_ == 0) {
+    // If the frame was due, playout slips by one interval; book that as
+    // delay so it can be skipped back out. A new talkspurt re-anchors.
+    if ((int64_t)nowMs >= deadlineMs(nextTs_) && delayMs_ < maxDelayMs_) {
+      anchorMs_ += frameMs_;
+      delayMs_ += frameMs_;
+      stats_.delayMs = delayMs_;
+    }
+    return out;
+  }
+
+  while (true) {
+    Slot &slot = ring_[nextSeq_ % kCapacity];
+    bool present = slot.packet && slot.seq == nextSeq_;
+    uint32_t ts = present ? slot.packet->getTimestamp() : nextTs_;
+    if ((int64_t)nowMs < deadlineMs(ts))
+      return out;
+
+    int target = targetDelayMs();
+    stats_.targetDelayMs = target;
+    stats_.jitterMs = jitter_ * 1000.0 / clockRate_;
+
+    if (target > delayMs_ && slewWaitFrames_ == 0) {
+      // Grow: this frame plays one interval later, conceal in its place
+      anchorMs_ += frameMs_;
+      delayMs_ += frameMs_;
+      stats_.delayMs = delayMs_;
+      slewWaitFrames_ = kGrowFrames;
+      stats_.stretched++;
+      out.lost = true;
+      return out;
+    }
+    bool over = target <= delayMs_ - 2 * frameMs_ ||
+                (target == minDelayMs_ && delayMs_ > minDelayMs_);
+    if (over && (!present || slewWaitFrames_ == 0)) {
+      // Shrink: skip this frame and look at the next, which is now due
+      anchorMs_ -= frameMs_;
+      delayMs_ -= frameMs_;
+      stats_.delayMs = delayMs_;
+      slewWaitFrames_ = kShrinkFrames;
+      stats_.compressed++;
+      if (present) {
+        slot.packet.reset();
+        pending_--;
+      }
+      advance(ts);
+      if (pending_ == 0)
+        return out;
+      continue;
+    }
+
+    if (present) {
+      out.packet = std::move(slot.packet);
+      pending_--;
+      stats_.played++;
+    } else {
+      out.lost = true;
+      stats_.lost++;
+    }
+    advance(ts);
+    return out;
   }
-  
-  // To fix trapping: If we are calling this and the buffer isn't growing, 
-  // we need a hint. For now, let's just return if size > 0 
-  // but this would mean no jitter protection.
-  // Real fix requires a playout timer.
-  // Minimal fix: if TARGET_SIZE is reached, pop. 
-  // If we want to avoid trapping the last 5 packets, we need to know 
-  // when the stream ends.
-  
-  return std::nullopt;
 }
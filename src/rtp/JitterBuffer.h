@@ -1,21 +1,91 @@
 #pragma once
 
-#include "RtpPacket.h"
-#include <deque>
-#include <mutex>
-#include <optional>
+#include "RtpPacketPool.h"
+#include <cstdint>
 
+// Adaptive playout buffer for one inbound RTP stream.
+//
+// Packets sit in a fixed ring indexed by seq % kCapacity (O(1) insert, no
+// sorting). Each packet is due at a playout deadline derived from its RTP
+// timestamp, anchored to the arrival time of the first packet of the current
+// talkspurt plus a target delay. The target follows the RFC 3550 interarrival
+// jitter estimate, clamped to [minDelayMs, maxDelayMs]. It is applied at each
+// talkspurt start and, so that continuous streams adapt too, slewed toward
+// one frame at a time during playout: the buffer grows by concealing in
+// place of a due frame and shrinks by skipping one, preferably a missing
+// frame that would have been concealed anyway. Running dry while a frame is
+// due counts as growth. pop() is called once per frame interval by the media
+// clock and reports a gap as a loss so the caller can conceal it.
+//
+// Not thread-safe: push and pop both run on the owning RTP worker.
 class JitterBuffer {
 public:
-  void push(const RtpPacket &pkt);
-  std::optional<RtpPacket> pop();
+  static constexpr int kCapacity = 64; // 1.28 s of 20 ms frames
+
+  struct Frame {
+    RtpPacketRef packet; // set when a packet is played out
+    bool lost = false;   // the due frame is missing and should be concealed
+  };
+
+  struct Stats {
+    uint64_t played = 0;
+    uint64_t lost = 0;
+    uint64_t late = 0;
+    uint64_t duplicates = 0;
+    uint64_t stretched = 0;  // frames concealed to grow the delay
+    uint64_t compressed = 0; // frames skipped to shrink it
+    double jitterMs = 0;
+    int targetDelayMs = 0;
+    int delayMs = 0; // currently applied
+  };
+
+  explicit JitterBuffer(int minDelayMs = 20, int maxDelayMs = 200,
+                        int clockRate = 8000, int frameMs = 20);
+
+  // Holds a reference to the packet, no copy is made. arrivalMs is the
+  // media clock reading when the packet was received.
+  void push(const RtpPacketRef &pkt, uint64_t arrivalMs);
+  // Frame due at nowMs, if any
+  Frame pop(uint64_t nowMs);
+
+  const Stats &stats() const { return stats_; }
 
 private:
-  std::deque<RtpPacket> buffer_;
-  std::mutex mutex_;
-  uint16_t lastSeq_ = 0;
-  bool inited_ = false;
+  struct Slot {
+    RtpPacketRef packet;
+    uint16_t seq = 0;
+  };
+
+  int targetDelayMs() const;
+  void anchor(uint32_t ts, uint64_t arrivalMs);
+  void advance(uint32_t ts);
+  void updateJitter(uint32_t ts, uint64_t arrivalMs);
+  void reset();
+  int64_t deadlineMs(uint32_t ts) const;
+
+  Slot ring_[kCapacity];
+  size_t pending_ = 0;
+
+  int minDelayMs_;
+  int maxDelayMs_;
+  int clockRate_;
+  int frameMs_;
+  uint32_t samplesPerFrame_;
+
+  bool started_ = false;
+  uint16_t nextSeq_ = 0;     // next sequence number to play
+  uint32_t nextTs_ = 0;      // its expected timestamp
+  uint32_t anchorTs_ = 0;    // timestamp that plays at anchorMs_
+  int64_t anchorMs_ = 0;
+  int delayMs_ = 0;          // anchorMs_ minus the anchor packet's arrival
+  int slewWaitFrames_ = 0;   // frames until the delay may be moved again
+
+  // RFC 3550 A.8 interarrival jitter, in timestamp units
+  bool haveTransit_ = false;
+  int64_t lastTransit_ = 0;
+  double jitter_ = 0;
+  int spikeMs_ = 0; // extra delay after late packets, decays while playing
+  int spikeDecayFrames_ = 0;
 
-  // very consistent size
-  const size_t TARGET_SIZE = 5;
+  Stats stats_;
 };
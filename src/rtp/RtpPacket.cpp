@@ -79,6 +79,13 @@ void RtpPacket::setHeader(uint8_t pt, uint16_t seq, uint32_t ts,
     size = 12;
 }
 
+void RtpPacket::setMarker(bool marker) {
+  if (marker)
+    buffer[1] |= 0x80;
+  else
+    buffer[1] &= 0x7F;
+}
+
 void RtpPacket::setPayload(const uint8_t *data, size_t len) {
   if (len + 12 > sizeof(buffer))
     len = sizeof(buffer) - 12;
@@ -9,6 +9,7 @@ public:
   // Fixed header is 12 bytes
   uint8_t buffer[1500]; // Max MTU usually
   size_t size = 0;
+  uint64_t arrivalMs = 0; // media clock at receive time, set by RtpWorker
 
   void parse(size_t len);
 
@@ -26,5 +27,6 @@ public:
 
   // Setters for outgoing
   void setHeader(uint8_t pt, uint16_t seq, uint32_t ts, uint32_t ssrc);
+  void setMarker(bool marker);
   void setPayload(const uint8_t *data, size_t len);
 };
@@ -0,0 +1,54 @@
+#include "RtpPacketPool.h"
+
+static thread_local RtpPacketPool *tlsCurrentPool = nullptr;
+
+void RtpPacketRef::reset() {
+  if (!p_)
+    return;
+  PooledRtpPacket *p = p_;
+  p_ = nullptr;
+  if (p->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  if (p->pool) {
+    p->pool->recycle(p);
+  } else {
+    delete p;
+  }
+}
+
+RtpPacketPool *RtpPacketPool::create(size_t slabSize) {
+  return new RtpPacketPool(slabSize);
+}
+
+void RtpPacketPool::retire() { unref(); }
+
+void RtpPacketPool::unref() {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete this;
+}
+
+RtpPacketRef RtpPacketPool::acquire() {
+  PooledRtpPacket *p = slots_.acquire();
+  p->packet.size = 0;
+  p->pool = this;
+  p->refs.store(1, std::memory_order_relaxed);
+  refs_.fetch_add(1, std::memory_order_relaxed);
+  return RtpPacketRef(p);
+}
+
+void RtpPacketPool::recycle(PooledRtpPacket *p) {
+  slots_.release(p);
+  unref();
+}
+
+RtpPacketPool *RtpPacketPool::current() { return tlsCurrentPool; }
+
+void RtpPacketPool::setCurrent(RtpPacketPool *pool) { tlsCurrentPool = pool; }
+
+RtpPacketRef RtpPacketPool::allocate() {
+  if (tlsCurrentPool)
+    return tlsCurrentPool->acquire();
+  auto *p = new PooledRtpPacket();
+  p->refs.store(1, std::memory_order_relaxed);
+  return RtpPacketRef(p);
+}
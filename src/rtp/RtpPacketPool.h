@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../util/ObjectPool.h"
+#include "RtpPacket.h"
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+class RtpPacketPool;
+
+// Storage behind an RtpPacketRef: the packet, its reference count and the
+// pool it goes back to (nullptr for packets allocated off a worker thread).
+struct PooledRtpPacket {
+  RtpPacket packet;
+  std::atomic<uint32_t> refs{0};
+  RtpPacketPool *pool = nullptr;
+};
+
+// Reference-counted handle to a pooled RtpPacket. Copying a handle shares the
+// packet instead of copying its 1500-byte buffer, so the receive path, jitter
+// buffer and send queue can all pass packets around by handle. The packet
+// returns to its pool when the last handle goes away, from whichever thread
+// that happens on.
+class RtpPacketRef {
+public:
+  RtpPacketRef() = default;
+  RtpPacketRef(const RtpPacketRef &other) : p_(other.p_) {
+    if (p_)
+      p_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  RtpPacketRef(RtpPacketRef &&other) noexcept : p_(other.p_) {
+    other.p_ = nullptr;
+  }
+  RtpPacketRef &operator=(RtpPacketRef other) noexcept {
+    std::swap(p_, other.p_);
+    return *this;
+  }
+  ~RtpPacketRef() { reset(); }
+
+  void reset();
+
+  RtpPacket *get() const { return p_ ? &p_->packet : nullptr; }
+  RtpPacket *operator->() const { return &p_->packet; }
+  RtpPacket &operator*() const { return p_->packet; }
+  explicit operator bool() const { return p_ != nullptr; }
+
+  // True when no other handle shares the packet, i.e. it may be reused
+  bool unique() const {
+    return p_ && p_->refs.load(std::memory_order_acquire) == 1;
+  }
+
+private:
+  friend class RtpPacketPool;
+  explicit RtpPacketRef(PooledRtpPacket *p) : p_(p) {}
+
+  PooledRtpPacket *p_ = nullptr;
+};
+
+// Per-worker slab of RTP packets. Only the owning thread acquires, any thread
+// may drop the last reference. The pool is heap-allocated and reference
+// counted by its outstanding packets, so a worker can retire it while calls
+// still hold packets; the memory goes away with the last one.
+class RtpPacketPool {
+public:
+  static RtpPacketPool *create(size_t slabSize);
+  // Replaces delete for the owner
+  void retire();
+
+  // Owner thread only
+  RtpPacketRef acquire();
+
+  // Pool of the worker running on this thread, if any
+  static RtpPacketPool *current();
+  static void setCurrent(RtpPacketPool *pool);
+
+  // Packet from the current thread's pool, or a standalone heap packet when
+  // called off a worker thread
+  static RtpPacketRef allocate();
+
+private:
+  friend class RtpPacketRef;
+
+  explicit RtpPacketPool(size_t slabSize) : slots_(slabSize) {}
+  void recycle(PooledRtpPacket *p);
+  void unref();
+
+  ObjectPool<PooledRtpPacket> slots_;
+  std::atomic<size_t> refs_{1}; // owner + outstanding packets
+};
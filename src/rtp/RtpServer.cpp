@@ -7,7 +7,8 @@ RtpServer &RtpServer::instance() {
   return instance;
 }
 
-void RtpServer::init(int startPort, int endPort, int threadCount) {
+void RtpServer::init(int startPort, int endPort,
+                     const RtpWorkerOptions &options, int threadCount) {
   startPort_ = startPort;
   endPort_ = endPort;
 
@@ -25,7 +26,8 @@ void RtpServer::init(int startPort, int endPort, int threadCount) {
   int portRange = endPort - startPort + 1;
   int portsPerWorker = portRange / threadCount;
   
-  LOG_INFO("Initializing RtpServer with " << threadCount << " workers. Ports per worker: " << portsPerWorker);
+  LOG_INFO("Initializing RtpServer with " << threadCount << " workers. Ports per worker: " << portsPerWorker
+           << " Batch I/O: " << (options.batchIo ? options.batchSize : 0));
 
   for (int i = 0; i < threadCount; ++i) {
     int wStart = startPort + (i * portsPerWorker);
@@ -38,18 +40,31 @@ void RtpServer::init(int startPort, int endPort, int threadCount) {
         wEnd = endPort;
     }
     
-    auto worker = std::make_unique<RtpWorker>(i, wStart, wEnd);
+    auto worker = std::make_unique<RtpWorker>(i, wStart, wEnd, options);
     worker->start();
     workers_.push_back(std::move(worker));
   }
+
+  portOwners_.assign(endPort - startPort + 1, nullptr);
+  for (auto &w : workers_) {
+    for (int p = w->getStartPort(); p <= w->getEndPort(); ++p) {
+      portOwners_[p - startPort_] = w.get();
+    }
+  }
 }
 
-int RtpServer::allocatePort() {
+RtpWorker *RtpServer::workerForPort(int port) const {
+  if (port < startPort_ || port > endPort_ || portOwners_.empty())
+    return nullptr;
+  return portOwners_[port - startPort_];
+}
+
+int RtpServer::allocatePort(std::shared_ptr<RtpSink> sink) {
   std::lock_guard<std::mutex> lock(mutex_);
   // Round robin try
   int startWorker = nextWorker_;
   do {
-    int port = workers_[nextWorker_]->allocatePort();
+    int port = workers_[nextWorker_]->allocatePort(sink);
     nextWorker_ = (nextWorker_ + 1) % workers_.size();
     if (port > 0) {
       return port;
@@ -61,28 +76,26 @@ int RtpServer::allocatePort() {
 }
 
 void RtpServer::releasePort(int port) {
-  // Find worker
-  for (auto &w : workers_) {
-    if (port >= w->getStartPort() && port <= w->getEndPort()) {
-      w->releasePort(port);
-      return;
-    }
+  if (RtpWorker *w = workerForPort(port)) {
+    w->releasePort(port);
   }
 }
 
-void RtpServer::setPacketHandler(PacketHandler handler) {
-  // Propagate to all existing workers (init should be called first usually)
+void RtpServer::send(int localPort, RtpPacketRef pkt,
+                     const sockaddr_in &dest) {
+  if (RtpWorker *w = workerForPort(localPort)) {
+    w->send(localPort, std::move(pkt), dest);
+  }
+}
+
+void RtpServer::advanceVirtualClock(int ms) {
   for (auto &w : workers_) {
-    w->setPacketHandler(handler);
+    w->advanceVirtualClock(ms);
   }
 }
 
-void RtpServer::send(int localPort, const RtpPacket &pkt,
-                     const sockaddr_in &dest) {
-   for (auto &w : workers_) {
-    if (localPort >= w->getStartPort() && localPort <= w->getEndPort()) {
-      w->send(localPort, pkt, dest);
-      return;
-    }
+void RtpServer::logStats() const {
+  for (auto &w : workers_) {
+    w->logStats();
   }
 }
@@ -4,33 +4,39 @@
 #include <netinet/in.h>
 #include <vector>
 
-#include "RtpPacket.h"
+#include "RtpPacketPool.h"
 #include "RtpWorker.h"
 
 class RtpServer {
 public:
-  using PacketHandler = std::function<void(int localPort, const RtpPacket &,
-                                           const sockaddr_in &)>;
-
   static RtpServer &instance();
 
-  // Initialize with port range and optional thread count
-  void init(int startPort, int endPort, int threadCount = 0);
+  // Initialize with port range, worker I/O options and optional thread count
+  void init(int startPort, int endPort,
+            const RtpWorkerOptions &options = RtpWorkerOptions(),
+            int threadCount = 0);
 
-  // Allocate a port for a new call (Round-robin across workers)
-  int allocatePort();
+  // Allocate a port for a new call (Round-robin across workers). Packets
+  // arriving on it are dispatched to sink until the port is released.
+  int allocatePort(std::shared_ptr<RtpSink> sink);
   void releasePort(int port);
 
-  // Set callback (propagated to all workers)
-  void setPacketHandler(PacketHandler handler);
+  // Send (posted to the worker owning localPort, callable from any thread)
+  void send(int localPort, RtpPacketRef packet, const sockaddr_in &dest);
+
+  // Step every worker's media clock (virtual clock mode only)
+  void advanceVirtualClock(int ms);
 
-  // Send (Delegates to appropriate worker)
-  void send(int localPort, const RtpPacket &packet, const sockaddr_in &dest);
+  // Dump per-worker batch counters to the log
+  void logStats() const;
 
 private:
   RtpServer() = default;
 
+  RtpWorker *workerForPort(int port) const;
+
   std::vector<std::unique_ptr<RtpWorker>> workers_;
+  std::vector<RtpWorker *> portOwners_; // indexed by (port - startPort_)
   int nextWorker_ = 0; // Round-robin index
   int startPort_ = 0;
   int endPort_ = 0;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "RtpPacketPool.h"
+#include <netinet/in.h>
+
+// Receiver of the RTP traffic arriving on one allocated port. Sinks are
+// registered in the owning worker's dispatch table and called directly from
+// its loop, so implementations must not block. Sinks may keep the packet
+// handle (e.g. in a jitter buffer) instead of copying the packet.
+class RtpSink {
+public:
+  virtual ~RtpSink() = default;
+
+  virtual void onRtpPacket(const RtpPacketRef &pkt,
+                           const sockaddr_in &sender) = 0;
+
+  // Interval at which the worker's media clock calls onMediaTick, read once
+  // when the port is allocated. 0 disables ticks.
+  virtual int mediaTickIntervalMs() const { return 0; }
+  // Driven by the media clock, independent of packet arrival. This is where
+  // frames are played out. nowMs is on the same clock as
+  // RtpPacket::arrivalMs.
+  virtual void onMediaTick(uint64_t nowMs) {}
+};
@@ -1,33 +1,196 @@
 #include "RtpWorker.h"
 #include "../app/Logger.h"
 #include "../util/Net.h"
+#include <algorithm>
+#include <cstring>
 #include <poll.h>
+#include <sstream>
 #include <unistd.h>
 #ifdef __linux__
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #endif
 
-RtpWorker::RtpWorker(int workerId, int startPort, int endPort)
-    : workerId_(workerId), startPort_(startPort), endPort_(endPort) {
+// Worker whose loop is running on the current thread, used to decide whether
+// a send can join the current batch or has to go straight to the socket.
+static thread_local RtpWorker *tlsCurrentWorker = nullptr;
+
+// Packets per slab in the worker's packet pool
+static const size_t kPacketSlab = 256;
+
+#ifdef __linux__
+// epoll tags of the command queue eventfd and the media clock timerfd
+// (sockets carry port << 32 | fd)
+static const uint64_t kWakeEvent = ~0ULL;
+static const uint64_t kTimerEvent = ~0ULL - 1;
+#endif
+
+#ifdef RTP_HAVE_IO_URING
+// io_uring user_data: op (8 bits) | port (16 bits, at 32) | fd or tx slot
+enum : uint64_t {
+  kUringRecv = 1,
+  kUringSend = 2,
+  kUringCancel = 3,
+  kUringWake = 4,
+  kUringTimer = 5
+};
+static const unsigned kUringEntries = 256;
+static const unsigned kUringBuffers = 512;
+static const unsigned kUringBufferSize = 2048;
+
+static uint64_t uringUserData(uint64_t op, int port, uint32_t value) {
+  return op << 56 | (uint64_t)(port & 0xFFFF) << 32 | value;
+}
+static uint64_t uringOp(uint64_t userData) { return userData >> 56; }
+static int uringPort(uint64_t userData) { return (int)((userData >> 32) & 0xFFFF); }
+static uint32_t uringValue(uint64_t userData) { return (uint32_t)userData; }
+#endif
+
+void RtpWorker::BatchStats::record(size_t n) {
+  calls.fetch_add(1, std::memory_order_relaxed);
+  packets.fetch_add(n, std::memory_order_relaxed);
+  int bucket = 0;
+  while (bucket < kBatchBuckets - 1 && n >= (size_t(2) << bucket))
+    bucket++;
+  histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+RtpWorker::RtpWorker(int workerId, int startPort, int endPort,
+                     const RtpWorkerOptions &options)
+    : workerId_(workerId), startPort_(startPort), endPort_(endPort),
+      options_(options),
+      commands_(options.commandQueueSize > 0 ? options.commandQueueSize : 1) {
+  if (options_.batchSize < 1)
+    options_.batchSize = 1;
+  if (options_.mediaTickMs < 1)
+    options_.mediaTickMs = 1;
+
+  int slots = endPort_ - startPort_ + 1;
+  sinks_.reset(new std::atomic<RtpSink *>[slots]);
+  for (int i = 0; i < slots; ++i) {
+    sinks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+  owners_.resize(slots);
+  fds_.assign(slots, -1);
+  ticks_.resize(slots);
+  clockStart_ = std::chrono::steady_clock::now();
+  packetPool_ = RtpPacketPool::create(kPacketSlab);
 #ifdef __linux__
   epollFd_ = epoll_create1(0);
   if (epollFd_ < 0) {
       LOG_ERROR("Failed to create epoll instance for worker " << workerId_);
   }
+  wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeFd_ < 0) {
+      LOG_ERROR("Failed to create eventfd for worker " << workerId_);
+  }
+  if (!options_.virtualClock) {
+    timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd_ < 0) {
+        LOG_ERROR("Failed to create timerfd for worker " << workerId_);
+    }
+  }
+
+  if (options_.ioBackend == RtpIoBackend::IO_URING) {
+#ifdef RTP_HAVE_IO_URING
+    useUring_ = initUring();
+#else
+    LOG_WARN("io_uring backend not available in this build, worker " << workerId_ << " uses epoll");
+#endif
+  }
+
+  if (!useUring_ && wakeFd_ >= 0) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeEvent;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+  }
+  if (!useUring_ && timerFd_ >= 0) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = kTimerEvent;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, timerFd_, &ev);
+  }
+
+  if (options_.batchIo || useUring_) {
+    size_t batch = options_.batchSize;
+    rxPackets_.resize(batch);
+    rxAddrs_.resize(batch);
+    rxIov_.resize(batch);
+    rxMsgs_.resize(batch);
+    for (size_t i = 0; i < batch; ++i) {
+      rxPackets_[i] = packetPool_->acquire();
+      rxIov_[i].iov_base = rxPackets_[i]->buffer;
+      rxIov_[i].iov_len = sizeof(rxPackets_[i]->buffer);
+      rxMsgs_[i] = {};
+      rxMsgs_[i].msg_hdr.msg_iov = &rxIov_[i];
+      rxMsgs_[i].msg_hdr.msg_iovlen = 1;
+      rxMsgs_[i].msg_hdr.msg_name = &rxAddrs_[i];
+    }
+
+    // io_uring gets two banks of tx slots: one fills while the kernel
+    // still holds the other
+    size_t txSlots = useUring_ ? 2 * batch : batch;
+    txPackets_.resize(txSlots);
+    txAddrs_.resize(txSlots);
+    txFds_.resize(txSlots);
+    txIov_.resize(txSlots);
+    txMsgs_.resize(txSlots);
+    for (size_t i = 0; i < txSlots; ++i) {
+      txMsgs_[i] = {};
+      txMsgs_[i].msg_hdr.msg_iov = &txIov_[i];
+      txMsgs_[i].msg_hdr.msg_iovlen = 1;
+      txMsgs_[i].msg_hdr.msg_name = &txAddrs_[i];
+      txMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+  }
 #endif
 }
 
 RtpWorker::~RtpWorker() { 
   stop(); 
+  for (auto &[port, fd] : pool_) {
+    Net::closeSocket(fd);
+  }
+  for (int fd : fds_) {
+    if (fd >= 0)
+      Net::closeSocket(fd);
+  }
 #ifdef __linux__
   if (epollFd_ >= 0) {
       close(epollFd_);
   }
+  if (wakeFd_ >= 0) {
+      close(wakeFd_);
+  }
+  if (timerFd_ >= 0) {
+      close(timerFd_);
+  }
+  rxPackets_.clear();
+  txPackets_.clear();
+#endif
+#ifdef RTP_HAVE_IO_URING
+  uringPacket_.reset();
 #endif
+  // Sessions may still hold packets, the pool lives on until they are back
+  packetPool_->retire();
 }
 
 void RtpWorker::start() {
+  for (int p = startPort_; p <= endPort_; p += 2) {
+    freePorts_.push_back(p);
+  }
+  // Pre-bind the initial pool before taking calls, the loop keeps it topped up
+  while (true) {
+    size_t before = pool_.size();
+    refillSocketPool();
+    if (pool_.size() == before)
+      break;
+  }
+
   running_ = true;
+  started_ = true;
   thread_ = std::thread(&RtpWorker::loop, this);
   LOG_INFO("RtpWorker " << workerId_ << " started [Ports " << startPort_ << "-" << endPort_ << "]");
 }
@@ -36,168 +199,893 @@ void RtpWorker::stop() {
   running_ = false;
   if (thread_.joinable()) {
     thread_.join();
+    // From here on commands run inline on the caller's thread
+    started_ = false;
+    // Nobody else consumes the queue now, finish what was posted
+    drainCommands();
   }
 }
 
-int RtpWorker::allocatePort() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  // Simple linear search for now.
-  // In a real high-perf scenario, we'd keep a free list or bitmap.
-  for (int p = startPort_; p <= endPort_; p += 2) {
-    if (activeSockets_.find(p) == activeSockets_.end()) {
-      int fd = Net::createUdpSocket();
-      if (fd >= 0) {
-        if (Net::bindSocket(fd, "0.0.0.0", p)) {
-          Net::setNonBlocking(fd);
-          activeSockets_[p] = fd;
+bool RtpWorker::onLoopThread() const { return tlsCurrentWorker == this; }
 
+bool RtpWorker::post(Command &&cmd) {
+  if (!commands_.push(std::move(cmd)))
+    return false;
+  // One wakeup per drain is enough
+  if (!wakePending_.exchange(true)) {
 #ifdef __linux__
-          struct epoll_event ev;
-          ev.events = EPOLLIN;
-          ev.data.fd = fd;
-          // Store port in data.u64 or use map lookup later? 
-          // data union only allows one. Let's store fd and lookup port in map (O(logN) is fast enough)
-          // Or better: Pack port into u64? Port (16 bit) fits easily.
-          ev.data.u64 = (uint64_t)p << 32 | fd; 
-          
-          if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
-              LOG_ERROR("epoll_ctl add failed for port " << p);
-              Net::closeSocket(fd);
-              continue;
-          }
+    uint64_t one = 1;
+    ssize_t r = write(wakeFd_, &one, sizeof(one));
+    (void)r;
 #endif
+  }
+  return true;
+}
 
-          LOG_DEBUG("Worker " << workerId_ << " allocated port " << p << " with FD " << fd);
-          LOG_INFO("Socket created: FD=" << fd << " Port=" << p);
-          return p;
-        } else {
-          LOG_ERROR("Failed to bind socket to port " << p);
-          Net::closeSocket(fd);
-        }
-      } else {
-        LOG_ERROR("Failed to create UDP socket for port " << p);
+void RtpWorker::drainCommands() {
+  wakePending_.store(false);
+  Command cmd;
+  while (commands_.pop(cmd)) {
+    runCommand(cmd);
+  }
+}
+
+void RtpWorker::runCommand(Command &cmd) {
+  switch (cmd.type) {
+  case Command::Type::SEND:
+    doSend(cmd.port, std::move(cmd.packet), cmd.dest);
+    break;
+  case Command::Type::ALLOCATE: {
+    AllocateReply &reply = *cmd.reply;
+    if (reply.state.load() == AllocateReply::ABANDONED)
+      break;
+    int port = doAllocate(std::move(cmd.sink));
+    int pending = AllocateReply::PENDING;
+    if (reply.state.compare_exchange_strong(pending, AllocateReply::ANSWERED)) {
+      reply.port.set_value(port);
+    } else if (port >= 0) {
+      // The caller timed out meanwhile: nobody owns the port or the sink
+      LOG_WARN("Worker " << workerId_ << " releasing port " << port
+                         << " allocated after the caller gave up");
+      doRelease(port);
+    }
+    break;
+  }
+  case Command::Type::RELEASE:
+    doRelease(cmd.port);
+    break;
+  case Command::Type::ADVANCE_CLOCK:
+    // Sub-tick steps add up instead of being dropped
+    virtualMs_ += cmd.ms;
+    wheel_.advanceTo(virtualMs_ / options_.mediaTickMs);
+    break;
+  }
+}
+
+void RtpWorker::advanceVirtualClock(int ms) {
+  if (!options_.virtualClock) {
+    LOG_WARN("RtpWorker " << workerId_ << " runs on the real clock, ignoring clock step");
+    return;
+  }
+  Command cmd;
+  cmd.type = Command::Type::ADVANCE_CLOCK;
+  cmd.ms = ms > 0 ? (uint64_t)ms : 0;
+  if (!started_ || onLoopThread()) {
+    runCommand(cmd);
+    return;
+  }
+  while (!post(std::move(cmd))) {
+    std::this_thread::yield();
+  }
+}
+
+uint64_t RtpWorker::currentTick() const {
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - clockStart_);
+  return (uint64_t)elapsed.count() / options_.mediaTickMs;
+}
+
+uint64_t RtpWorker::mediaNowMs() const {
+  if (options_.virtualClock)
+    return wheel_.now() * options_.mediaTickMs;
+  return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - clockStart_)
+      .count();
+}
+
+void RtpWorker::syncClock() {
+  if (!options_.virtualClock)
+    wheel_.advanceTo(currentTick());
+}
+
+void RtpWorker::setTimerArmed(bool armed) {
+#ifdef __linux__
+  if (timerFd_ < 0)
+    return;
+  struct itimerspec spec {};
+  if (armed) {
+    spec.it_interval.tv_sec = options_.mediaTickMs / 1000;
+    spec.it_interval.tv_nsec = (long)(options_.mediaTickMs % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+  }
+  timerfd_settime(timerFd_, 0, &spec, nullptr);
+#else
+  (void)armed;
+#endif
+}
+
+void RtpWorker::startMediaTick(int idx, RtpSink *sink) {
+  int ms = sink->mediaTickIntervalMs();
+  if (ms <= 0)
+    return;
+  // The wheel may be behind if no sink was ticking
+  syncClock();
+
+  MediaTick &t = ticks_[idx];
+  t.sink = sink;
+  t.interval = std::max<uint64_t>(
+      1, (ms + options_.mediaTickMs / 2) / options_.mediaTickMs);
+  t.next = wheel_.now() + t.interval;
+  t.timer = wheel_.scheduleAt(t.next, [this, idx] { onMediaTimer(idx); });
+  // The timerfd only runs while something is ticking
+  if (activeTicks_++ == 0)
+    setTimerArmed(true);
+}
+
+void RtpWorker::stopMediaTick(int idx) {
+  MediaTick &t = ticks_[idx];
+  if (!t.sink)
+    return;
+  wheel_.cancel(t.timer);
+  t = MediaTick();
+  if (--activeTicks_ == 0)
+    setTimerArmed(false);
+}
+
+void RtpWorker::onMediaTimer(int idx) {
+  MediaTick &t = ticks_[idx];
+  t.timer = 0;
+  // releasePort clears the slot before the RELEASE command gets here
+  if (sinks_[idx].load(std::memory_order_acquire) != t.sink)
+    return;
+  // Fixed cadence from the first tick, so there is no drift
+  t.next += t.interval;
+  t.timer = wheel_.scheduleAt(t.next, [this, idx] { onMediaTimer(idx); });
+  t.sink->onMediaTick(mediaNowMs());
+}
+
+int RtpWorker::openSocket(int port) {
+  int fd = Net::createUdpSocket();
+  if (fd < 0) {
+    LOG_ERROR("Failed to create UDP socket for port " << port);
+    return -1;
+  }
+  if (!Net::bindSocket(fd, "0.0.0.0", port)) {
+    Net::closeSocket(fd);
+    return -1;
+  }
+  Net::setNonBlocking(fd);
+
+#ifdef RTP_HAVE_IO_URING
+  if (useUring_) {
+    armRecv(port, fd);
+    return fd;
+  }
+#endif
+
+#ifdef __linux__
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  // Pack port and fd into the event so the loop needs no lookup
+  ev.data.u64 = (uint64_t)port << 32 | fd;
+  if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    LOG_ERROR("epoll_ctl add failed for port " << port);
+    Net::closeSocket(fd);
+    return -1;
+  }
+#endif
+  return fd;
+}
+
+void RtpWorker::closeSocket(int port, int fd) {
+#ifdef RTP_HAVE_IO_URING
+  if (useUring_) {
+    int &armed = armedFd_[port - startPort_];
+    if (armed == fd) {
+      if (io_uring_sqe *sqe = ring_->getSqe()) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = uringUserData(kUringRecv, port, fd);
+        sqe->user_data = uringUserData(kUringCancel, port, fd);
       }
+      armed = -1;
     }
+    // The ring keeps its own file reference until the cancel completes
+    Net::closeSocket(fd);
+    return;
+  }
+#endif
+#ifdef __linux__
+  epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+  Net::closeSocket(fd);
+}
+
+void RtpWorker::releaseQuarantinedPorts(
+    std::chrono::steady_clock::time_point now) {
+  while (!quarantine_.empty() && quarantine_.front().second <= now) {
+    freePorts_.push_back(quarantine_.front().first);
+    quarantine_.pop_front();
   }
-  LOG_ERROR("Worker " << workerId_ << " failed to allocate any port in range " << startPort_ << "-" << endPort_);
-  return -1;
+}
+
+void RtpWorker::refillSocketPool() {
+  // A bounded chunk per pass keeps the loop responsive
+  const size_t kRefillChunk = 8;
+  auto now = std::chrono::steady_clock::now();
+  releaseQuarantinedPorts(now);
+  size_t target = options_.socketPoolSize;
+  for (size_t n = 0; n < kRefillChunk && pool_.size() < target &&
+                     !freePorts_.empty();
+       ++n) {
+    int port = freePorts_.front();
+    freePorts_.pop_front();
+    int fd = openSocket(port);
+    if (fd >= 0) {
+      pool_.push_back({port, fd});
+    } else {
+      // Port is taken by someone else, retry it after the quarantine window
+      quarantine_.push_back(
+          {port, now + std::chrono::milliseconds(options_.portQuarantineMs)});
+    }
+  }
+}
+
+int RtpWorker::allocatePort(std::shared_ptr<RtpSink> sink) {
+  if (!started_ || onLoopThread())
+    return doAllocate(std::move(sink));
+
+  Command cmd;
+  cmd.type = Command::Type::ALLOCATE;
+  cmd.sink = std::move(sink);
+  auto reply = std::make_shared<AllocateReply>();
+  cmd.reply = reply;
+  auto result = reply->port.get_future();
+  if (!post(std::move(cmd))) {
+    LOG_ERROR("Worker " << workerId_ << " command queue full, cannot allocate port");
+    return -1;
+  }
+  // The loop answers within one pass; only a stopped or stalled worker
+  // does not. If it answers after all, it releases the port itself.
+  if (result.wait_for(std::chrono::seconds(1)) != std::future_status::ready) {
+    int pending = AllocateReply::PENDING;
+    if (reply->state.compare_exchange_strong(pending,
+                                             AllocateReply::ABANDONED)) {
+      LOG_ERROR("Worker " << workerId_ << " did not answer port allocation");
+      return -1;
+    }
+    // Answered just now
+  }
+  return result.get();
+}
+
+int RtpWorker::doAllocate(std::shared_ptr<RtpSink> sink) {
+  int port;
+  int fd;
+  if (!pool_.empty()) {
+    std::tie(port, fd) = pool_.back();
+    pool_.pop_back();
+  } else {
+    auto now = std::chrono::steady_clock::now();
+    releaseQuarantinedPorts(now);
+    if (freePorts_.empty()) {
+      LOG_ERROR("Worker " << workerId_ << " has no free port in range " << startPort_ << "-" << endPort_);
+      return -1;
+    }
+    port = freePorts_.front();
+    freePorts_.pop_front();
+
+    // Pool exhausted: bind right away
+    fd = openSocket(port);
+    if (fd < 0) {
+      quarantine_.push_back(
+          {port, now + std::chrono::milliseconds(options_.portQuarantineMs)});
+      return -1;
+    }
+  }
+
+  int idx = port - startPort_;
+  fds_[idx] = fd;
+  sinks_[idx].store(sink.get(), std::memory_order_release);
+  owners_[idx] = std::move(sink);
+  startMediaTick(idx, owners_[idx].get());
+  LOG_DEBUG("Worker " << workerId_ << " allocated port " << port << " with FD " << fd);
+  return port;
 }
 
 void RtpWorker::releasePort(int port) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto it = activeSockets_.find(port);
-  if (it != activeSockets_.end()) {
-    int fd = it->second;
-    
+  if (port < startPort_ || port > endPort_)
+    return;
+  // Stop dispatching right away, the socket goes with the command
+  sinks_[port - startPort_].store(nullptr, std::memory_order_release);
+
+  if (!started_ || onLoopThread()) {
+    doRelease(port);
+    return;
+  }
+  Command cmd;
+  cmd.type = Command::Type::RELEASE;
+  cmd.port = port;
+  // A lost release would leak the port, so wait for room
+  while (!post(std::move(cmd))) {
+    std::this_thread::yield();
+  }
+}
+
+void RtpWorker::doRelease(int port) {
+  int idx = port - startPort_;
+  int fd = fds_[idx];
+  if (fd < 0)
+    return;
+  sinks_[idx].store(nullptr, std::memory_order_release);
+  stopMediaTick(idx);
+
 #ifdef __linux__
-    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+  // Queued frames may still reference this socket
+  flushSends();
 #endif
+  closeSocket(port, fd);
+  fds_[idx] = -1;
 
-    Net::closeSocket(fd);
-    activeSockets_.erase(it);
+  // Keep the port out of circulation while stray packets from the old call
+  // may still be in flight.
+  quarantine_.push_back(
+      {port, std::chrono::steady_clock::now() +
+                 std::chrono::milliseconds(options_.portQuarantineMs)});
+
+  // Last reference to the sink is dropped here, on the loop thread
+  owners_[idx].reset();
+}
+
+void RtpWorker::dispatch(int port, const RtpPacketRef &pkt,
+                         const sockaddr_in &sender) {
+  RtpSink *sink = sinks_[port - startPort_].load(std::memory_order_acquire);
+  if (sink) {
+    sink->onRtpPacket(pkt, sender);
+  }
+}
+
+void RtpWorker::send(int localPort, RtpPacketRef packet, const sockaddr_in &dest) {
+  if (localPort < startPort_ || localPort > endPort_ || !packet)
+    return;
+  if (onLoopThread()) {
+    doSend(localPort, std::move(packet), dest);
+    return;
+  }
+
+  Command cmd;
+  cmd.type = Command::Type::SEND;
+  cmd.port = localPort;
+  cmd.packet = std::move(packet);
+  cmd.dest = dest;
+  if (!post(std::move(cmd))) {
+    droppedSends_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void RtpWorker::doSend(int port, RtpPacketRef packet, const sockaddr_in &dest) {
+  int fd = fds_[port - startPort_];
+  if (fd < 0)
+    return;
+
+#ifdef __linux__
+  // On the loop thread, frames (posted ones as well as downlink generated
+  // while handling an uplink packet) are queued and flushed together at the
+  // end of the pass.
+  if ((options_.batchIo || useUring_) && onLoopThread()) {
+    queueSend(fd, std::move(packet), dest);
+    return;
   }
+#endif
+
+  sendto(fd, packet->buffer, packet->size, 0, (struct sockaddr *)&dest, sizeof(dest));
+  txStats_.record(1);
 }
 
-void RtpWorker::setPacketHandler(PacketHandler handler) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  handler_ = handler;
+void RtpWorker::logStats() const {
+  auto line = [](const char *name, const BatchStats &s) {
+    uint64_t calls = s.calls.load(std::memory_order_relaxed);
+    uint64_t packets = s.packets.load(std::memory_order_relaxed);
+    std::ostringstream hist;
+    for (int i = 0; i < kBatchBuckets; ++i) {
+      hist << (i ? " " : "") << s.histogram[i].load(std::memory_order_relaxed);
+    }
+    std::ostringstream out;
+    out << name << " syscalls=" << calls << " packets=" << packets
+        << " avg=" << (calls ? (double)packets / calls : 0.0)
+        << " hist[1,2,4,8,16,32+]=" << hist.str();
+    return out.str();
+  };
+  LOG_INFO("RtpWorker " << workerId_ << " " << line("rx", rxStats_));
+  LOG_INFO("RtpWorker " << workerId_ << " " << line("tx", txStats_));
+  uint64_t dropped = droppedSends_.load(std::memory_order_relaxed);
+  if (dropped > 0) {
+    LOG_INFO("RtpWorker " << workerId_ << " dropped " << dropped << " frames on a full command queue");
+  }
 }
 
-void RtpWorker::send(int localPort, const RtpPacket &packet, const sockaddr_in &dest) {
-  int fd = -1;
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = activeSockets_.find(localPort);
-    if (it != activeSockets_.end()) {
-      fd = it->second;
+#ifdef __linux__
+void RtpWorker::receiveBatch(int fd, int port) {
+  const int batch = options_.batchSize;
+  while (true) {
+    for (int i = 0; i < batch; ++i) {
+      rxMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
     }
+
+    int n = recvmmsg(fd, rxMsgs_.data(), batch, MSG_DONTWAIT, nullptr);
+    if (n <= 0)
+      return;
+    rxStats_.record(n);
+    uint64_t now = mediaNowMs();
+
+    for (int i = 0; i < n; ++i) {
+      RtpPacketRef &pkt = rxPackets_[i];
+      pkt->parse(rxMsgs_[i].msg_len);
+      pkt->arrivalMs = now;
+      dispatch(port, pkt, rxAddrs_[i]);
+      if (!pkt.unique()) {
+        // The sink kept this buffer, receive the next batch into a new one
+        pkt = packetPool_->acquire();
+        rxIov_[i].iov_base = pkt->buffer;
+      }
+    }
+
+    // A short batch means the socket is drained
+    if (n < batch)
+      return;
   }
+}
 
-  if (fd != -1) {
-    sendto(fd, packet.buffer, packet.size, 0, (struct sockaddr *)&dest, sizeof(dest));
+void RtpWorker::queueSend(int fd, RtpPacketRef packet,
+                          const sockaddr_in &dest) {
+  if (txCount_ == (size_t)options_.batchSize) {
+    flushSends();
   }
+  size_t i = txCount_++;
+#ifdef RTP_HAVE_IO_URING
+  // Slots handed to the kernel stay untouchable until their sends complete.
+  // The bank about to be filled was submitted two flushes ago, so this
+  // normally finds it done; only block if the kernel is that far behind.
+  if (useUring_) {
+    if (i == 0 && txInflight_[txBank_] > 0) {
+      reapSends();
+      if (txInflight_[txBank_] > 0)
+        waitForSends(txBank_);
+    }
+    i += txBank_ * options_.batchSize;
+  }
+#endif
+  txIov_[i].iov_base = packet->buffer;
+  txIov_[i].iov_len = packet->size;
+  txPackets_[i] = std::move(packet);
+  txAddrs_[i] = dest;
+  txFds_[i] = fd;
 }
 
+void RtpWorker::flushSends() {
+#ifdef RTP_HAVE_IO_URING
+  if (useUring_) {
+    submitSends();
+    return;
+  }
+#endif
+  // sendmmsg works on a single socket, so send each run of frames that
+  // share a local port as one batch.
+  size_t start = 0;
+  while (start < txCount_) {
+    size_t end = start + 1;
+    while (end < txCount_ && txFds_[end] == txFds_[start])
+      end++;
+
+    size_t pos = start;
+    while (pos < end) {
+      int n = sendmmsg(txFds_[start], &txMsgs_[pos], end - pos, 0);
+      if (n <= 0) {
+        LOG_DEBUG("sendmmsg failed on worker " << workerId_ << ": "
+                  << strerror(errno));
+        break;
+      }
+      txStats_.record(n);
+      pos += n;
+    }
+    start = end;
+  }
+  for (size_t i = 0; i < txCount_; ++i) {
+    txPackets_[i].reset();
+  }
+  txCount_ = 0;
+}
+#endif
+
 void RtpWorker::loop() {
+  tlsCurrentWorker = this;
+  RtpPacketPool::setCurrent(packetPool_);
+#ifdef RTP_HAVE_IO_URING
+  if (useUring_) {
+    loopUring();
+  } else {
+    loopEpoll();
+  }
+#elif defined(__linux__)
+  loopEpoll();
+#else
+  loopPoll();
+#endif
+  tlsCurrentWorker = nullptr;
+  RtpPacketPool::setCurrent(nullptr);
+}
+
 #ifdef __linux__
+void RtpWorker::loopEpoll() {
   const int MAX_EVENTS = 64;
   struct epoll_event events[MAX_EVENTS];
   
   while (running_) {
+      refillSocketPool();
       int nfds = epoll_wait(epollFd_, events, MAX_EVENTS, 10);
-      
-      if (nfds > 0) {
-          for (int i = 0; i < nfds; ++i) {
-              int fd = (int)(events[i].data.u64 & 0xFFFFFFFF);
-              int port = (int)(events[i].data.u64 >> 32);
-              
-              RtpPacket pkt;
-              sockaddr_in sender{};
-              socklen_t len = sizeof(sender);
-              ssize_t n = recvfrom(fd, pkt.buffer, sizeof(pkt.buffer), 0,
-                                   (struct sockaddr *)&sender, &len);
-                                   
-              if (n > 0) {
-                pkt.parse(n);
-                
-                PacketHandler h;
-                {
-                    std::lock_guard<std::mutex> lock(mutex_);
-                    h = handler_;
-                }
-                
-                if (h) {
-                  h(port, pkt, sender);
-                }
-              }
+
+      for (int i = 0; i < nfds; ++i) {
+          if (events[i].data.u64 == kWakeEvent) {
+              uint64_t value;
+              ssize_t r = read(wakeFd_, &value, sizeof(value));
+              (void)r;
+              continue;
+          }
+          if (events[i].data.u64 == kTimerEvent) {
+              uint64_t expirations;
+              ssize_t r = read(timerFd_, &expirations, sizeof(expirations));
+              (void)r;
+              syncClock();
+              continue;
+          }
+          int fd = (int)(events[i].data.u64 & 0xFFFFFFFF);
+          int port = (int)(events[i].data.u64 >> 32);
+          if (options_.batchIo) {
+              receiveBatch(fd, port);
+              continue;
+          }
+
+          RtpPacketRef pkt = packetPool_->acquire();
+          sockaddr_in sender{};
+          socklen_t len = sizeof(sender);
+          ssize_t n = recvfrom(fd, pkt->buffer, sizeof(pkt->buffer), 0,
+                               (struct sockaddr *)&sender, &len);
+          if (n > 0) {
+            pkt->parse(n);
+            pkt->arrivalMs = mediaNowMs();
+            rxStats_.record(1);
+            dispatch(port, pkt, sender);
           }
       }
+      drainCommands();
+      flushSends();
   }
+  flushSends();
+}
 #else
-  // Fallback for non-Linux (macOS/Development) using poll
+void RtpWorker::loopPoll() {
+  // Fallback for non-Linux (macOS/Development) using poll. There is no
+  // eventfd here, so posted commands wait for the next pass (<= 10 ms).
   while (running_) {
+    refillSocketPool();
+    drainCommands();
+    syncClock();
     std::vector<struct pollfd> fds;
     std::vector<int> portMap;
-
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      fds.reserve(activeSockets_.size());
-      portMap.reserve(activeSockets_.size());
-      for (const auto &[port, fd] : activeSockets_) {
-        fds.push_back({fd, POLLIN, 0});
-        portMap.push_back(port);
+    for (size_t i = 0; i < fds_.size(); ++i) {
+      if (fds_[i] >= 0) {
+        fds.push_back({fds_[i], POLLIN, 0});
+        portMap.push_back(startPort_ + (int)i);
       }
     }
 
+    int timeoutMs = activeTicks_ > 0 ? std::min(10, options_.mediaTickMs) : 10;
     if (fds.empty()) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
       continue;
     }
 
-    int ret = ::poll(fds.data(), fds.size(), 10);
+    int ret = ::poll(fds.data(), fds.size(), timeoutMs);
     if (ret > 0) {
       for (size_t i = 0; i < fds.size(); ++i) {
         if (fds[i].revents & POLLIN) {
-          RtpPacket pkt;
+          RtpPacketRef pkt = packetPool_->acquire();
           sockaddr_in sender{};
           socklen_t len = sizeof(sender);
-          ssize_t n = recvfrom(fds[i].fd, pkt.buffer, sizeof(pkt.buffer), 0,
+          ssize_t n = recvfrom(fds[i].fd, pkt->buffer, sizeof(pkt->buffer), 0,
                                (struct sockaddr *)&sender, &len);
           if (n > 0) {
-            pkt.parse(n);
-            
-            PacketHandler h;
-            {
-                std::lock_guard<std::mutex> lock(mutex_);
-                h = handler_;
-            }
-            if (h) {
-              h(portMap[i], pkt, sender);
-            }
+            pkt->parse(n);
+            pkt->arrivalMs = mediaNowMs();
+            rxStats_.record(1);
+            dispatch(portMap[i], pkt, sender);
           }
         }
       }
     }
   }
+}
 #endif
+
+#ifdef RTP_HAVE_IO_URING
+bool RtpWorker::initUring() {
+  ring_ = std::make_unique<IoUring>();
+  if (!ring_->init(kUringEntries) ||
+      !ring_->setupBufferRing(kUringBuffers, kUringBufferSize) ||
+      !probeMultishotRecv()) {
+    LOG_WARN("RtpWorker " << workerId_ << " cannot use io_uring, falling back to epoll");
+    ring_.reset();
+    return false;
+  }
+
+  // Every received datagram lands in a provided buffer laid out as
+  // io_uring_recvmsg_out | sockaddr_in | payload
+  recvMsgTemplate_ = {};
+  recvMsgTemplate_.msg_namelen = sizeof(sockaddr_in);
+  armedFd_.assign(endPort_ - startPort_ + 1, -1);
+  cqeBacklog_.reserve(kUringEntries * 8);
+  LOG_INFO("RtpWorker " << workerId_ << " using io_uring backend");
+  return true;
+}
+
+bool RtpWorker::probeMultishotRecv() {
+  // Kernels before 6.0 accept the ring setup but reject multishot recvmsg
+  // with -EINVAL on first use, so try it once on a throwaway socket.
+  int fd = Net::createUdpSocket();
+  if (fd < 0)
+    return false;
+  struct msghdr msg {};
+  msg.msg_namelen = sizeof(sockaddr_in);
+
+  io_uring_sqe *sqe = ring_->getSqe();
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)&msg;
+  sqe->len = 1;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = IoUring::kBufferGroup;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = 1;
+  ring_->submit();
+
+  sqe = ring_->getSqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = 1;
+  sqe->user_data = 2;
+
+  bool supported = true;
+  bool recvDone = false;
+  io_uring_cqe cqes[4];
+  for (int attempt = 0; attempt < 10 && !recvDone; ++attempt) {
+    ring_->submitAndWait(1, 10);
+    unsigned n = ring_->reapCqes(cqes, 4);
+    for (unsigned i = 0; i < n; ++i) {
+      if (cqes[i].user_data != 1)
+        continue;
+      if (cqes[i].res == -EINVAL)
+        supported = false;
+      if (cqes[i].flags & IORING_CQE_F_BUFFER)
+        ring_->recycleBuffer(cqes[i].flags >> IORING_CQE_BUFFER_SHIFT);
+      if (!(cqes[i].flags & IORING_CQE_F_MORE))
+        recvDone = true;
+    }
+  }
+  ring_->commitBuffers();
+  Net::closeSocket(fd);
+
+  if (!supported)
+    LOG_WARN("Kernel does not support multishot recvmsg");
+  return supported && recvDone;
+}
+
+void RtpWorker::armRecv(int port, int fd) {
+  io_uring_sqe *sqe = ring_->getSqe();
+  if (!sqe) {
+    LOG_ERROR("io_uring SQ full, cannot arm port " << port);
+    return;
+  }
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)&recvMsgTemplate_;
+  sqe->len = 1;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = IoUring::kBufferGroup;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = uringUserData(kUringRecv, port, fd);
+  armedFd_[port - startPort_] = fd;
+}
+
+void RtpWorker::armWake() {
+  // Multishot poll on the command queue eventfd
+  io_uring_sqe *sqe = ring_->getSqe();
+  if (!sqe) {
+    LOG_ERROR("io_uring SQ full, cannot arm wakeup for worker " << workerId_);
+    return;
+  }
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = wakeFd_;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = uringUserData(kUringWake, 0, 0);
+}
+
+void RtpWorker::armTimer() {
+  if (timerFd_ < 0)
+    return;
+  io_uring_sqe *sqe = ring_->getSqe();
+  if (!sqe) {
+    LOG_ERROR("io_uring SQ full, cannot arm media clock for worker " << workerId_);
+    return;
+  }
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = timerFd_;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = uringUserData(kUringTimer, 0, 0);
+}
+
+void RtpWorker::handleCqe(const io_uring_cqe &cqe) {
+  uint64_t op = uringOp(cqe.user_data);
+  if (op == kUringSend) {
+    uint32_t slot = uringValue(cqe.user_data);
+    txInflight_[slot / options_.batchSize]--;
+    txPackets_[slot].reset();
+    if (cqe.res < 0) {
+      LOG_DEBUG("io_uring send failed on worker " << workerId_ << ": " << strerror(-cqe.res));
+    }
+    return;
+  }
+  if (op == kUringWake) {
+    uint64_t value;
+    ssize_t r = read(wakeFd_, &value, sizeof(value));
+    (void)r;
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+      armWake();
+    return;
+  }
+  if (op == kUringTimer) {
+    uint64_t expirations;
+    ssize_t r = read(timerFd_, &expirations, sizeof(expirations));
+    (void)r;
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+      armTimer();
+    syncClock();
+    return;
+  }
+  if (op != kUringRecv)
+    return;
+
+  int port = uringPort(cqe.user_data);
+  int fd = (int)uringValue(cqe.user_data);
+
+  if (cqe.flags & IORING_CQE_F_BUFFER) {
+    uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+    if (cqe.res > 0) {
+      uint8_t *buf = ring_->bufferAddress(bid);
+      auto *out = reinterpret_cast<io_uring_recvmsg_out *>(buf);
+      size_t header = sizeof(*out) + recvMsgTemplate_.msg_namelen +
+                      recvMsgTemplate_.msg_controllen;
+      if ((size_t)cqe.res >= header) {
+        size_t len = std::min<size_t>(out->payloadlen, cqe.res - header);
+        if (!uringPacket_.unique())
+          uringPacket_ = packetPool_->acquire();
+        len = std::min(len, sizeof(uringPacket_->buffer));
+        sockaddr_in sender{};
+        memcpy(&sender, buf + sizeof(*out),
+               std::min<size_t>(out->namelen, sizeof(sender)));
+        memcpy(uringPacket_->buffer, buf + header, len);
+        uringPacket_->parse(len);
+        uringPacket_->arrivalMs = mediaNowMs();
+        dispatch(port, uringPacket_, sender);
+      }
+    }
+    ring_->recycleBuffer(bid);
+  }
+
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    // Multishot ended: cancelled on release, or the buffer ring ran dry
+    // (-ENOBUFS). Re-arm if the socket is still ours.
+    if (armedFd_[port - startPort_] == fd && cqe.res != -ECANCELED) {
+      if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+        LOG_WARN("io_uring recv on port " << port << " ended: " << strerror(-cqe.res));
+      }
+      armRecv(port, fd);
+    }
+  }
+}
+
+void RtpWorker::submitSends() {
+  if (txCount_ == 0)
+    return;
+  size_t base = txBank_ * options_.batchSize;
+  for (size_t i = base; i < base + txCount_; ++i) {
+    io_uring_sqe *sqe = ring_->getSqe();
+    if (!sqe) {
+      LOG_DEBUG("io_uring SQ full, dropping " << base + txCount_ - i << " frames");
+      for (size_t j = i; j < base + txCount_; ++j) {
+        txPackets_[j].reset();
+      }
+      break;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = txFds_[i];
+    sqe->addr = (uint64_t)(uintptr_t)&txMsgs_[i].msg_hdr;
+    sqe->len = 1;
+    sqe->user_data = uringUserData(kUringSend, 0, (uint32_t)i);
+    txInflight_[txBank_]++;
+  }
+  txStats_.record(txCount_);
+  txCount_ = 0;
+  txBank_ ^= 1;
+  ring_->submit();
+}
+
+void RtpWorker::reapSends() {
+  io_uring_cqe cqes[64];
+  unsigned n = ring_->reapCqes(cqes, 64);
+  for (unsigned i = 0; i < n; ++i) {
+    if (uringOp(cqes[i].user_data) == kUringSend) {
+      handleCqe(cqes[i]);
+    } else {
+      // Receives are handled by the loop, not from inside a dispatch
+      cqeBacklog_.push_back(cqes[i]);
+    }
+  }
 }
+
+void RtpWorker::waitForSends(size_t bank) {
+  while (txInflight_[bank] > 0) {
+    ring_->submitAndWait(1, 10);
+    reapSends();
+  }
+}
+
+void RtpWorker::loopUring() {
+  io_uring_cqe cqes[kUringEntries];
+  armWake();
+  armTimer();
+
+  while (running_) {
+    refillSocketPool();
+
+    ring_->submitAndWait(1, 10);
+    unsigned n = ring_->reapCqes(cqes, kUringEntries);
+    // Send completions are handled right away: a dispatch below may wait
+    // for them, and must not find them queued behind itself
+    for (unsigned i = 0; i < n; ++i) {
+      if (uringOp(cqes[i].user_data) == kUringSend)
+        handleCqe(cqes[i]);
+      else
+        cqeBacklog_.push_back(cqes[i]);
+    }
+
+    size_t received = 0;
+    // handleCqe may append to the backlog (via waitForSends), so index it
+    for (size_t i = 0; i < cqeBacklog_.size(); ++i) {
+      io_uring_cqe cqe = cqeBacklog_[i];
+      if (uringOp(cqe.user_data) == kUringRecv && cqe.res > 0)
+        received++;
+      handleCqe(cqe);
+    }
+    cqeBacklog_.clear();
+    ring_->commitBuffers();
+    if (received > 0)
+      rxStats_.record(received);
+
+    drainCommands();
+    flushSends();
+  }
+  flushSends();
+}
+#endif
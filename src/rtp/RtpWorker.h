@@ -1,50 +1,248 @@
 #pragma once
 
-#include "RtpPacket.h"
+#include "../util/MpscQueue.h"
+#include "../util/TimerWheel.h"
+#include "IoUring.h"
+#include "RtpPacketPool.h"
+#include "RtpSink.h"
 #include <atomic>
-#include <functional>
-#include <map>
-#include <mutex>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
 #include <netinet/in.h>
 #include <thread>
 #include <vector>
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+enum class RtpIoBackend { EPOLL, IO_URING };
+
+struct RtpWorkerOptions {
+  // io_uring needs a 6.0+ kernel; workers fall back to epoll without it
+  RtpIoBackend ioBackend = RtpIoBackend::EPOLL;
+
+  // Drain sockets with recvmmsg and flush queued frames with sendmmsg
+  // (Linux only, ignored elsewhere).
+  bool batchIo = true;
+  int batchSize = 32;
+
+  // Sockets kept pre-bound per worker so allocatePort is just a pop
+  int socketPoolSize = 16;
+  // How long a released port stays out of circulation
+  int portQuarantineMs = 2000;
+
+  // Depth of the command queue other threads post sends and port
+  // allocate/release requests to. Frames are dropped when it is full.
+  int commandQueueSize = 4096;
+
+  // Media clock resolution. Sinks are ticked at their packetization interval
+  // rounded to this. With virtualClock the clock only moves through
+  // advanceVirtualClock, for deterministic runs.
+  int mediaTickMs = 5;
+  bool virtualClock = false;
+};
 
 class RtpWorker {
 public:
-  using PacketHandler = std::function<void(int localPort, const RtpPacket &,
-                                           const sockaddr_in &)>;
+  // Batch size histogram buckets: 1, 2-3, 4-7, 8-15, 16-31, 32+
+  static constexpr int kBatchBuckets = 6;
+
+  struct BatchStats {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> histogram[kBatchBuckets] = {};
 
-  RtpWorker(int workerId, int startPort, int endPort);
+    void record(size_t n);
+  };
+
+  RtpWorker(int workerId, int startPort, int endPort,
+            const RtpWorkerOptions &options = RtpWorkerOptions());
   ~RtpWorker();
 
   void start();
   void stop();
 
-  // Thread-safe methods called from other threads (mostly RtpServer/Main)
-  int allocatePort();
+  // Thread-safe methods called from other threads (mostly RtpServer/Main).
+  // They post a command to the worker's queue, so only the worker thread
+  // ever touches its sockets. allocatePort waits for the reply; the sink
+  // stays registered in the dispatch table until releasePort.
+  int allocatePort(std::shared_ptr<RtpSink> sink);
   void releasePort(int port);
-  void send(int localPort, const RtpPacket &packet, const sockaddr_in &dest);
+  void send(int localPort, RtpPacketRef packet, const sockaddr_in &dest);
+
+  // Step the media clock by ms (virtual clock only)
+  void advanceVirtualClock(int ms);
+
+  // False when io_uring was asked for but is not available
+  bool usesIoUring() const { return useUring_; }
 
-  void setPacketHandler(PacketHandler handler);
-  
   int getStartPort() const { return startPort_; }
   int getEndPort() const { return endPort_; }
 
+  const BatchStats &getRxStats() const { return rxStats_; }
+  const BatchStats &getTxStats() const { return txStats_; }
+  void logStats() const;
+
 private:
+  // Answer to an ALLOCATE. The caller gives up after a while; whichever of
+  // it and the worker claims the reply first decides whether the port is
+  // handed over or released again.
+  struct AllocateReply {
+    enum State { PENDING, ANSWERED, ABANDONED };
+    std::atomic<int> state{PENDING};
+    std::promise<int> port;
+  };
+
+  struct Command {
+    enum class Type { SEND, ALLOCATE, RELEASE, ADVANCE_CLOCK };
+    Type type = Type::SEND;
+    int port = 0;
+    uint64_t ms = 0;
+    RtpPacketRef packet;
+    sockaddr_in dest{};
+    std::shared_ptr<RtpSink> sink;
+    std::shared_ptr<AllocateReply> reply;
+  };
+
   void loop();
+#ifdef __linux__
+  void loopEpoll();
+#else
+  void loopPoll();
+#endif
+
+  // Command queue. post() is callable from any thread and wakes the loop;
+  // everything else runs on the worker thread (or inline before start and
+  // after stop, when there is no loop thread).
+  bool post(Command &&cmd);
+  void drainCommands();
+  void runCommand(Command &cmd);
+  int doAllocate(std::shared_ptr<RtpSink> sink);
+  void doRelease(int port);
+  void doSend(int port, RtpPacketRef packet, const sockaddr_in &dest);
+  bool onLoopThread() const;
+
+  // Media clock, loop thread only
+  uint64_t currentTick() const;
+  uint64_t mediaNowMs() const;
+  void syncClock();
+  void startMediaTick(int idx, RtpSink *sink);
+  void stopMediaTick(int idx);
+  void onMediaTimer(int idx);
+  void setTimerArmed(bool armed);
+
+  int openSocket(int port);
+  void closeSocket(int port, int fd);
+  void refillSocketPool();
+  void releaseQuarantinedPorts(std::chrono::steady_clock::time_point now);
+  void dispatch(int port, const RtpPacketRef &pkt, const sockaddr_in &sender);
+
+#ifdef RTP_HAVE_IO_URING
+  bool initUring();
+  bool probeMultishotRecv();
+  void loopUring();
+  void armWake();
+  void armTimer();
+  void armRecv(int port, int fd);
+  void handleCqe(const io_uring_cqe &cqe);
+  void submitSends();
+  // Handle the send completions that are already there
+  void reapSends();
+  void waitForSends(size_t bank);
+#endif
+
+#ifdef __linux__
+  void receiveBatch(int fd, int port);
+  void queueSend(int fd, RtpPacketRef packet, const sockaddr_in &dest);
+  void flushSends();
+#endif
 
   int workerId_;
   int startPort_;
   int endPort_;
+  RtpWorkerOptions options_;
 
   std::atomic<bool> running_{false};
+  std::atomic<bool> started_{false}; // commands are posted while set
   std::thread thread_;
 
-  std::mutex mutex_;
-  std::map<int, int> activeSockets_; // port -> fd
-  PacketHandler handler_;
+  MpscQueue<Command> commands_;
+  std::atomic<bool> wakePending_{false};
+  int wakeFd_ = -1; // eventfd, Linux only
+  std::atomic<uint64_t> droppedSends_{0};
+
+  // Everything below is owned by the worker thread.
+
+  // Sockets indexed by (port - startPort_), -1 when the port is not open
+  std::vector<int> fds_;
+
+  // Port allocator
+  std::deque<int> freePorts_;                   // FIFO so ports are reused last
+  std::deque<std::pair<int, std::chrono::steady_clock::time_point>>
+      quarantine_;                              // released port -> reusable at
+  std::vector<std::pair<int, int>> pool_;       // pre-bound port -> fd
+
+  // Dispatch table indexed by (port - startPort_). The loop only does an
+  // atomic load per packet; owners_ keeps the sinks alive. releasePort
+  // clears the slot at once from the caller's thread, while the socket close
+  // and the final sink reference are dropped by the RELEASE command so a
+  // sink is never destroyed in the middle of its own dispatch.
+  std::unique_ptr<std::atomic<RtpSink *>[]> sinks_;
+  std::vector<std::shared_ptr<RtpSink>> owners_;
+
+  // Media clock: one wheel tick per mediaTickMs. In real mode the wheel
+  // follows steady_clock and a timerfd wakes the loop while any sink is
+  // ticking.
+  struct MediaTick {
+    RtpSink *sink = nullptr;
+    uint64_t interval = 0; // in wheel ticks
+    uint64_t next = 0;
+    TimerWheel::TimerId timer = 0;
+  };
+  TimerWheel wheel_;
+  std::vector<MediaTick> ticks_;
+  size_t activeTicks_ = 0;
+  std::chrono::steady_clock::time_point clockStart_;
+  uint64_t virtualMs_ = 0; // virtual clock only
+  int timerFd_ = -1; // timerfd, Linux real clock only
+
+  // Receive buffers and downlink frames built on this worker's thread come
+  // from here; retired (not deleted) in the destructor
+  RtpPacketPool *packetPool_ = nullptr;
+
+  BatchStats rxStats_;
+  BatchStats txStats_;
 
 #ifdef __linux__
   int epollFd_ = -1;
+
+  // Preallocated batch state, only touched by the worker thread. Queued
+  // frames hold a reference until they have been sent.
+  std::vector<RtpPacketRef> rxPackets_;
+  std::vector<sockaddr_in> rxAddrs_;
+  std::vector<struct iovec> rxIov_;
+  std::vector<struct mmsghdr> rxMsgs_;
+
+  std::vector<RtpPacketRef> txPackets_;
+  std::vector<sockaddr_in> txAddrs_;
+  std::vector<int> txFds_;
+  std::vector<struct iovec> txIov_;
+  std::vector<struct mmsghdr> txMsgs_;
+  size_t txCount_ = 0;
+#endif
+
+  bool useUring_ = false;
+#ifdef RTP_HAVE_IO_URING
+  std::unique_ptr<IoUring> ring_;
+  struct msghdr recvMsgTemplate_ {};
+  std::vector<int> armedFd_; // per port slot
+  std::vector<io_uring_cqe> cqeBacklog_;
+  RtpPacketRef uringPacket_;
+  // Sends the kernel still owns, per tx bank. queueSend fills bank
+  // txBank_ (slots txBank_ * batchSize onwards), submitSends flips it.
+  size_t txInflight_[2] = {0, 0};
+  size_t txBank_ = 0;
 #endif
 };
@@ -1,147 +1,279 @@
 #include "SipMessage.h"
-#include <algorithm>
-#include <sstream>
-
-void SipMessage::addHeader(const std::string &name, const std::string &value) {
-  std::string lowerName = name;
-  std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
-  headers.insert({lowerName, value});
-}
-
-std::optional<std::string>
-SipMessage::getHeader(const std::string &name) const {
-  std::string lowerName = name;
-  std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
-  auto it = headers.find(lowerName);
-  if (it != headers.end()) {
-    return it->second;
+#include <charconv>
+#include <cstring>
+
+static char lowerAscii(char c) {
+  return c >= 'A' && c <= 'Z' ? (char)(c | 0x20) : c;
+}
+
+// SIP tokens are ASCII, so no locale is involved
+static bool iequals(std::string_view a, std::string_view b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (lowerAscii(a[i]) != lowerAscii(b[i]))
+      return false;
+  }
+  return true;
+}
+
+static std::string_view trimView(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    s.remove_suffix(1);
+  return s;
+}
+
+SipMethod parseSipMethod(std::string_view sv) {
+  switch (sv.size()) {
+  case 3:
+    if (iequals(sv, "ACK"))
+      return SipMethod::ACK;
+    if (iequals(sv, "BYE"))
+      return SipMethod::BYE;
+    break;
+  case 5:
+    if (iequals(sv, "REFER"))
+      return SipMethod::REFER;
+    break;
+  case 6:
+    if (iequals(sv, "INVITE"))
+      return SipMethod::INVITE;
+    if (iequals(sv, "CANCEL"))
+      return SipMethod::CANCEL;
+    break;
+  case 7:
+    if (iequals(sv, "OPTIONS"))
+      return SipMethod::OPTIONS;
+    break;
+  }
+  return SipMethod::UNKNOWN;
+}
+
+SipHeader SipMessage::classifyHeader(std::string_view name) {
+  switch (name.size()) {
+  case 1:
+    switch (lowerAscii(name[0])) {
+    case 'v':
+      return SipHeader::Via;
+    case 'f':
+      return SipHeader::From;
+    case 't':
+      return SipHeader::To;
+    case 'i':
+      return SipHeader::CallId;
+    case 'l':
+      return SipHeader::ContentLength;
+    case 'm':
+      return SipHeader::Contact;
+    }
+    break;
+  case 2:
+    if (iequals(name, "To"))
+      return SipHeader::To;
+    break;
+  case 3:
+    if (iequals(name, "Via"))
+      return SipHeader::Via;
+    break;
+  case 4:
+    if (iequals(name, "From"))
+      return SipHeader::From;
+    if (iequals(name, "CSeq"))
+      return SipHeader::CSeq;
+    break;
+  case 7:
+    if (iequals(name, "Call-ID"))
+      return SipHeader::CallId;
+    if (iequals(name, "Contact"))
+      return SipHeader::Contact;
+    break;
+  case 14:
+    if (iequals(name, "Content-Length"))
+      return SipHeader::ContentLength;
+    break;
+  }
+  return SipHeader::Other;
+}
+
+SipMessage::SipMessage() { first_.fill(-1); }
+
+SipMessage::Text SipMessage::slice(std::string_view s) const {
+  return {(uint32_t)(s.data() - raw_), (uint32_t)s.size(), false};
+}
+
+SipMessage::Text SipMessage::own(std::string_view s) {
+  Text t{(uint32_t)owned_.size(), (uint32_t)s.size(), true};
+  owned_.append(s.data(), s.size());
+  return t;
+}
+
+void SipMessage::pushHeader(SipHeader id, Text name, Text value) {
+  if (id != SipHeader::Other && first_[(size_t)id] < 0)
+    first_[(size_t)id] = (int16_t)headers_.size();
+  headers_.push_back({id, name, value});
+}
+
+void SipMessage::setRequestLine(std::string_view methodStr,
+                                std::string_view uri,
+                                std::string_view version) {
+  isRequest = true;
+  method = parseSipMethod(methodStr);
+  methodStr_ = own(methodStr);
+  uri_ = own(uri);
+  version_ = own(version);
+}
+
+void SipMessage::setStatusLine(std::string_view version, int code,
+                               std::string_view phrase) {
+  isRequest = false;
+  statusCode = code;
+  version_ = own(version);
+  statusPhrase_ = own(phrase);
+}
+
+void SipMessage::addHeader(std::string_view name, std::string_view value) {
+  Text n = own(name);
+  pushHeader(classifyHeader(name), n, own(value));
+}
+
+void SipMessage::setBody(std::string_view body) { body_ = own(body); }
+
+std::string_view SipMessage::header(SipHeader h) const {
+  if (h == SipHeader::Other)
+    return {};
+  int16_t i = first_[(size_t)h];
+  return i < 0 ? std::string_view() : view(headers_[i].value);
+}
+
+std::optional<std::string_view>
+SipMessage::getHeader(std::string_view name) const {
+  SipHeader id = classifyHeader(name);
+  if (id != SipHeader::Other) {
+    int16_t i = first_[(size_t)id];
+    if (i < 0)
+      return std::nullopt;
+    return view(headers_[i].value);
+  }
+  for (const auto &entry : headers_) {
+    if (entry.id == SipHeader::Other && iequals(view(entry.name), name))
+      return view(entry.value);
   }
   return std::nullopt;
 }
 
 std::string SipMessage::toString() const {
-  std::ostringstream oss;
+  std::string_view ver = version().empty() ? "SIP/2.0" : version();
+  std::string out;
+  out.reserve(256 + owned_.size() + body_.len);
   if (isRequest) {
-    oss << methodStr << " " << uri << " " << version << "\r\n";
+    out.append(methodStr()).append(" ").append(uri()).append(" ").append(ver);
   } else {
-    oss << version << " " << statusCode << " " << statusPhrase << "\r\n";
+    out.append(ver).append(" ").append(std::to_string(statusCode));
+    out.append(" ").append(statusPhrase());
   }
+  out.append("\r\n");
 
-  for (const auto &[rawName, value] : headers) {
-    // Basic normalization for output (Camel-Case like)
-    // Though lowercase is technically valid too.
-    // Let's keep them as they are in the map (which is lowercase now)
-    // or we could store original names too, but SIP is case-insensitive.
-    oss << rawName << ": " << value << "\r\n";
-  }
-  // Content-Length is special, we always recalculate it.
-  // Note: we might have 'content-length' in the headers map now.
-  // toString should avoid double output.
-  if (getHeader("Content-Length") == std::nullopt) {
-      oss << "Content-Length: " << body.size() << "\r\n";
+  for (const auto &entry : headers_) {
+    out.append(view(entry.name)).append(": ").append(view(entry.value));
+    out.append("\r\n");
   }
-  
-  oss << "\r\n";
-  oss << body;
-  return oss.str();
-}
+  // Content-Length is special, we always recalculate it unless it was given
+  if (first_[(size_t)SipHeader::ContentLength] < 0)
+    out.append("Content-Length: ").append(std::to_string(body_.len)).append("\r\n");
 
-std::string SipMessage::getCallId() const {
-  return getHeader("Call-ID").value_or("");
+  out.append("\r\n");
+  out.append(body());
+  return out;
 }
 
-std::string SipMessage::getFromTag() const {
-  auto from = getHeader("From").value_or("");
-  auto pos = from.find("tag=");
-  if (pos != std::string::npos) {
-    auto tag = from.substr(pos + 4);
-    auto end = tag.find(';');
-    if (end != std::string::npos) {
-      return tag.substr(0, end);
+// Parameters of a name-addr (<...>) start after the closing bracket so URI
+// parameters are not mistaken for them. Only the first of comma-separated
+// values is searched; a quoted display name may hold any of these
+// characters.
+std::string_view SipMessage::headerParam(std::string_view value,
+                                         std::string_view name) {
+  const char *p = value.data();
+  const char *end = p + value.size();
+  while (p < end && *p != ';') {
+    if (*p == ',')
+      return {};
+    if (*p == '"' || *p == '<') {
+      const char *close =
+          (const char *)memchr(p + 1, *p == '"' ? '"' : '>', end - p - 1);
+      if (!close)
+        return {};
+      p = close;
     }
-    return tag;
+    p++;
+  }
+  while (p < end) {
+    const char *paramName = ++p;
+    while (p < end && *p != '=' && *p != ';' && *p != ',')
+      p++;
+    const char *nameEnd = p;
+    const char *paramValue = p < end && *p == '=' ? ++p : nullptr;
+    while (p < end && *p != ';' && *p != ',')
+      p++;
+    if (paramValue &&
+        iequals(trimView({paramName, (size_t)(nameEnd - paramName)}), name))
+      return trimView({paramValue, (size_t)(p - paramValue)});
+    if (p == end || *p == ',')
+      break; // no more parameters of the first value
   }
-  return "";
+  return {};
 }
 
-std::string SipMessage::getToTag() const {
-  auto to = getHeader("To").value_or("");
-  auto pos = to.find("tag=");
-  if (pos != std::string::npos) {
-    auto tag = to.substr(pos + 4);
-    auto end = tag.find(';');
-    if (end != std::string::npos) {
-      return tag.substr(0, end);
-    }
-    return tag;
-  }
-  return "";
+std::string_view SipMessage::getFromTag() const {
+  return headerParam(header(SipHeader::From), "tag");
+}
+
+std::string_view SipMessage::getToTag() const {
+  return headerParam(header(SipHeader::To), "tag");
 }
 
 int SipMessage::getCSeq() const {
-  auto cseq = getHeader("CSeq").value_or("");
-  std::istringstream iss(cseq);
+  auto cseq = trimView(header(SipHeader::CSeq));
   int seq = 0;
-  if (!(iss >> seq)) return 0;
+  std::from_chars(cseq.data(), cseq.data() + cseq.size(), seq);
   return seq;
 }
 
 SipMethod SipMessage::getCSeqMethod() const {
-  auto cseq = getHeader("CSeq").value_or("");
-  auto pos = cseq.find(' ');
-  if (pos != std::string::npos) {
-    std::string m = cseq.substr(pos + 1);
-    if (m == "INVITE")
-      return SipMethod::INVITE;
-    if (m == "ACK")
-      return SipMethod::ACK;
-    if (m == "BYE")
-      return SipMethod::BYE;
-    if (m == "CANCEL")
-      return SipMethod::CANCEL;
-    if (m == "OPTIONS")
-      return SipMethod::OPTIONS;
-    if (m == "REFER")
-      return SipMethod::REFER;
-  }
-  return SipMethod::UNKNOWN;
+  auto cseq = header(SipHeader::CSeq);
+  auto pos = cseq.find_first_of(" \t");
+  if (pos == std::string_view::npos)
+    return SipMethod::UNKNOWN;
+  return parseSipMethod(trimView(cseq.substr(pos + 1)));
 }
 
-std::string SipMessage::getBranch() const {
-  auto via = getHeader("Via").value_or("");
-  auto pos = via.find("branch=");
-  if (pos != std::string::npos) {
-    // branch is usually until ; or end
-    auto end = via.find(';', pos);
-    if (end == std::string::npos)
-      return via.substr(pos + 7);
-    return via.substr(pos + 7, end - (pos + 7));
-  }
-  return "";
+std::string_view SipMessage::getBranch() const {
+  return headerParam(header(SipHeader::Via), "branch");
 }
 
-static std::string extractUserFromUri(const std::string& uri) {
+static std::string_view extractUserFromUri(std::string_view uri) {
   // Extract user from <sip:user@host> or sip:user@host
   size_t start = uri.find("sip:");
-  if (start == std::string::npos) return "";
+  if (start == std::string_view::npos)
+    return {};
   start += 4;
-  
+
   size_t end = uri.find('@', start);
-  if (end == std::string::npos) {
+  if (end == std::string_view::npos) {
     // Maybe it's just sip:user
     end = uri.find('>', start);
-    if (end == std::string::npos) end = uri.size();
+    if (end == std::string_view::npos)
+      end = uri.size();
   }
-  
+
   return uri.substr(start, end - start);
 }
 
-std::string SipMessage::getFromUser() const {
-  auto from = getHeader("From").value_or("");
-  return extractUserFromUri(from);
+std::string_view SipMessage::getFromUser() const {
+  return extractUserFromUri(header(SipHeader::From));
 }
 
-std::string SipMessage::getToUser() const {
-  auto to = getHeader("To").value_or("");
-  return extractUserFromUri(to);
+std::string_view SipMessage::getToUser() const {
+  return extractUserFromUri(header(SipHeader::To));
 }
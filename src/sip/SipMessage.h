@@ -1,44 +1,123 @@
 #pragma once
 
-#include <map>
+#include <array>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class SipMethod { INVITE, ACK, BYE, CANCEL, OPTIONS, REFER, UNKNOWN };
 
+SipMethod parseSipMethod(std::string_view sv);
+
+// Headers the gateway reads on every message, looked up by index rather
+// than by name. Compact forms (v, f, t, i, l, m) map to the same entries.
+enum class SipHeader : uint8_t {
+  Via,
+  From,
+  To,
+  CallId,
+  CSeq,
+  ContentLength,
+  Contact,
+  Other
+};
+
+// A parsed or built SIP message. Parsed messages are slices of the datagram
+// they were parsed from, which must outlive them (SipServer hands them to
+// the handler while its receive buffer is still intact). Text added while
+// building a message is owned by it, so built messages can be kept.
 class SipMessage {
 public:
+  SipMessage();
+
   bool isRequest = false;
+  SipMethod method = SipMethod::UNKNOWN;
+  int statusCode = 0;
 
   // Request Line
-  SipMethod method = SipMethod::UNKNOWN;
-  std::string methodStr;
-  std::string uri;
-  std::string version = "SIP/2.0";
+  std::string_view methodStr() const { return view(methodStr_); }
+  std::string_view uri() const { return view(uri_); }
+  std::string_view version() const { return view(version_); }
+  void setRequestLine(std::string_view methodStr, std::string_view uri,
+                      std::string_view version = "SIP/2.0");
 
   // Status Line (if response)
-  int statusCode = 0;
-  std::string statusPhrase;
+  std::string_view statusPhrase() const { return view(statusPhrase_); }
+  void setStatusLine(std::string_view version, int code,
+                     std::string_view phrase);
 
-  // Headers
-  std::multimap<std::string, std::string> headers;
+  // Headers, in the order they were parsed or added
+  void addHeader(std::string_view name, std::string_view value);
+  // First value of a header, or empty if absent
+  std::string_view header(SipHeader h) const;
+  std::optional<std::string_view> getHeader(std::string_view name) const;
+  // Every value of a well-known header, e.g. all Vias, in order
+  template <typename F> void forEachHeader(SipHeader h, F &&f) const {
+    for (const auto &entry : headers_)
+      if (entry.id == h)
+        f(view(entry.value));
+  }
 
   // Body
-  std::string body;
+  std::string_view body() const { return view(body_); }
+  void setBody(std::string_view body);
 
-  // Helpers
-  void addHeader(const std::string &name, const std::string &value);
-  std::optional<std::string> getHeader(const std::string &name) const;
   std::string toString() const;
 
-  // Common Header Parsing helpers
-  std::string getCallId() const;
-  std::string getFromTag() const;
-  std::string getToTag() const;
+  // Common Header Parsing helpers; parameters are found on each call
+  std::string_view getCallId() const { return header(SipHeader::CallId); }
+  std::string_view getFromTag() const;
+  std::string_view getToTag() const;
   int getCSeq() const;
   SipMethod getCSeqMethod() const;
-  std::string getBranch() const;
-  std::string getFromUser() const;
-  std::string getToUser() const;
+  std::string_view getBranch() const;
+  std::string_view getFromUser() const;
+  std::string_view getToUser() const;
+
+  static SipHeader classifyHeader(std::string_view name);
+  // Value of a ;name=value header parameter, or empty
+  static std::string_view headerParam(std::string_view value,
+                                      std::string_view name);
+
+private:
+  friend class SipParser;
+
+  // Where some text of the message lives: in the parsed datagram, or in
+  // owned_. Offsets rather than pointers keep copies of a built message
+  // valid.
+  struct Text {
+    uint32_t off = 0;
+    uint32_t len = 0;
+    bool owned = false;
+  };
+
+  struct Header {
+    SipHeader id;
+    Text name;
+    Text value;
+  };
+
+  static constexpr size_t kIndexedHeaders = (size_t)SipHeader::Other;
+
+  std::string_view view(Text t) const {
+    return {(t.owned ? owned_.data() : raw_) + t.off, t.len};
+  }
+  Text slice(std::string_view s) const; // s lies within raw_
+  Text own(std::string_view s);
+  void pushHeader(SipHeader id, Text name, Text value);
+
+  const char *raw_ = nullptr;
+  std::string owned_;
+
+  Text methodStr_;
+  Text uri_;
+  Text version_;
+  Text statusPhrase_;
+  Text body_;
+
+  std::vector<Header> headers_;
+  // Position of the first of each indexed header in headers_, or -1
+  std::array<int16_t, kIndexedHeaders> first_;
 };
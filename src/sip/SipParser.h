@@ -1,13 +1,61 @@
 #pragma once
 
 #include "SipMessage.h"
+#include <cstring>
 #include <optional>
 #include <string_view>
 
+// Single pass over the datagram; the message refers into buffer rather than
+// copying it (see SipMessage), so buffer must outlive the result.
 class SipParser {
 public:
   static std::optional<SipMessage> parse(const char *buffer, size_t length);
 
+  // Calls f(SipHeader, name, value) for each header of a datagram without
+  // building a SipMessage, for fast paths that read a few headers. Returns
+  // false on a malformed start line or a folded header line, which such
+  // callers leave to parse().
+  template <typename F>
+  static bool forEachHeader(const char *buffer, size_t length, F &&f) {
+    const char *pos = buffer;
+    const char *end = buffer + length;
+    if (nextLine(pos, end).find(' ') == std::string_view::npos)
+      return false;
+    while (pos < end) {
+      std::string_view line = nextLine(pos, end);
+      if (line.empty())
+        return true;
+      if (line[0] == ' ' || line[0] == '\t')
+        return false;
+      auto colon = line.find(':');
+      if (colon == std::string_view::npos)
+        continue;
+      auto name = trimView(line.substr(0, colon));
+      f(SipMessage::classifyHeader(name), name,
+        trimView(line.substr(colon + 1)));
+    }
+    return true;
+  }
+
 private:
-  static SipMethod parseMethod(std::string_view sv);
+  static bool parseStartLine(SipMessage &msg, std::string_view line);
+
+  // Next line of [pos, end) without its CRLF (or bare LF); pos moves past it
+  static std::string_view nextLine(const char *&pos, const char *end) {
+    const char *nl = (const char *)memchr(pos, '\n', end - pos);
+    const char *lineEnd = nl ? nl : end;
+    std::string_view line(pos, lineEnd - pos);
+    if (!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+    pos = nl ? nl + 1 : end;
+    return line;
+  }
+
+  static std::string_view trimView(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+      s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+      s.remove_suffix(1);
+    return s;
+  }
 };
@@ -1,44 +1,157 @@
 #include "SipResponseBuilder.h"
+#include "SipParser.h"
+#include <charconv>
 #include <chrono>
+#include <cstring>
 
-SipMessage SipResponseBuilder::createResponse(const SipMessage &req, int code,
-                                              const std::string &phrase) {
-  SipMessage res;
-  res.isRequest = false;
-  res.version = req.version;
-  res.statusCode = code;
-  res.statusPhrase = phrase;
-
-  // Copy critical headers
-  auto vias = req.headers.equal_range("via");
-  for (auto it = vias.first; it != vias.second; ++it) {
-    res.addHeader("Via", it->second);
+namespace {
+
+// Appends to the send buffer; once something does not fit the response is
+// dropped and size() is 0
+class Out {
+public:
+  Out(char *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  Out &operator<<(std::string_view s) {
+    if (s.size() > cap_ - len_) {
+      overflow_ = true;
+      return *this;
+    }
+    memcpy(buf_ + len_, s.data(), s.size());
+    len_ += s.size();
+    return *this;
   }
-  
-  auto from = req.getHeader("From");
-  if (from)
-    res.addHeader("From", *from);
-    
-  auto to = req.getHeader("To");
-  if (to) {
-    std::string toVal = *to;
-    if (code >= 200 && toVal.find("tag=") == std::string::npos) {
+
+  Out &operator<<(uint64_t n) {
+    char digits[20];
+    auto res = std::to_chars(digits, digits + sizeof(digits), n);
+    return *this << std::string_view(digits, res.ptr - digits);
+  }
+
+  size_t size() const { return overflow_ ? 0 : len_; }
+
+private:
+  char *buf_;
+  size_t cap_;
+  size_t len_ = 0;
+  bool overflow_ = false;
+};
+
+struct StatusLine {
+  int code;
+  std::string_view phrase;
+  std::string_view line;
+};
+
+// The responses the gateway sends most
+constexpr StatusLine kStatusLines[] = {
+    {100, "Trying", "SIP/2.0 100 Trying\r\n"},
+    {200, "OK", "SIP/2.0 200 OK\r\n"},
+    {202, "Accepted", "SIP/2.0 202 Accepted\r\n"},
+    {486, "Busy Here", "SIP/2.0 486 Busy Here\r\n"},
+    {488, "Not Acceptable Here", "SIP/2.0 488 Not Acceptable Here\r\n"},
+    {501, "Not Implemented", "SIP/2.0 501 Not Implemented\r\n"},
+};
+
+constexpr std::string_view kUserAgent = "User-Agent: SIP-RTP-Gateway\r\n";
+constexpr std::string_view kNoBody = "Content-Length: 0\r\n\r\n";
+
+void writeStatusLine(Out &out, int code, std::string_view phrase) {
+  for (const auto &status : kStatusLines) {
+    if (status.code == code && status.phrase == phrase) {
+      out << status.line;
+      return;
+    }
+  }
+  out << "SIP/2.0 " << (uint64_t)code << " " << phrase << "\r\n";
+}
+
+// Everything after the Vias
+void writeRest(Out &out, int code, std::string_view from, std::string_view to,
+               std::string_view callId, std::string_view cseq,
+               std::string_view extraHeaders, std::string_view body) {
+  if (!from.empty())
+    out << "From: " << from << "\r\n";
+  if (!to.empty()) {
+    out << "To: " << to;
+    if (code >= 200 && SipMessage::headerParam(to, "tag").empty()) {
       // Simple tag generation if missing for final response
-      toVal += ";tag=gen" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count() % 1000000);
+      out << ";tag=gen"
+          << (uint64_t)(std::chrono::system_clock::now()
+                            .time_since_epoch()
+                            .count() %
+                        1000000);
     }
-    res.addHeader("To", toVal);
+    out << "\r\n";
   }
-  
-  auto callId = req.getHeader("Call-ID");
-  if (callId)
-    res.addHeader("Call-ID", *callId);
-    
-  auto cseq = req.getHeader("CSeq");
-  if (cseq)
-    res.addHeader("CSeq", *cseq);
-
-  res.addHeader("User-Agent", "SIP-RTP-Gateway");
-  // Note: Content-Length is automatically added by toString() based on body size
-
-  return res;
+  if (!callId.empty())
+    out << "Call-ID: " << callId << "\r\n";
+  if (!cseq.empty())
+    out << "CSeq: " << cseq << "\r\n";
+  out << kUserAgent << extraHeaders;
+  if (body.empty())
+    out << kNoBody;
+  else
+    out << "Content-Length: " << (uint64_t)body.size() << "\r\n\r\n" << body;
+}
+
+} // namespace
+
+size_t SipResponseBuilder::write(char *out, size_t cap, const SipMessage &req,
+                                 int code, std::string_view phrase,
+                                 std::string_view extraHeaders,
+                                 std::string_view body) {
+  Out o(out, cap);
+  writeStatusLine(o, code, phrase);
+  req.forEachHeader(SipHeader::Via,
+                    [&o](std::string_view via) { o << "Via: " << via << "\r\n"; });
+  writeRest(o, code, req.header(SipHeader::From), req.header(SipHeader::To),
+            req.getCallId(), req.header(SipHeader::CSeq), extraHeaders, body);
+  return o.size();
+}
+
+size_t SipResponseBuilder::writeOptionsOk(char *out, size_t cap,
+                                          const char *req, size_t length) {
+  constexpr std::string_view kOptions = "OPTIONS ";
+  if (length < kOptions.size() || memcmp(req, kOptions.data(), kOptions.size()))
+    return 0;
+
+  // Vias are copied as they are met; the rest may come in any order
+  Out o(out, cap);
+  writeStatusLine(o, 200, "OK");
+  bool via = false;
+  std::string_view from, to, callId, cseq;
+  bool ok = SipParser::forEachHeader(
+      req, length,
+      [&](SipHeader id, std::string_view, std::string_view value) {
+        switch (id) {
+        case SipHeader::Via:
+          o << "Via: " << value << "\r\n";
+          via = true;
+          break;
+        case SipHeader::From:
+          if (from.empty())
+            from = value;
+          break;
+        case SipHeader::To:
+          if (to.empty())
+            to = value;
+          break;
+        case SipHeader::CallId:
+          if (callId.empty())
+            callId = value;
+          break;
+        case SipHeader::CSeq:
+          if (cseq.empty())
+            cseq = value;
+          break;
+        default:
+          break;
+        }
+      });
+  if (!ok || !via || from.empty() || to.empty() || callId.empty() ||
+      cseq.empty())
+    return 0;
+  writeRest(o, 200, from, to, callId, cseq, {}, {});
+  return o.size();
 }
@@ -1,9 +1,22 @@
 #pragma once
 
 #include "SipMessage.h"
+#include <string_view>
 
+// Serializes responses straight into a caller's send buffer. Every response
+// follows one template: status line, the request's Via/From/To/Call-ID/CSeq
+// spliced in from the request as they are, then fixed fragments. Each
+// returns the length written, or 0 if the response does not fit in cap.
 class SipResponseBuilder {
 public:
-  static SipMessage createResponse(const SipMessage &req, int code,
-                                   const std::string &phrase);
+  // extraHeaders are complete "Name: value\r\n" lines, usually precomputed
+  static size_t write(char *out, size_t cap, const SipMessage &req, int code,
+                      std::string_view phrase,
+                      std::string_view extraHeaders = {},
+                      std::string_view body = {});
+
+  // 200 OK to an OPTIONS datagram, read without building a SipMessage.
+  // Returns 0 if the datagram is not a plain OPTIONS request.
+  static size_t writeOptionsOk(char *out, size_t cap, const char *req,
+                               size_t length);
 };
@@ -1,23 +1,67 @@
 #include "SipServer.h"
+#include "SipResponseBuilder.h"
 #include "../app/Logger.h"
 #include "../util/Net.h"
+#include <algorithm>
 #include <cstring>
+#include <poll.h>
 #include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
-SipServer::SipServer(int port) : port_(port) {}
+// Datagrams waiting to be handed from the receiving server to the one that
+// owns their Call-ID; more are dropped and left to SIP retransmission. Each
+// cell holds a whole datagram, so this is about 2 MB per shard.
+static const size_t kPostedQueueSize = 256;
 
-SipServer::~SipServer() { Net::closeSocket(socketFd_); }
+#ifdef __linux__
+// epoll tags of the socket and the post() eventfd
+static const uint64_t kSocketEvent = 0;
+static const uint64_t kWakeEvent = 1;
+#endif
+
+SipServer::SipServer(int port, bool reusePort)
+    : port_(port), reusePort_(reusePort) {}
+
+SipServer::~SipServer() {
+  Net::closeSocket(socketFd_);
+  Net::closeSocket(epollFd_);
+  Net::closeSocket(wakeFd_);
+}
 
 bool SipServer::start() {
   socketFd_ = Net::createUdpSocket();
   if (socketFd_ < 0)
     return false;
 
+  if (reusePort_ && !Net::setReusePort(socketFd_))
+    return false;
+
   if (!Net::bindSocket(socketFd_, "0.0.0.0", port_)) {
     return false;
   }
 
   Net::setNonBlocking(socketFd_);
+
+#ifdef __linux__
+  epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epollFd_ < 0 || wakeFd_ < 0) {
+    LOG_ERROR("Failed to create epoll/eventfd for SIP server: "
+              << strerror(errno));
+    return false;
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = kSocketEvent;
+  epoll_ctl(epollFd_, EPOLL_CTL_ADD, socketFd_, &ev);
+  ev.data.u64 = kWakeEvent;
+  epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+#endif
+
   LOG_INFO("SIP Server listening on port " << port_);
   return true;
 }
@@ -26,7 +70,67 @@ void SipServer::setRequestHandler(RequestHandler handler) {
   requestHandler_ = handler;
 }
 
-void SipServer::poll() {
+void SipServer::setRouter(Router router) {
+  router_ = router;
+  if (!posted_)
+    posted_ = std::make_unique<MpscQueue<Datagram>>(kPostedQueueSize);
+}
+
+void SipServer::poll(int timeoutMs) {
+#ifdef __linux__
+  struct epoll_event events[2];
+  int nfds = epoll_wait(epollFd_, events, 2, timeoutMs);
+  for (int i = 0; i < nfds; ++i) {
+    if (events[i].data.u64 == kWakeEvent) {
+      uint64_t value;
+      ssize_t r = read(wakeFd_, &value, sizeof(value));
+      (void)r;
+    }
+  }
+#else
+  // No eventfd here, so posted datagrams wait for the next pass
+  struct pollfd pfd = {socketFd_, POLLIN, 0};
+  ::poll(&pfd, 1, timeoutMs);
+#endif
+  drainPosted();
+  receive();
+}
+
+bool SipServer::post(const char *data, size_t length,
+                     const sockaddr_in &sender) {
+  if (!posted_ || length > kMaxDatagram)
+    return false;
+  bool queued = posted_->pushWith([&](Datagram &datagram) {
+    datagram.length = length;
+    datagram.sender = sender;
+    memcpy(datagram.data, data, length);
+  });
+  if (!queued)
+    return false;
+  // One wakeup per drain is enough
+  if (!wakePending_.exchange(true)) {
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t r = write(wakeFd_, &one, sizeof(one));
+    (void)r;
+#endif
+  }
+  return true;
+}
+
+void SipServer::drainPosted() {
+  if (!posted_)
+    return;
+  wakePending_.store(false);
+  // Handled straight from the queue cell, which is freed afterwards
+  auto handle = [this](Datagram &datagram) {
+    dispatch(datagram.data, datagram.length, datagram.sender, true);
+  };
+  while (posted_->popWith(handle)) {
+  }
+}
+
+void SipServer::receive() {
   while (true) {
     sockaddr_in senderAddr{};
     socklen_t addrLen = sizeof(senderAddr);
@@ -35,21 +139,17 @@ void SipServer::poll() {
                          (struct sockaddr *)&senderAddr, &addrLen);
     if (n > 0) {
       buffer_[n] = '\0';
-      LOG_INFO("Received UDP packet from "
+      // Keepalive OPTIONS are answered before anything else is built
+      if (answerOptions(n, senderAddr))
+        continue;
+
+      LOG_DEBUG("Received UDP packet from "
                 << Net::ipFromSockAddr(senderAddr) << ":"
                 << Net::portFromSockAddr(senderAddr));
-      
-      std::string debugMsg(buffer_, std::min<size_t>(n, 256));
-      LOG_DEBUG("SIP Packet (truncated): " << debugMsg);
-
-      auto msg = SipParser::parse(buffer_, n);
-      if (msg) {
-        if (requestHandler_) {
-          requestHandler_(*msg, senderAddr);
-        }
-      } else {
-        LOG_WARN("Failed to parse SIP message");
-      }
+      LOG_DEBUG("SIP Packet (truncated): "
+                << std::string_view(buffer_, std::min<size_t>(n, 256)));
+
+      dispatch(buffer_, n, senderAddr, false);
     } else if (n < 0) {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
         break; // Normal for non-blocking
@@ -64,22 +164,87 @@ void SipServer::poll() {
   }
 }
 
-void SipServer::sendResponse(const SipMessage &res, const sockaddr_in &dest) {
-  std::string raw = res.toString();
+void SipServer::dispatch(const char *data, size_t length,
+                         const sockaddr_in &sender, bool routed) {
+  if (!routed && router_) {
+    // Route on the Call-ID alone, so a datagram for another shard is only
+    // parsed there. Folded headers are left to the full parse.
+    std::string_view callId;
+    routed = SipParser::forEachHeader(
+        data, length,
+        [&](SipHeader id, std::string_view, std::string_view value) {
+          if (id == SipHeader::CallId && callId.empty())
+            callId = value;
+        });
+    if (routed && handOver(callId, data, length, sender))
+      return;
+  }
+  auto msg = SipParser::parse(data, length);
+  if (!msg) {
+    LOG_WARN("Failed to parse SIP message");
+    return;
+  }
+  if (!routed && router_ && handOver(msg->getCallId(), data, length, sender))
+    return;
+  if (requestHandler_) {
+    requestHandler_(*msg, sender);
+  }
+}
+
+bool SipServer::handOver(std::string_view callId, const char *data,
+                         size_t length, const sockaddr_in &sender) {
+  SipServer *owner = router_(callId);
+  if (!owner || owner == this)
+    return false;
+  if (!owner->post(data, length, sender))
+    LOG_WARN("SIP shard queue full, dropping message for " << callId);
+  return true;
+}
+
+bool SipServer::answerOptions(size_t length, const sockaddr_in &sender) {
+  size_t len = SipResponseBuilder::writeOptionsOk(sendBuffer_,
+                                                  sizeof(sendBuffer_),
+                                                  buffer_, length);
+  if (len == 0)
+    return false;
+  LOG_DEBUG("Answering OPTIONS from " << Net::ipFromSockAddr(sender) << ":"
+                                      << Net::portFromSockAddr(sender));
+  sendRaw({sendBuffer_, len}, sender);
+  return true;
+}
+
+std::string_view SipServer::sendResponse(const SipMessage &req, int code,
+                                         std::string_view phrase,
+                                         const sockaddr_in &dest,
+                                         std::string_view extraHeaders,
+                                         std::string_view body) {
+  size_t len = SipResponseBuilder::write(sendBuffer_, sizeof(sendBuffer_), req,
+                                         code, phrase, extraHeaders, body);
+  if (len == 0) {
+    LOG_ERROR("SIP response " << code << " too large to send");
+    return {};
+  }
+  LOG_INFO("Sending SIP Response to " << Net::ipFromSockAddr(dest) << ":"
+                                       << Net::portFromSockAddr(dest));
+  sendRaw({sendBuffer_, len}, dest);
+  return {sendBuffer_, len};
+}
+
+void SipServer::resendResponse(std::string_view wire, const sockaddr_in &dest) {
   LOG_INFO("Sending SIP Response to " << Net::ipFromSockAddr(dest) << ":"
                                        << Net::portFromSockAddr(dest));
-  std::string debugMsg = raw.substr(0, std::min<size_t>(raw.size(), 256));
-  LOG_DEBUG("SIP Out (truncated): " << debugMsg);
-  sendto(socketFd_, raw.c_str(), raw.size(), 0, (struct sockaddr *)&dest,
-         sizeof(dest));
+  sendRaw(wire, dest);
 }
 
 void SipServer::sendRequest(const SipMessage &req, const sockaddr_in &dest) {
   std::string raw = req.toString();
   LOG_INFO("Sending SIP Request to " << Net::ipFromSockAddr(dest) << ":"
                                       << Net::portFromSockAddr(dest));
-  std::string debugMsg = raw.substr(0, std::min<size_t>(raw.size(), 256));
-  LOG_DEBUG("SIP Out (truncated): " << debugMsg);
-  sendto(socketFd_, raw.c_str(), raw.size(), 0, (struct sockaddr *)&dest,
+  sendRaw(raw, dest);
+}
+
+void SipServer::sendRaw(std::string_view raw, const sockaddr_in &dest) {
+  LOG_DEBUG("SIP Out (truncated): " << raw.substr(0, 256));
+  sendto(socketFd_, raw.data(), raw.size(), 0, (struct sockaddr *)&dest,
          sizeof(dest));
 }
@@ -5,33 +5,86 @@
 #include <memory>
 #include <netinet/in.h>
 #include <string>
+#include <string_view>
 
+#include "../util/MpscQueue.h"
 #include "SipMessage.h"
 #include "SipParser.h"
 #include "SipTransaction.h"
 
+// One SIP socket and the thread that reads it. In sharded mode several
+// servers bind the same port with SO_REUSEPORT, and each message is handled
+// by the server its Call-ID routes to, so a dialog always stays on one
+// thread whichever socket the kernel delivered it to.
 class SipServer {
 public:
   using RequestHandler =
       std::function<void(const SipMessage &, const sockaddr_in &)>;
+  // The server that handles a Call-ID; unset means this one
+  using Router = std::function<SipServer *(std::string_view callId)>;
 
-  SipServer(int port);
+  SipServer(int port, bool reusePort = false);
   ~SipServer();
 
   bool start();
   void setRequestHandler(RequestHandler handler);
-  void poll(); // Called from main loop
+  // Shards the server; call before start(). Only then is there a queue
+  // for datagrams other servers hand over.
+  void setRouter(Router router);
+  // Waits up to timeoutMs for datagrams, then handles everything received
+  // or handed over. Called in a loop by the server's thread.
+  void poll(int timeoutMs = 0);
+  // Hands over a datagram another server received; any thread
+  bool post(const char *data, size_t length, const sockaddr_in &sender);
 
-  void sendResponse(const SipMessage &res, const sockaddr_in &dest);
+  // Serializes the response to req into the send buffer and sends it.
+  // Returns the bytes sent, valid until the next send, or empty if the
+  // response did not fit.
+  std::string_view sendResponse(const SipMessage &req, int code,
+                                std::string_view phrase,
+                                const sockaddr_in &dest,
+                                std::string_view extraHeaders = {},
+                                std::string_view body = {});
+  // Sends a serialized response again (retransmissions)
+  void resendResponse(std::string_view wire, const sockaddr_in &dest);
   void sendRequest(const SipMessage &req, const sockaddr_in &dest);
 
 private:
+  static constexpr size_t kMaxDatagram = 8192;
+
+  // Inline storage, so handing a datagram to another shard fills a queue
+  // cell in place instead of allocating
+  struct Datagram {
+    size_t length = 0;
+    sockaddr_in sender{};
+    char data[kMaxDatagram];
+  };
+
+  void receive();
+  void drainPosted();
+  // Parses and routes a datagram, or handles it if it is ours
+  void dispatch(const char *data, size_t length, const sockaddr_in &sender,
+                bool routed);
+  // Posts the datagram to the server that owns callId. False if that is
+  // this one.
+  bool handOver(std::string_view callId, const char *data, size_t length,
+                const sockaddr_in &sender);
+  // Answers OPTIONS keepalives straight from the datagram, without
+  // parsing it or involving the request handler
+  bool answerOptions(size_t length, const sockaddr_in &sender);
+  void sendRaw(std::string_view raw, const sockaddr_in &dest);
+
   int port_;
+  bool reusePort_;
   int socketFd_ = -1;
+  int epollFd_ = -1; // Linux only
+  int wakeFd_ = -1;  // eventfd for post(), Linux only
   RequestHandler requestHandler_;
+  Router router_;
 
-  // Simple transaction cache could go here or in CallRegistry
-  // For this design, server just dispaches.
+  std::unique_ptr<MpscQueue<Datagram>> posted_; // with the router
+  std::atomic<bool> wakePending_{false};
 
-  char buffer_[8192];
+  char buffer_[kMaxDatagram];
+  char sendBuffer_[8192];
 };
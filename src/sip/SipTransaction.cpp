@@ -3,37 +3,35 @@
 SipTransaction::SipTransaction(const SipMessage &req)
     : state_(TransactionState::TRYING) {
   branch_ = req.getBranch();
-  method_ = req.methodStr;
-  lastActive_ = std::chrono::steady_clock::now();
+  method_ = req.methodStr();
 }
 
 bool SipTransaction::isInviteTransaction() const { return method_ == "INVITE"; }
 
-void SipTransaction::sendResponse(const SipMessage &res) {
-  lastActive_ = std::chrono::steady_clock::now();
-  lastResponse_ = std::make_shared<SipMessage>(res);
+void SipTransaction::sendResponse(int statusCode, std::string_view wire) {
+  lastResponse_.assign(wire);
 
   if (isInviteTransaction()) {
     if (state_ == TransactionState::TRYING ||
         state_ == TransactionState::PROCEEDING) {
-      if (res.statusCode >= 100 && res.statusCode < 200) {
+      if (statusCode >= 100 && statusCode < 200) {
         state_ = TransactionState::PROCEEDING;
-      } else if (res.statusCode >= 200 && res.statusCode < 300) {
+      } else if (statusCode >= 200 && statusCode < 300) {
         // 2xx for INVITE terminates server transaction immediately in RFC,
         // but we keep it around just to handle retransmissions if needed,
         // though usually 2xx retransmits are handled by UAC.
         // Strictly speaking transaction is done.
         state_ = TransactionState::TERMINATED;
-      } else if (res.statusCode >= 300 && res.statusCode <= 699) {
+      } else if (statusCode >= 300 && statusCode <= 699) {
         state_ = TransactionState::COMPLETED;
       }
     }
   } else {
     // Non-INVITE
     if (state_ == TransactionState::TRYING || state_ == TransactionState::PROCEEDING) {
-      if (res.statusCode >= 200 && res.statusCode <= 699) {
+      if (statusCode >= 200 && statusCode <= 699) {
         state_ = TransactionState::COMPLETED;
-      } else if (res.statusCode >= 100 && res.statusCode < 200) {
+      } else if (statusCode >= 100 && statusCode < 200) {
         state_ = TransactionState::PROCEEDING;
       }
     }
@@ -41,7 +39,6 @@ void SipTransaction::sendResponse(const SipMessage &res) {
 }
 
 void SipTransaction::receiveRequest(const SipMessage &msg) {
-  lastActive_ = std::chrono::steady_clock::now();
   if (isInviteTransaction()) {
     if (msg.method == SipMethod::ACK && (state_ == TransactionState::COMPLETED || state_ == TransactionState::CONFIRMED)) {
       state_ = TransactionState::CONFIRMED;
@@ -50,7 +47,6 @@ void SipTransaction::receiveRequest(const SipMessage &msg) {
 }
 
 void SipTransaction::receiveResponse(const SipMessage &msg) {
-  lastActive_ = std::chrono::steady_clock::now();
   if (!isInviteTransaction()) {
     if (msg.statusCode >= 200 && msg.statusCode <= 699) {
       state_ = TransactionState::COMPLETED;
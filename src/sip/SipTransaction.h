@@ -1,9 +1,8 @@
 #pragma once
 
 #include "SipMessage.h"
-#include <chrono>
-#include <memory>
 #include <string>
+#include <string_view>
 
 enum class TransactionState {
   TRYING,
@@ -24,21 +23,19 @@ public:
   // Updates state based on event (sending response, receiving ACK/Response)
   void receiveRequest(const SipMessage &msg);
   void receiveResponse(const SipMessage &msg);
-  void sendResponse(const SipMessage &msg);
+  // wire is the response as sent, kept for retransmissions
+  void sendResponse(int statusCode, std::string_view wire);
   bool shouldResendResponse(const SipMessage &msg) const;
+  bool isInviteTransaction() const;
 
   // Retransmission storage
-  std::shared_ptr<SipMessage> getLastResponse() const { return lastResponse_; }
-  std::chrono::steady_clock::time_point getLastActive() const { return lastActive_; }
+  // Empty until a response was sent
+  const std::string &getLastResponse() const { return lastResponse_; }
 
 private:
   std::string branch_;
   std::string method_; // INVITE, BYE, etc.
   TransactionState state_;
 
-  // Helper to identify transaction type
-  bool isInviteTransaction() const;
-
-  std::shared_ptr<SipMessage> lastResponse_;
-  std::chrono::steady_clock::time_point lastActive_;
+  std::string lastResponse_;
 };
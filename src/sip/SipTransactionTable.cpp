@@ -0,0 +1,240 @@
+#include "SipTransactionTable.h"
+#include "../app/Logger.h"
+#include <algorithm>
+
+// RFC 3261 timer values for UDP, in milliseconds
+static const uint32_t kT1 = 500;
+static const uint32_t kT2 = 4000;
+static const uint32_t kT4 = 5000;
+
+static const uint32_t kTickMs = 10;
+static const size_t kInitialSlots = 1024;
+
+static const uint64_t kFnvOffset = 0xcbf29ce484222325ULL;
+static const uint64_t kFnvPrime = 0x100000001b3ULL;
+
+// FNV-1a, with a separator so adjacent fields cannot run into each other
+static uint64_t hashField(uint64_t h, std::string_view s) {
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= kFnvPrime;
+  }
+  return (h ^ 0xff) * kFnvPrime;
+}
+
+static std::string_view trimView(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    s.remove_suffix(1);
+  return s;
+}
+
+// host[:port] of "SIP/2.0/UDP host:port;branch=..."
+static std::string_view viaSentBy(std::string_view via) {
+  auto space = via.find_first_of(" \t");
+  if (space == std::string_view::npos)
+    return {};
+  auto sentBy = via.substr(space);
+  return trimView(sentBy.substr(0, sentBy.find_first_of(";,")));
+}
+
+SipTransactionTable::SipTransactionTable(Clock clock)
+    : slots_(kInitialSlots), clock_(clock), start_(clock()) {}
+
+void SipTransactionTable::setRetransmit(Retransmit retransmit) {
+  retransmit_ = retransmit;
+}
+
+uint64_t SipTransactionTable::keyFor(const SipMessage &msg) {
+  std::string_view method;
+  if (msg.isRequest) {
+    method = msg.method == SipMethod::ACK ? "INVITE" : msg.methodStr();
+  } else {
+    auto cseq = msg.header(SipHeader::CSeq);
+    auto space = cseq.find_first_of(" \t");
+    if (space != std::string_view::npos)
+      method = trimView(cseq.substr(space));
+  }
+
+  std::string_view branch = msg.getBranch();
+  uint64_t h = hashField(kFnvOffset, branch);
+  h = hashField(h, viaSentBy(msg.header(SipHeader::Via)));
+  h = hashField(h, method);
+  if (branch.compare(0, 7, "z9hG4bK") != 0) {
+    // RFC 2543 peers: the branch alone is not unique
+    h = hashField(h, msg.getCallId());
+    h = hashField(h, std::to_string(msg.getCSeq()));
+  }
+  return h ? h : 1;
+}
+
+size_t SipTransactionTable::indexOf(uint64_t key) const {
+  size_t mask = slots_.size() - 1;
+  for (size_t i = key & mask;; i = (i + 1) & mask) {
+    if (slots_[i].key == key)
+      return i;
+    if (slots_[i].key == 0)
+      return slots_.size();
+  }
+}
+
+SipTransaction *SipTransactionTable::find(uint64_t key) {
+  size_t i = indexOf(key);
+  return i < slots_.size() ? slots_[i].transaction.get() : nullptr;
+}
+
+SipTransaction &SipTransactionTable::insert(uint64_t key,
+                                            const SipMessage &req) {
+  size_t i = indexOf(key);
+  if (i == slots_.size()) {
+    if ((size_ + 1) * 2 > slots_.size())
+      grow();
+    size_t mask = slots_.size() - 1;
+    i = key & mask;
+    while (slots_[i].key != 0)
+      i = (i + 1) & mask;
+    slots_[i].key = key;
+    size_++;
+  } else {
+    cancelTimers(slots_[i]);
+  }
+  Slot &slot = slots_[i];
+  slot.transaction = std::make_unique<SipTransaction>(req);
+  expireAfter(slot, 64 * kT1);
+  return *slot.transaction;
+}
+
+void SipTransactionTable::erase(uint64_t key) {
+  size_t i = indexOf(key);
+  if (i == slots_.size())
+    return;
+  cancelTimers(slots_[i]);
+
+  // Backward shift: pull later entries of the probe run into the hole
+  // unless that would move them before their home slot
+  size_t mask = slots_.size() - 1;
+  for (size_t j = (i + 1) & mask; slots_[j].key != 0; j = (j + 1) & mask) {
+    size_t home = slots_[j].key & mask;
+    bool between = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+    if (!between) {
+      slots_[i] = std::move(slots_[j]);
+      i = j;
+    }
+  }
+  slots_[i] = Slot();
+  size_--;
+}
+
+void SipTransactionTable::grow() {
+  std::vector<Slot> old(slots_.size() * 2);
+  old.swap(slots_);
+  size_t mask = slots_.size() - 1;
+  for (auto &slot : old) {
+    if (slot.key == 0)
+      continue;
+    size_t i = slot.key & mask;
+    while (slots_[i].key != 0)
+      i = (i + 1) & mask;
+    slots_[i] = std::move(slot);
+  }
+}
+
+void SipTransactionTable::responseSent(uint64_t key, int statusCode,
+                                       std::string_view wire,
+                                       const sockaddr_in &dest) {
+  size_t i = indexOf(key);
+  if (i == slots_.size())
+    return;
+  Slot &slot = slots_[i];
+  slot.transaction->sendResponse(statusCode, wire);
+  slot.peer = dest;
+  if (statusCode < 200)
+    return;
+
+  // H, L and J all run 64*T1
+  expireAfter(slot, 64 * kT1);
+  if (slot.transaction->isInviteTransaction() && statusCode >= 300) {
+    slot.retransmitMs = kT1;
+    retransmitAfter(slot, kT1);
+  }
+}
+
+void SipTransactionTable::requestReceived(uint64_t key,
+                                          const SipMessage &req) {
+  size_t i = indexOf(key);
+  if (i == slots_.size())
+    return;
+  Slot &slot = slots_[i];
+  auto before = slot.transaction->getState();
+  slot.transaction->receiveRequest(req);
+  if (before == TransactionState::COMPLETED &&
+      slot.transaction->getState() == TransactionState::CONFIRMED) {
+    // ACKed: stop G, and I replaces H
+    wheel_.cancel(slot.retransmit);
+    slot.retransmit = 0;
+    expireAfter(slot, kT4);
+  }
+}
+
+void SipTransactionTable::responseReceived(uint64_t key,
+                                           const SipMessage &res) {
+  size_t i = indexOf(key);
+  if (i == slots_.size())
+    return;
+  Slot &slot = slots_[i];
+  slot.transaction->receiveResponse(res);
+  if (res.statusCode >= 200)
+    expireAfter(slot, kT4); // Timer K
+}
+
+void SipTransactionTable::advance(std::chrono::steady_clock::time_point now) {
+  auto elapsed =
+      std::chrono::duration_cast<std::chrono::milliseconds>(now - start_);
+  wheel_.advanceTo((uint64_t)elapsed.count() / kTickMs);
+}
+
+uint64_t SipTransactionTable::tickAfter(uint32_t ms) const {
+  auto elapsed =
+      std::chrono::duration_cast<std::chrono::milliseconds>(clock_() - start_);
+  return ((uint64_t)elapsed.count() + ms + kTickMs - 1) / kTickMs;
+}
+
+void SipTransactionTable::expireAfter(Slot &slot, uint32_t ms) {
+  wheel_.cancel(slot.expiry);
+  uint64_t key = slot.key;
+  slot.expiry = wheel_.scheduleAt(tickAfter(ms), [this, key] {
+    LOG_DEBUG("Transaction " << std::hex << key << std::dec << " expired");
+    erase(key);
+  });
+}
+
+void SipTransactionTable::retransmitAfter(Slot &slot, uint32_t ms) {
+  uint64_t key = slot.key;
+  slot.retransmit = wheel_.scheduleAt(tickAfter(ms),
+                                      [this, key] { onRetransmit(key); });
+}
+
+void SipTransactionTable::cancelTimers(Slot &slot) {
+  wheel_.cancel(slot.expiry);
+  wheel_.cancel(slot.retransmit);
+  slot.expiry = slot.retransmit = 0;
+}
+
+void SipTransactionTable::onRetransmit(uint64_t key) {
+  size_t i = indexOf(key);
+  if (i == slots_.size())
+    return;
+  Slot &slot = slots_[i];
+  slot.retransmit = 0;
+  const auto &response = slot.transaction->getLastResponse();
+  if (slot.transaction->getState() != TransactionState::COMPLETED ||
+      response.empty())
+    return;
+  LOG_DEBUG("Retransmitting response for transaction "
+            << std::hex << key << std::dec << " (Timer G)");
+  if (retransmit_)
+    retransmit_(response, slot.peer);
+  slot.retransmitMs = std::min(slot.retransmitMs * 2, kT2);
+  retransmitAfter(slot, slot.retransmitMs);
+}
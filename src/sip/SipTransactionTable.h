@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../util/TimerWheel.h"
+#include "SipMessage.h"
+#include "SipTransaction.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One SIP thread's transactions (see GatewayApp::SipShard), so no locking.
+// Open addressing with linear probing over a 64-bit key hashed once per
+// message. Entries leave through the RFC 3261 timers on a TimerWheel
+// rather than by scanning the table:
+//   INVITE server: G retransmits a 3xx-6xx until ACK, H (64*T1) gives up
+//   waiting for it, I (T4) absorbs ACKs after one arrived. After a 2xx the
+//   entry stays 64*T1 (RFC 6026 Timer L) so INVITE retransmissions are not
+//   taken for new calls.
+//   Non-INVITE server: J (64*T1) after the final response.
+//   Client: K (T4) after a final response to our own request.
+// A transaction that never gets a final response goes after 64*T1.
+class SipTransactionTable {
+public:
+  using Retransmit =
+      std::function<void(const std::string &wire, const sockaddr_in &dest)>;
+  // Where timers are armed from; tests pass a clock they step themselves
+  using Clock = std::chrono::steady_clock::time_point (*)();
+
+  explicit SipTransactionTable(Clock clock = std::chrono::steady_clock::now);
+
+  // Sends responses again for Timer G
+  void setRetransmit(Retransmit retransmit);
+
+  // RFC 3261 17.2.3 matching: top Via branch and sent-by, and the method
+  // (of the CSeq for responses; ACK matches its INVITE). Requests without
+  // an RFC 3261 branch also hash Call-ID and CSeq. Never 0.
+  static uint64_t keyFor(const SipMessage &msg);
+
+  SipTransaction *find(uint64_t key);
+  // A new transaction for req, replacing any with the same key
+  SipTransaction &insert(uint64_t key, const SipMessage &req);
+
+  // Transaction events; each passes them on to the SipTransaction and
+  // arms the timers of the state it ends up in. Unknown keys are ignored.
+  void responseSent(uint64_t key, int statusCode, std::string_view wire,
+                    const sockaddr_in &dest);
+  void requestReceived(uint64_t key, const SipMessage &req);
+  void responseReceived(uint64_t key, const SipMessage &res);
+
+  // Runs the timers due by now
+  void advance(std::chrono::steady_clock::time_point now);
+
+  size_t size() const { return size_; }
+
+private:
+  struct Slot {
+    uint64_t key = 0; // 0 when empty
+    std::unique_ptr<SipTransaction> transaction;
+    TimerWheel::TimerId expiry = 0;
+    TimerWheel::TimerId retransmit = 0; // Timer G
+    uint32_t retransmitMs = 0;
+    sockaddr_in peer{};
+  };
+
+  size_t indexOf(uint64_t key) const; // slot holding key, or capacity
+  void erase(uint64_t key);
+  void grow();
+
+  uint64_t tickAfter(uint32_t ms) const;
+  void expireAfter(Slot &slot, uint32_t ms);
+  void retransmitAfter(Slot &slot, uint32_t ms);
+  void cancelTimers(Slot &slot);
+  void onRetransmit(uint64_t key);
+
+  std::vector<Slot> slots_; // power of two, at most half full
+  size_t size_ = 0;
+
+  TimerWheel wheel_;
+  Clock clock_;
+  std::chrono::steady_clock::time_point start_;
+  Retransmit retransmit_;
+};
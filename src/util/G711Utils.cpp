@@ -0,0 +1,840 @@
+#include "G711Utils.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define G711_HAVE_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define G711_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Scalar reference
+// ---------------------------------------------------------------------------
+
+void decodeULawScalar(const uint8_t *in, int16_t *out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::ulawToLinear(in[i]);
+}
+
+void decodeALawScalar(const uint8_t *in, int16_t *out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::alawToLinear(in[i]);
+}
+
+void encodeULawScalar(const int16_t *in, uint8_t *out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::linearToULaw(in[i]);
+}
+
+void encodeALawScalar(const int16_t *in, uint8_t *out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::linearToALaw(in[i]);
+}
+
+void decodeULawGainScalar(const uint8_t *in, int16_t *out, size_t n,
+                          int gainQ8) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::applyGain(G711Utils::ulawToLinear(in[i]), gainQ8);
+}
+
+void decodeALawGainScalar(const uint8_t *in, int16_t *out, size_t n,
+                          int gainQ8) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::applyGain(G711Utils::alawToLinear(in[i]), gainQ8);
+}
+
+void encodeULawGainScalar(const int16_t *in, uint8_t *out, size_t n,
+                          int gainQ8) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::linearToULaw(G711Utils::applyGain(in[i], gainQ8));
+}
+
+void encodeALawGainScalar(const int16_t *in, uint8_t *out, size_t n,
+                          int gainQ8) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::linearToALaw(G711Utils::applyGain(in[i], gainQ8));
+}
+
+// ---------------------------------------------------------------------------
+// Lookup tables
+// ---------------------------------------------------------------------------
+
+// Both encoders depend only on the sign and on |x| / 4, so the encode tables
+// hold 2 x 8192 entries indexed by (sign << 13) | (|x| >> 2). -32768 has no
+// 13-bit magnitude and is looked up separately.
+struct Tables {
+  int16_t ulawDecode[256];
+  int16_t alawDecode[256];
+  uint8_t ulawEncode[1 << 14];
+  uint8_t alawEncode[1 << 14];
+  uint8_t ulawMin;
+  uint8_t alawMin;
+
+  Tables() {
+    for (int i = 0; i < 256; ++i) {
+      ulawDecode[i] = G711Utils::ulawToLinear((uint8_t)i);
+      alawDecode[i] = G711Utils::alawToLinear((uint8_t)i);
+    }
+    for (int k = 0; k < (1 << 13); ++k) {
+      int16_t pos = (int16_t)(k << 2);
+      int16_t neg = (int16_t)-((k << 2) + 3);
+      ulawEncode[k] = G711Utils::linearToULaw(pos);
+      alawEncode[k] = G711Utils::linearToALaw(pos);
+      ulawEncode[(1 << 13) | k] = G711Utils::linearToULaw(neg);
+      alawEncode[(1 << 13) | k] = G711Utils::linearToALaw(neg);
+    }
+    ulawMin = G711Utils::linearToULaw(-32768);
+    alawMin = G711Utils::linearToALaw(-32768);
+  }
+};
+
+const Tables &tables() {
+  static const Tables t;
+  return t;
+}
+
+inline uint8_t encodeLut(const uint8_t *table, uint8_t minCode, int16_t x) {
+  if (x == -32768)
+    return minCode;
+  int sign = x < 0;
+  int mag = sign ? -x : x;
+  return table[(sign << 13) | (mag >> 2)];
+}
+
+void decodeULawLut(const uint8_t *in, int16_t *out, size_t n) {
+  const int16_t *table = tables().ulawDecode;
+  for (size_t i = 0; i < n; ++i)
+    out[i] = table[in[i]];
+}
+
+void decodeALawLut(const uint8_t *in, int16_t *out, size_t n) {
+  const int16_t *table = tables().alawDecode;
+  for (size_t i = 0; i < n; ++i)
+    out[i] = table[in[i]];
+}
+
+void encodeULawLut(const int16_t *in, uint8_t *out, size_t n) {
+  const Tables &t = tables();
+  for (size_t i = 0; i < n; ++i)
+    out[i] = encodeLut(t.ulawEncode, t.ulawMin, in[i]);
+}
+
+void encodeALawLut(const int16_t *in, uint8_t *out, size_t n) {
+  const Tables &t = tables();
+  for (size_t i = 0; i < n; ++i)
+    out[i] = encodeLut(t.alawEncode, t.alawMin, in[i]);
+}
+
+void decodeULawGainLut(const uint8_t *in, int16_t *out, size_t n, int gainQ8) {
+  const int16_t *table = tables().ulawDecode;
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::applyGain(table[in[i]], gainQ8);
+}
+
+void decodeALawGainLut(const uint8_t *in, int16_t *out, size_t n, int gainQ8) {
+  const int16_t *table = tables().alawDecode;
+  for (size_t i = 0; i < n; ++i)
+    out[i] = G711Utils::applyGain(table[in[i]], gainQ8);
+}
+
+void encodeULawGainLut(const int16_t *in, uint8_t *out, size_t n, int gainQ8) {
+  const Tables &t = tables();
+  for (size_t i = 0; i < n; ++i)
+    out[i] = encodeLut(t.ulawEncode, t.ulawMin,
+                       G711Utils::applyGain(in[i], gainQ8));
+}
+
+void encodeALawGainLut(const int16_t *in, uint8_t *out, size_t n, int gainQ8) {
+  const Tables &t = tables();
+  for (size_t i = 0; i < n; ++i)
+    out[i] = encodeLut(t.alawEncode, t.alawMin,
+                       G711Utils::applyGain(in[i], gainQ8));
+}
+
+// ---------------------------------------------------------------------------
+// x86 vector kernels
+//
+// Samples are widened to 16-bit lanes. The segment is the count of segment
+// thresholds a lane exceeds; per-lane shifts by a segment-dependent amount
+// are multiplies (or multiply-high for right shifts) by a power of two
+// picked with pshufb. abs/min on 0x8000 leave it negative, so -32768 falls
+// into segment 0 exactly like the scalar code. Tails go through the LUT.
+// ---------------------------------------------------------------------------
+
+#ifdef G711_HAVE_X86
+
+// Little-endian 16-bit powers of two, indexed by segment
+#define G711_POW16(a, b, c, d, e, f, g, h)                                     \
+  _mm_setr_epi8((char)((a) & 0xFF), (char)((a) >> 8), (char)((b) & 0xFF),      \
+                (char)((b) >> 8), (char)((c) & 0xFF), (char)((c) >> 8),        \
+                (char)((d) & 0xFF), (char)((d) >> 8), (char)((e) & 0xFF),      \
+                (char)((e) >> 8), (char)((f) & 0xFF), (char)((f) >> 8),        \
+                (char)((g) & 0xFF), (char)((g) >> 8), (char)((h) & 0xFF),      \
+                (char)((h) >> 8))
+
+// 2^(13-seg): v >> (seg + 3) == mulhi(v, 2^(13-seg))
+#define G711_ULAW_ENC_MUL G711_POW16(8192, 4096, 2048, 1024, 512, 256, 128, 64)
+// 2^(16-max(seg+3, 4))
+#define G711_ALAW_ENC_MUL G711_POW16(4096, 4096, 2048, 1024, 512, 256, 128, 64)
+// 2^exp, and for A-law 2^max(seg-1, 0)
+#define G711_ULAW_DEC_MUL G711_POW16(1, 2, 4, 8, 16, 32, 64, 128)
+#define G711_ALAW_DEC_MUL G711_POW16(1, 1, 2, 4, 8, 16, 32, 64)
+
+__attribute__((target("sse4.1"))) inline __m128i
+segment128(__m128i v) {
+  __m128i seg = _mm_setzero_si128();
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(v, _mm_set1_epi16(0xFF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(v, _mm_set1_epi16(0x1FF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(v, _mm_set1_epi16(0x3FF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(v, _mm_set1_epi16(0x7FF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(v, _mm_set1_epi16(0xFFF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(v, _mm_set1_epi16(0x1FFF)));
+  seg = _mm_sub_epi16(seg, _mm_cmpgt_epi16(v, _mm_set1_epi16(0x3FFF)));
+  return seg;
+}
+
+// 16-bit table lookup for lane values 0..7
+__attribute__((target("sse4.1"))) inline __m128i
+lookup128(__m128i table, __m128i idx) {
+  __m128i bytes = _mm_add_epi16(_mm_mullo_epi16(idx, _mm_set1_epi16(0x0202)),
+                                _mm_set1_epi16(0x0100));
+  return _mm_shuffle_epi8(table, bytes);
+}
+
+// 8 code bytes (zero-extended to 16-bit lanes) to linear
+__attribute__((target("sse4.1"))) inline __m128i
+ulawDecode128(__m128i u) {
+  u = _mm_xor_si128(u, _mm_set1_epi16(0xFF));
+  __m128i mant = _mm_add_epi16(
+      _mm_slli_epi16(_mm_and_si128(u, _mm_set1_epi16(0x0F)), 3),
+      _mm_set1_epi16(0x84));
+  __m128i exp = _mm_and_si128(_mm_srli_epi16(u, 4), _mm_set1_epi16(7));
+  __m128i t = _mm_mullo_epi16(mant, lookup128(G711_ULAW_DEC_MUL, exp));
+  __m128i r = _mm_sub_epi16(t, _mm_set1_epi16(0x84));
+  __m128i neg = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16(0x80)),
+                                _mm_set1_epi16(0x80));
+  return _mm_sub_epi16(_mm_xor_si128(r, neg), neg);
+}
+
+__attribute__((target("sse4.1"))) inline __m128i
+alawDecode128(__m128i a) {
+  a = _mm_xor_si128(a, _mm_set1_epi16(0x55));
+  __m128i t = _mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0x0F)), 4);
+  __m128i seg = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi16(7));
+  __m128i seg0 = _mm_cmpeq_epi16(seg, _mm_setzero_si128());
+  __m128i base = _mm_blendv_epi8(_mm_add_epi16(t, _mm_set1_epi16(0x108)),
+                                 _mm_add_epi16(t, _mm_set1_epi16(8)), seg0);
+  __m128i r = _mm_mullo_epi16(base, lookup128(G711_ALAW_DEC_MUL, seg));
+  __m128i neg = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x80)),
+                                _mm_setzero_si128());
+  return _mm_sub_epi16(_mm_xor_si128(r, neg), neg);
+}
+
+// 8 linear samples to codes in 16-bit lanes
+__attribute__((target("sse4.1"))) inline __m128i
+ulawEncode128(__m128i x) {
+  __m128i neg = _mm_srai_epi16(x, 15);
+  __m128i v = _mm_add_epi16(
+      _mm_min_epi16(_mm_abs_epi16(x), _mm_set1_epi16(32635)),
+      _mm_set1_epi16(0x84));
+  __m128i seg = segment128(v);
+  __m128i mant =
+      _mm_and_si128(_mm_mulhi_epu16(v, lookup128(G711_ULAW_ENC_MUL, seg)),
+                    _mm_set1_epi16(0x0F));
+  __m128i code = _mm_or_si128(_mm_slli_epi16(seg, 4), mant);
+  __m128i mask = _mm_xor_si128(_mm_set1_epi16(0xFF),
+                               _mm_and_si128(neg, _mm_set1_epi16(0x80)));
+  return _mm_xor_si128(code, mask);
+}
+
+__attribute__((target("sse4.1"))) inline __m128i
+alawEncode128(__m128i x) {
+  __m128i neg = _mm_srai_epi16(x, 15);
+  __m128i v = _mm_abs_epi16(x);
+  __m128i seg = segment128(v);
+  __m128i mant =
+      _mm_and_si128(_mm_mulhi_epu16(v, lookup128(G711_ALAW_ENC_MUL, seg)),
+                    _mm_set1_epi16(0x0F));
+  __m128i code = _mm_or_si128(_mm_slli_epi16(seg, 4), mant);
+  __m128i mask = _mm_xor_si128(_mm_set1_epi16(0xD5),
+                               _mm_and_si128(neg, _mm_set1_epi16(0x80)));
+  return _mm_xor_si128(code, mask);
+}
+
+// (x * gain) >> 8 with saturation: full 32-bit products, then packs
+__attribute__((target("sse4.1"))) inline __m128i gain128(__m128i x,
+                                                         __m128i gain) {
+  __m128i lo = _mm_mullo_epi16(x, gain);
+  __m128i hi = _mm_mulhi_epi16(x, gain);
+  __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 8);
+  __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 8);
+  return _mm_packs_epi32(p0, p1);
+}
+
+__attribute__((target("sse4.1"))) inline __m128i load8(const uint8_t *in) {
+  return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)in));
+}
+
+__attribute__((target("sse4.1"))) inline void store8(uint8_t *out,
+                                                     __m128i code) {
+  _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(code, code));
+}
+
+__attribute__((target("sse4.1"))) void
+decodeULawSse41(const uint8_t *in, int16_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128((__m128i *)(out + i), ulawDecode128(load8(in + i)));
+  decodeULawLut(in + i, out + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+decodeALawSse41(const uint8_t *in, int16_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128((__m128i *)(out + i), alawDecode128(load8(in + i)));
+  decodeALawLut(in + i, out + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+encodeULawSse41(const int16_t *in, uint8_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    store8(out + i,
+           ulawEncode128(_mm_loadu_si128((const __m128i *)(in + i))));
+  encodeULawLut(in + i, out + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+encodeALawSse41(const int16_t *in, uint8_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    store8(out + i,
+           alawEncode128(_mm_loadu_si128((const __m128i *)(in + i))));
+  encodeALawLut(in + i, out + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+decodeULawGainSse41(const uint8_t *in, int16_t *out, size_t n, int gainQ8) {
+  const __m128i gain = _mm_set1_epi16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128((__m128i *)(out + i),
+                     gain128(ulawDecode128(load8(in + i)), gain));
+  decodeULawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+__attribute__((target("sse4.1"))) void
+decodeALawGainSse41(const uint8_t *in, int16_t *out, size_t n, int gainQ8) {
+  const __m128i gain = _mm_set1_epi16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128((__m128i *)(out + i),
+                     gain128(alawDecode128(load8(in + i)), gain));
+  decodeALawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+__attribute__((target("sse4.1"))) void
+encodeULawGainSse41(const int16_t *in, uint8_t *out, size_t n, int gainQ8) {
+  const __m128i gain = _mm_set1_epi16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+    store8(out + i, ulawEncode128(gain128(x, gain)));
+  }
+  encodeULawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+__attribute__((target("sse4.1"))) void
+encodeALawGainSse41(const int16_t *in, uint8_t *out, size_t n, int gainQ8) {
+  const __m128i gain = _mm_set1_epi16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+    store8(out + i, alawEncode128(gain128(x, gain)));
+  }
+  encodeALawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+// AVX2: the same steps on 16 lanes. pshufb, unpack and pack all work per
+// 128-bit half, so tables are broadcast to both halves and the final byte
+// pack needs a cross-lane permute.
+
+__attribute__((target("avx2"))) inline __m256i segment256(__m256i v) {
+  __m256i seg = _mm256_setzero_si256();
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(v, _mm256_set1_epi16(0xFF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(v, _mm256_set1_epi16(0x1FF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(v, _mm256_set1_epi16(0x3FF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(v, _mm256_set1_epi16(0x7FF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(v, _mm256_set1_epi16(0xFFF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(v, _mm256_set1_epi16(0x1FFF)));
+  seg = _mm256_sub_epi16(seg, _mm256_cmpgt_epi16(v, _mm256_set1_epi16(0x3FFF)));
+  return seg;
+}
+
+__attribute__((target("avx2"))) inline __m256i lookup256(__m128i table,
+                                                         __m256i idx) {
+  __m256i bytes =
+      _mm256_add_epi16(_mm256_mullo_epi16(idx, _mm256_set1_epi16(0x0202)),
+                       _mm256_set1_epi16(0x0100));
+  return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(table), bytes);
+}
+
+__attribute__((target("avx2"))) inline __m256i ulawDecode256(__m256i u) {
+  u = _mm256_xor_si256(u, _mm256_set1_epi16(0xFF));
+  __m256i mant = _mm256_add_epi16(
+      _mm256_slli_epi16(_mm256_and_si256(u, _mm256_set1_epi16(0x0F)), 3),
+      _mm256_set1_epi16(0x84));
+  __m256i exp = _mm256_and_si256(_mm256_srli_epi16(u, 4), _mm256_set1_epi16(7));
+  __m256i t = _mm256_mullo_epi16(mant, lookup256(G711_ULAW_DEC_MUL, exp));
+  __m256i r = _mm256_sub_epi16(t, _mm256_set1_epi16(0x84));
+  __m256i neg = _mm256_cmpeq_epi16(_mm256_and_si256(u, _mm256_set1_epi16(0x80)),
+                                   _mm256_set1_epi16(0x80));
+  return _mm256_sub_epi16(_mm256_xor_si256(r, neg), neg);
+}
+
+__attribute__((target("avx2"))) inline __m256i alawDecode256(__m256i a) {
+  a = _mm256_xor_si256(a, _mm256_set1_epi16(0x55));
+  __m256i t =
+      _mm256_slli_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x0F)), 4);
+  __m256i seg = _mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi16(7));
+  __m256i seg0 = _mm256_cmpeq_epi16(seg, _mm256_setzero_si256());
+  __m256i base =
+      _mm256_blendv_epi8(_mm256_add_epi16(t, _mm256_set1_epi16(0x108)),
+                         _mm256_add_epi16(t, _mm256_set1_epi16(8)), seg0);
+  __m256i r = _mm256_mullo_epi16(base, lookup256(G711_ALAW_DEC_MUL, seg));
+  __m256i neg = _mm256_cmpeq_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x80)),
+                                   _mm256_setzero_si256());
+  return _mm256_sub_epi16(_mm256_xor_si256(r, neg), neg);
+}
+
+__attribute__((target("avx2"))) inline __m256i ulawEncode256(__m256i x) {
+  __m256i neg = _mm256_srai_epi16(x, 15);
+  __m256i v = _mm256_add_epi16(
+      _mm256_min_epi16(_mm256_abs_epi16(x), _mm256_set1_epi16(32635)),
+      _mm256_set1_epi16(0x84));
+  __m256i seg = segment256(v);
+  __m256i mant =
+      _mm256_and_si256(_mm256_mulhi_epu16(v, lookup256(G711_ULAW_ENC_MUL, seg)),
+                       _mm256_set1_epi16(0x0F));
+  __m256i code = _mm256_or_si256(_mm256_slli_epi16(seg, 4), mant);
+  __m256i mask = _mm256_xor_si256(
+      _mm256_set1_epi16(0xFF), _mm256_and_si256(neg, _mm256_set1_epi16(0x80)));
+  return _mm256_xor_si256(code, mask);
+}
+
+__attribute__((target("avx2"))) inline __m256i alawEncode256(__m256i x) {
+  __m256i neg = _mm256_srai_epi16(x, 15);
+  __m256i v = _mm256_abs_epi16(x);
+  __m256i seg = segment256(v);
+  __m256i mant =
+      _mm256_and_si256(_mm256_mulhi_epu16(v, lookup256(G711_ALAW_ENC_MUL, seg)),
+                       _mm256_set1_epi16(0x0F));
+  __m256i code = _mm256_or_si256(_mm256_slli_epi16(seg, 4), mant);
+  __m256i mask = _mm256_xor_si256(
+      _mm256_set1_epi16(0xD5), _mm256_and_si256(neg, _mm256_set1_epi16(0x80)));
+  return _mm256_xor_si256(code, mask);
+}
+
+__attribute__((target("avx2"))) inline __m256i gain256(__m256i x,
+                                                       __m256i gain) {
+  __m256i lo = _mm256_mullo_epi16(x, gain);
+  __m256i hi = _mm256_mulhi_epi16(x, gain);
+  __m256i p0 = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 8);
+  __m256i p1 = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 8);
+  return _mm256_packs_epi32(p0, p1);
+}
+
+__attribute__((target("avx2"))) inline __m256i load16(const uint8_t *in) {
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)in));
+}
+
+// 16 lanes of codes 0..255 to 16 bytes in order
+__attribute__((target("avx2"))) inline void store16(uint8_t *out,
+                                                    __m256i code) {
+  __m256i packed = _mm256_packus_epi16(code, code);
+  _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(
+                                       _mm256_permute4x64_epi64(packed, 0x08)));
+}
+
+__attribute__((target("avx2"))) void
+decodeULawAvx2(const uint8_t *in, int16_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    _mm256_storeu_si256((__m256i *)(out + i), ulawDecode256(load16(in + i)));
+  decodeULawLut(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void
+decodeALawAvx2(const uint8_t *in, int16_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    _mm256_storeu_si256((__m256i *)(out + i), alawDecode256(load16(in + i)));
+  decodeALawLut(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void
+encodeULawAvx2(const int16_t *in, uint8_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    store16(out + i,
+            ulawEncode256(_mm256_loadu_si256((const __m256i *)(in + i))));
+  encodeULawLut(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void
+encodeALawAvx2(const int16_t *in, uint8_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    store16(out + i,
+            alawEncode256(_mm256_loadu_si256((const __m256i *)(in + i))));
+  encodeALawLut(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void
+decodeULawGainAvx2(const uint8_t *in, int16_t *out, size_t n, int gainQ8) {
+  const __m256i gain = _mm256_set1_epi16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    _mm256_storeu_si256((__m256i *)(out + i),
+                        gain256(ulawDecode256(load16(in + i)), gain));
+  decodeULawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+__attribute__((target("avx2"))) void
+decodeALawGainAvx2(const uint8_t *in, int16_t *out, size_t n, int gainQ8) {
+  const __m256i gain = _mm256_set1_epi16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    _mm256_storeu_si256((__m256i *)(out + i),
+                        gain256(alawDecode256(load16(in + i)), gain));
+  decodeALawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+__attribute__((target("avx2"))) void
+encodeULawGainAvx2(const int16_t *in, uint8_t *out, size_t n, int gainQ8) {
+  const __m256i gain = _mm256_set1_epi16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+    store16(out + i, ulawEncode256(gain256(x, gain)));
+  }
+  encodeULawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+__attribute__((target("avx2"))) void
+encodeALawGainAvx2(const int16_t *in, uint8_t *out, size_t n, int gainQ8) {
+  const __m256i gain = _mm256_set1_epi16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+    store16(out + i, alawEncode256(gain256(x, gain)));
+  }
+  encodeALawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+#endif // G711_HAVE_X86
+
+// ---------------------------------------------------------------------------
+// NEON kernels (AArch64, always available). NEON has per-lane shifts, so the
+// segment-dependent shifts are direct.
+// ---------------------------------------------------------------------------
+
+#ifdef G711_HAVE_NEON
+
+inline uint16x8_t segmentNeon(int16x8_t v) {
+  uint16x8_t seg = vdupq_n_u16(0);
+  seg = vsubq_u16(seg, vcgtq_s16(v, vdupq_n_s16(0xFF)));
+  seg = vsubq_u16(seg, vcgtq_s16(v, vdupq_n_s16(0x1FF)));
+  seg = vsubq_u16(seg, vcgtq_s16(v, vdupq_n_s16(0x3FF)));
+  seg = vsubq_u16(seg, vcgtq_s16(v, vdupq_n_s16(0x7FF)));
+  seg = vsubq_u16(seg, vcgtq_s16(v, vdupq_n_s16(0xFFF)));
+  seg = vsubq_u16(seg, vcgtq_s16(v, vdupq_n_s16(0x1FFF)));
+  seg = vsubq_u16(seg, vcgtq_s16(v, vdupq_n_s16(0x3FFF)));
+  return seg;
+}
+
+inline int16x8_t ulawDecodeNeon(uint8x8_t code) {
+  uint16x8_t u = vmovl_u8(vmvn_u8(code));
+  uint16x8_t mant = vaddq_u16(vshlq_n_u16(vandq_u16(u, vdupq_n_u16(0x0F)), 3),
+                              vdupq_n_u16(0x84));
+  int16x8_t exp =
+      vreinterpretq_s16_u16(vandq_u16(vshrq_n_u16(u, 4), vdupq_n_u16(7)));
+  int16x8_t r = vsubq_s16(vreinterpretq_s16_u16(vshlq_u16(mant, exp)),
+                          vdupq_n_s16(0x84));
+  uint16x8_t neg = vtstq_u16(u, vdupq_n_u16(0x80));
+  return vbslq_s16(neg, vnegq_s16(r), r);
+}
+
+inline int16x8_t alawDecodeNeon(uint8x8_t code) {
+  uint16x8_t a = vmovl_u8(veor_u8(code, vdup_n_u8(0x55)));
+  uint16x8_t t = vshlq_n_u16(vandq_u16(a, vdupq_n_u16(0x0F)), 4);
+  uint16x8_t seg = vandq_u16(vshrq_n_u16(a, 4), vdupq_n_u16(7));
+  uint16x8_t seg0 = vceqq_u16(seg, vdupq_n_u16(0));
+  uint16x8_t base = vbslq_u16(seg0, vaddq_u16(t, vdupq_n_u16(8)),
+                              vaddq_u16(t, vdupq_n_u16(0x108)));
+  int16x8_t shift = vreinterpretq_s16_u16(vqsubq_u16(seg, vdupq_n_u16(1)));
+  int16x8_t r = vreinterpretq_s16_u16(vshlq_u16(base, shift));
+  uint16x8_t pos = vtstq_u16(a, vdupq_n_u16(0x80));
+  return vbslq_s16(pos, r, vnegq_s16(r));
+}
+
+inline uint8x8_t ulawEncodeNeon(int16x8_t x) {
+  uint16x8_t neg = vcltq_s16(x, vdupq_n_s16(0));
+  int16x8_t v = vaddq_s16(vminq_s16(vabsq_s16(x), vdupq_n_s16(32635)),
+                          vdupq_n_s16(0x84));
+  uint16x8_t seg = segmentNeon(v);
+  int16x8_t shift =
+      vnegq_s16(vreinterpretq_s16_u16(vaddq_u16(seg, vdupq_n_u16(3))));
+  uint16x8_t mant = vandq_u16(vshlq_u16(vreinterpretq_u16_s16(v), shift),
+                              vdupq_n_u16(0x0F));
+  uint16x8_t code = vorrq_u16(vshlq_n_u16(seg, 4), mant);
+  uint16x8_t mask =
+      veorq_u16(vdupq_n_u16(0xFF), vandq_u16(neg, vdupq_n_u16(0x80)));
+  return vmovn_u16(veorq_u16(code, mask));
+}
+
+inline uint8x8_t alawEncodeNeon(int16x8_t x) {
+  uint16x8_t neg = vcltq_s16(x, vdupq_n_s16(0));
+  int16x8_t v = vabsq_s16(x);
+  uint16x8_t seg = segmentNeon(v);
+  // Segments 0 and 1 both take bits 4..7
+  int16x8_t shift = vnegq_s16(vreinterpretq_s16_u16(
+      vmaxq_u16(vaddq_u16(seg, vdupq_n_u16(3)), vdupq_n_u16(4))));
+  uint16x8_t mant = vandq_u16(vshlq_u16(vreinterpretq_u16_s16(v), shift),
+                              vdupq_n_u16(0x0F));
+  uint16x8_t code = vorrq_u16(vshlq_n_u16(seg, 4), mant);
+  uint16x8_t mask =
+      veorq_u16(vdupq_n_u16(0xD5), vandq_u16(neg, vdupq_n_u16(0x80)));
+  return vmovn_u16(veorq_u16(code, mask));
+}
+
+inline int16x8_t gainNeon(int16x8_t x, int16x8_t gain) {
+  int32x4_t lo = vshrq_n_s32(vmull_s16(vget_low_s16(x), vget_low_s16(gain)), 8);
+  int32x4_t hi = vshrq_n_s32(vmull_high_s16(x, gain), 8);
+  return vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+}
+
+void decodeULawNeon(const uint8_t *in, int16_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vst1q_s16(out + i, ulawDecodeNeon(vld1_u8(in + i)));
+  decodeULawLut(in + i, out + i, n - i);
+}
+
+void decodeALawNeon(const uint8_t *in, int16_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vst1q_s16(out + i, alawDecodeNeon(vld1_u8(in + i)));
+  decodeALawLut(in + i, out + i, n - i);
+}
+
+void encodeULawNeon(const int16_t *in, uint8_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vst1_u8(out + i, ulawEncodeNeon(vld1q_s16(in + i)));
+  encodeULawLut(in + i, out + i, n - i);
+}
+
+void encodeALawNeon(const int16_t *in, uint8_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vst1_u8(out + i, alawEncodeNeon(vld1q_s16(in + i)));
+  encodeALawLut(in + i, out + i, n - i);
+}
+
+void decodeULawGainNeon(const uint8_t *in, int16_t *out, size_t n,
+                        int gainQ8) {
+  const int16x8_t gain = vdupq_n_s16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vst1q_s16(out + i, gainNeon(ulawDecodeNeon(vld1_u8(in + i)), gain));
+  decodeULawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+void decodeALawGainNeon(const uint8_t *in, int16_t *out, size_t n,
+                        int gainQ8) {
+  const int16x8_t gain = vdupq_n_s16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vst1q_s16(out + i, gainNeon(alawDecodeNeon(vld1_u8(in + i)), gain));
+  decodeALawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+void encodeULawGainNeon(const int16_t *in, uint8_t *out, size_t n,
+                        int gainQ8) {
+  const int16x8_t gain = vdupq_n_s16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vst1_u8(out + i, ulawEncodeNeon(gainNeon(vld1q_s16(in + i), gain)));
+  encodeULawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+void encodeALawGainNeon(const int16_t *in, uint8_t *out, size_t n,
+                        int gainQ8) {
+  const int16x8_t gain = vdupq_n_s16((int16_t)gainQ8);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vst1_u8(out + i, alawEncodeNeon(gainNeon(vld1q_s16(in + i), gain)));
+  encodeALawGainLut(in + i, out + i, n - i, gainQ8);
+}
+
+#endif // G711_HAVE_NEON
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+struct Kernels {
+  G711Utils::Kernel id;
+  void (*decodeULaw)(const uint8_t *, int16_t *, size_t);
+  void (*decodeALaw)(const uint8_t *, int16_t *, size_t);
+  void (*encodeULaw)(const int16_t *, uint8_t *, size_t);
+  void (*encodeALaw)(const int16_t *, uint8_t *, size_t);
+  void (*decodeULawGain)(const uint8_t *, int16_t *, size_t, int);
+  void (*decodeALawGain)(const uint8_t *, int16_t *, size_t, int);
+  void (*encodeULawGain)(const int16_t *, uint8_t *, size_t, int);
+  void (*encodeALawGain)(const int16_t *, uint8_t *, size_t, int);
+};
+
+const Kernels kScalar = {G711Utils::Kernel::Scalar, decodeULawScalar,
+                         decodeALawScalar,           encodeULawScalar,
+                         encodeALawScalar,           decodeULawGainScalar,
+                         decodeALawGainScalar,       encodeULawGainScalar,
+                         encodeALawGainScalar};
+const Kernels kLut = {G711Utils::Kernel::Lut, decodeULawLut,    decodeALawLut,
+                      encodeULawLut,          encodeALawLut,    decodeULawGainLut,
+                      decodeALawGainLut,      encodeULawGainLut, encodeALawGainLut};
+#ifdef G711_HAVE_X86
+const Kernels kSse41 = {G711Utils::Kernel::Sse41, decodeULawSse41,
+                        decodeALawSse41,          encodeULawSse41,
+                        encodeALawSse41,          decodeULawGainSse41,
+                        decodeALawGainSse41,      encodeULawGainSse41,
+                        encodeALawGainSse41};
+const Kernels kAvx2 = {G711Utils::Kernel::Avx2, decodeULawAvx2,
+                       decodeALawAvx2,          encodeULawAvx2,
+                       encodeALawAvx2,          decodeULawGainAvx2,
+                       decodeALawGainAvx2,      encodeULawGainAvx2,
+                       encodeALawGainAvx2};
+#endif
+#ifdef G711_HAVE_NEON
+const Kernels kNeon = {G711Utils::Kernel::Neon, decodeULawNeon,
+                       decodeALawNeon,          encodeULawNeon,
+                       encodeALawNeon,          decodeULawGainNeon,
+                       decodeALawGainNeon,      encodeULawGainNeon,
+                       encodeALawGainNeon};
+#endif
+
+const Kernels *kernelsFor(G711Utils::Kernel k) {
+  switch (k) {
+  case G711Utils::Kernel::Scalar:
+    return &kScalar;
+  case G711Utils::Kernel::Lut:
+    return &kLut;
+#ifdef G711_HAVE_X86
+  case G711Utils::Kernel::Sse41:
+    return __builtin_cpu_supports("sse4.1") ? &kSse41 : nullptr;
+  case G711Utils::Kernel::Avx2:
+    return __builtin_cpu_supports("avx2") ? &kAvx2 : nullptr;
+#endif
+#ifdef G711_HAVE_NEON
+  case G711Utils::Kernel::Neon:
+    return &kNeon;
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+std::atomic<const Kernels *> &active() {
+  static std::atomic<const Kernels *> kernels{[] {
+    for (auto k : {G711Utils::Kernel::Avx2, G711Utils::Kernel::Neon,
+                   G711Utils::Kernel::Sse41}) {
+      if (const Kernels *best = kernelsFor(k))
+        return best;
+    }
+    return &kLut;
+  }()};
+  return kernels;
+}
+
+inline const Kernels *current() {
+  return active().load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+void G711Utils::decodeULaw(const uint8_t *in, int16_t *out, size_t n) {
+  current()->decodeULaw(in, out, n);
+}
+
+void G711Utils::decodeALaw(const uint8_t *in, int16_t *out, size_t n) {
+  current()->decodeALaw(in, out, n);
+}
+
+void G711Utils::encodeULaw(const int16_t *in, uint8_t *out, size_t n) {
+  current()->encodeULaw(in, out, n);
+}
+
+void G711Utils::encodeALaw(const int16_t *in, uint8_t *out, size_t n) {
+  current()->encodeALaw(in, out, n);
+}
+
+void G711Utils::decodeULaw(const uint8_t *in, int16_t *out, size_t n,
+                           int gainQ8) {
+  current()->decodeULawGain(in, out, n, gainQ8);
+}
+
+void G711Utils::decodeALaw(const uint8_t *in, int16_t *out, size_t n,
+                           int gainQ8) {
+  current()->decodeALawGain(in, out, n, gainQ8);
+}
+
+void G711Utils::encodeULaw(const int16_t *in, uint8_t *out, size_t n,
+                           int gainQ8) {
+  current()->encodeULawGain(in, out, n, gainQ8);
+}
+
+void G711Utils::encodeALaw(const int16_t *in, uint8_t *out, size_t n,
+                           int gainQ8) {
+  current()->encodeALawGain(in, out, n, gainQ8);
+}
+
+int G711Utils::gainToQ8(float gain) {
+  if (!(gain > 0.0f))
+    return 0;
+  float q8 = gain * 256.0f + 0.5f;
+  return q8 >= (float)kMaxGainQ8 ? kMaxGainQ8 : (int)q8;
+}
+
+G711Utils::Kernel G711Utils::kernel() { return current()->id; }
+
+bool G711Utils::kernelSupported(Kernel k) { return kernelsFor(k) != nullptr; }
+
+bool G711Utils::setKernel(Kernel k) {
+  const Kernels *kernels = kernelsFor(k);
+  if (!kernels)
+    return false;
+  active().store(kernels, std::memory_order_relaxed);
+  return true;
+}
+
+const char *G711Utils::kernelName(Kernel k) {
+  switch (k) {
+  case Kernel::Scalar:
+    return "scalar";
+  case Kernel::Lut:
+    return "lut";
+  case Kernel::Sse41:
+    return "sse4.1";
+  case Kernel::Avx2:
+    return "avx2";
+  case Kernel::Neon:
+    return "neon";
+  }
+  return "unknown";
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -67,31 +68,59 @@ public:
         return a_val ^ mask;
     }
 
+    // Batch conversion of n samples. These run the fastest kernel for this
+    // CPU (selected once at startup) and match the scalar functions above
+    // bit for bit, including their -32768 encoding.
+    static void decodeULaw(const uint8_t *in, int16_t *out, size_t n);
+    static void decodeALaw(const uint8_t *in, int16_t *out, size_t n);
+    static void encodeULaw(const int16_t *in, uint8_t *out, size_t n);
+    static void encodeALaw(const int16_t *in, uint8_t *out, size_t n);
+
+    // Fused variants that also scale by gainQ8 / 256 with saturation, in a
+    // single pass: decode+gain, and gain+encode. applyGain() is the per-sample
+    // reference.
+    static constexpr int kUnityGainQ8 = 256;
+    static constexpr int kMaxGainQ8 = 32767;
+    static void decodeULaw(const uint8_t *in, int16_t *out, size_t n, int gainQ8);
+    static void decodeALaw(const uint8_t *in, int16_t *out, size_t n, int gainQ8);
+    static void encodeULaw(const int16_t *in, uint8_t *out, size_t n, int gainQ8);
+    static void encodeALaw(const int16_t *in, uint8_t *out, size_t n, int gainQ8);
+    static int gainToQ8(float gain);
+
+    static int16_t applyGain(int16_t sample, int gainQ8) {
+        int32_t v = (static_cast<int32_t>(sample) * gainQ8) >> 8;
+        if (v > 32767) v = 32767;
+        if (v < -32768) v = -32768;
+        return static_cast<int16_t>(v);
+    }
+
     static void decodeULaw(const std::vector<char>& input, std::vector<int16_t>& output) {
         output.resize(input.size());
-        for (size_t i = 0; i < input.size(); ++i) {
-            output[i] = ulawToLinear(static_cast<uint8_t>(input[i]));
-        }
+        decodeULaw(reinterpret_cast<const uint8_t *>(input.data()), output.data(), input.size());
     }
 
     static void decodeALaw(const std::vector<char>& input, std::vector<int16_t>& output) {
         output.resize(input.size());
-        for (size_t i = 0; i < input.size(); ++i) {
-            output[i] = alawToLinear(static_cast<uint8_t>(input[i]));
-        }
+        decodeALaw(reinterpret_cast<const uint8_t *>(input.data()), output.data(), input.size());
     }
 
     static void encodeULaw(const std::vector<int16_t>& input, std::vector<char>& output) {
         output.resize(input.size());
-        for (size_t i = 0; i < input.size(); ++i) {
-            output[i] = static_cast<char>(linearToULaw(input[i]));
-        }
+        encodeULaw(input.data(), reinterpret_cast<uint8_t *>(output.data()), input.size());
     }
 
     static void encodeALaw(const std::vector<int16_t>& input, std::vector<char>& output) {
         output.resize(input.size());
-        for (size_t i = 0; i < input.size(); ++i) {
-            output[i] = static_cast<char>(linearToALaw(input[i]));
-        }
+        encodeALaw(input.data(), reinterpret_cast<uint8_t *>(output.data()), input.size());
     }
+
+    // Kernel selection. Scalar runs the per-sample functions above, Lut uses
+    // a 256-entry decode table and a 14-bit (sign + magnitude / 4) encode
+    // table, the rest are vector kernels. setKernel() returns false if the
+    // CPU cannot run the requested one.
+    enum class Kernel { Scalar, Lut, Sse41, Avx2, Neon };
+    static Kernel kernel();
+    static bool setKernel(Kernel k);
+    static bool kernelSupported(Kernel k);
+    static const char *kernelName(Kernel k);
 };
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Bounded lock-free multi-producer / single-consumer queue (Vyukov's
+// sequence-numbered ring). Any thread may push; only the owning thread pops.
+// Capacity is rounded up to a power of two. push() fails instead of blocking
+// when the ring is full.
+template <typename T> class MpscQueue {
+public:
+  explicit MpscQueue(size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity)
+      cap <<= 1;
+    mask_ = cap - 1;
+    cells_.reset(new Cell[cap]);
+    for (size_t i = 0; i < cap; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  bool push(T &&value) {
+    return pushWith([&](T &slot) { slot = std::move(value); });
+  }
+
+  // As push(), but fill(T &) writes the value straight into its cell, so a
+  // large value is not built elsewhere and copied in
+  template <typename Fill> bool pushWith(Fill &&fill) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    fill(cell->value);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only
+  bool pop(T &out) {
+    return popWith([&](T &value) {
+      out = std::move(value);
+      // Release anything the moved-from value still owns; plain data (audio
+      // buffers) needs no reset
+      if constexpr (!std::is_trivially_copyable<T>::value)
+        value = T();
+    });
+  }
+
+  // Consumer only. As pop(), but consume(T &) works on the value where it
+  // lies; the cell is handed back to producers when it returns.
+  template <typename Consume> bool popWith(Consume &&consume) {
+    Cell *cell = &cells_[head_ & mask_];
+    if (cell->seq.load(std::memory_order_acquire) != head_ + 1)
+      return false;
+    consume(cell->value);
+    cell->seq.store(head_ + mask_ + 1, std::memory_order_release);
+    head_++;
+    return true;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_ = 0;
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) size_t head_ = 0;
+};
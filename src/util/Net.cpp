@@ -50,6 +50,15 @@ bool Net::setNonBlocking(int fd) {
   return true;
 }
 
+bool Net::setReusePort(int fd) {
+  int opt = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+    LOG_ERROR("Failed to set SO_REUSEPORT: " << strerror(errno));
+    return false;
+  }
+  return true;
+}
+
 void Net::closeSocket(int fd) {
   if (fd >= 0)
     close(fd);
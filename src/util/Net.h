@@ -8,6 +8,9 @@ public:
   static int createUdpSocket();
   static bool bindSocket(int fd, const std::string &ip, int port);
   static bool setNonBlocking(int fd);
+  // Lets several sockets bind the same port; the kernel spreads datagrams
+  // across them by source address. Must precede bind.
+  static bool setReusePort(int fd);
   static void closeSocket(int fd);
 
   // address helper
@@ -1,42 +1,74 @@
 #pragma once
 
-#include <functional>
+#include <atomic>
+#include <cstddef>
 #include <memory>
-#include <mutex>
+#include <type_traits>
 #include <vector>
 
+// Slab allocator with a lock-free free list, meant to be owned by one thread.
+//
+// acquire() may only be called by the owning thread and grows the pool by a
+// slab when it runs dry. release() may be called from any thread: it is a
+// Treiber-stack push, and since the owner is the only one popping, a node can
+// never be popped and re-pushed under a concurrent pop (no ABA).
+// Objects are never destroyed until the pool itself goes away.
 template <typename T> class ObjectPool {
 public:
-  ObjectPool(size_t size) {
-    for (size_t i = 0; i < size; ++i) {
-      pool_.push_back(std::make_unique<T>());
-    }
+  explicit ObjectPool(size_t slabSize) : slabSize_(slabSize ? slabSize : 1) {
+    grow();
   }
 
-  // Simple get/return for single thread usage or mutex protected
-  // For now, let's keep it simple. If we need high perf, we avoid mutex.
-  // Given the constraints, let's make it thread-safe for safety.
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
 
-  std::unique_ptr<T> acquire() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (pool_.empty()) {
-      return std::make_unique<T>(); // Expand if empty
+  T *acquire() {
+    Node *head = free_.load(std::memory_order_acquire);
+    while (head &&
+           !free_.compare_exchange_weak(head, head->next,
+                                        std::memory_order_acquire,
+                                        std::memory_order_acquire)) {
+    }
+    if (!head) {
+      grow();
+      return acquire();
     }
-    auto ptr = std::move(pool_.back());
-    pool_.pop_back();
-    return ptr;
+    return &head->value;
   }
 
-  void release(std::unique_ptr<T> ptr) {
-    if (!ptr)
+  void release(T *obj) {
+    if (!obj)
       return;
-    std::lock_guard<std::mutex> lock(mutex_);
-    // Reset state if T has reset method
-    // ptr->reset();
-    pool_.push_back(std::move(ptr));
+    // value is the first member, so the object address is the node address
+    Node *node = reinterpret_cast<Node *>(obj);
+    Node *head = free_.load(std::memory_order_relaxed);
+    do {
+      node->next = head;
+    } while (!free_.compare_exchange_weak(head, node,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
   }
 
+  // Number of objects allocated so far (owner thread only)
+  size_t capacity() const { return slabs_.size() * slabSize_; }
+
 private:
-  std::vector<std::unique_ptr<T>> pool_;
-  std::mutex mutex_;
+  struct Node {
+    T value;
+    Node *next = nullptr;
+  };
+
+  void grow() {
+    static_assert(std::is_standard_layout<Node>::value,
+                  "release() relies on value being at offset 0");
+    std::unique_ptr<Node[]> slab(new Node[slabSize_]);
+    for (size_t i = 0; i < slabSize_; ++i) {
+      release(&slab[i].value);
+    }
+    slabs_.push_back(std::move(slab));
+  }
+
+  size_t slabSize_;
+  std::atomic<Node *> free_{nullptr};
+  std::vector<std::unique_ptr<Node[]>> slabs_;
 };
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Wait-free single-producer / single-consumer byte ring for streaming audio
+// between a network reader thread and the media thread. Capacity is rounded
+// up to a power of two.
+//
+// Overflow drops the oldest audio: when the consumer finds more than
+// maxBacklog bytes queued it skips ahead to the newest maxBacklog, keeping
+// latency bounded. Only if the ring itself fills (consumer stalled) does the
+// producer drop incoming bytes. Both count as overflow.
+class SpscByteRing {
+public:
+  explicit SpscByteRing(size_t capacity, size_t maxBacklog = 0) {
+    size_t cap = 2;
+    while (cap < capacity)
+      cap <<= 1;
+    mask_ = cap - 1;
+    maxBacklog_ = maxBacklog == 0 || maxBacklog > cap ? cap : maxBacklog;
+    buf_.reset(new uint8_t[cap]);
+  }
+
+  SpscByteRing(const SpscByteRing &) = delete;
+  SpscByteRing &operator=(const SpscByteRing &) = delete;
+
+  // Producer only. Returns the number of bytes queued.
+  size_t write(const void *data, size_t len) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    size_t room = capacity() - (size_t)(head - tailCache_);
+    if (room < len) {
+      tailCache_ = tail_.load(std::memory_order_acquire);
+      room = capacity() - (size_t)(head - tailCache_);
+    }
+    size_t n = std::min(len, room);
+    if (n < len)
+      producerDropped_.fetch_add(len - n, std::memory_order_relaxed);
+    copyIn(head, static_cast<const uint8_t *>(data), n);
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // Consumer only. Reads exactly len bytes, or nothing (an underrun) if
+  // fewer are queued.
+  bool read(void *out, size_t len) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    size_t avail = (size_t)(head - tail);
+    if (avail > maxBacklog_) {
+      consumerDropped_.fetch_add(avail - maxBacklog_,
+                                 std::memory_order_relaxed);
+      tail += avail - maxBacklog_;
+      avail = maxBacklog_;
+    }
+    if (avail < len) {
+      underruns_.fetch_add(1, std::memory_order_relaxed);
+      tail_.store(tail, std::memory_order_release);
+      return false;
+    }
+    copyOut(tail, static_cast<uint8_t *>(out), len);
+    tail_.store(tail + len, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called off the consumer thread
+  size_t size() const {
+    return (size_t)(head_.load(std::memory_order_acquire) -
+                    tail_.load(std::memory_order_acquire));
+  }
+  size_t capacity() const { return mask_ + 1; }
+
+  // Bytes dropped by either side, and reads that found too little data
+  uint64_t overflowBytes() const {
+    return producerDropped_.load(std::memory_order_relaxed) +
+           consumerDropped_.load(std::memory_order_relaxed);
+  }
+  uint64_t underruns() const {
+    return underruns_.load(std::memory_order_relaxed);
+  }
+
+private:
+  void copyIn(uint64_t pos, const uint8_t *src, size_t n) {
+    size_t off = (size_t)pos & mask_;
+    size_t first = std::min(n, capacity() - off);
+    memcpy(buf_.get() + off, src, first);
+    memcpy(buf_.get(), src + first, n - first);
+  }
+
+  void copyOut(uint64_t pos, uint8_t *dst, size_t n) const {
+    size_t off = (size_t)pos & mask_;
+    size_t first = std::min(n, capacity() - off);
+    memcpy(dst, buf_.get() + off, first);
+    memcpy(dst + first, buf_.get(), n - first);
+  }
+
+  std::unique_ptr<uint8_t[]> buf_;
+  size_t mask_ = 0;
+  size_t maxBacklog_ = 0;
+
+  // Producer side
+  alignas(64) std::atomic<uint64_t> head_{0};
+  uint64_t tailCache_ = 0;
+  std::atomic<uint64_t> producerDropped_{0};
+
+  // Consumer side
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  std::atomic<uint64_t> consumerDropped_{0};
+  std::atomic<uint64_t> underruns_{0};
+};
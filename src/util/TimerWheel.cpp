@@ -0,0 +1,121 @@
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(uint64_t startTick) : now_(startTick) {
+  for (auto &level : heads_) {
+    for (auto &head : level) {
+      head = -1;
+    }
+  }
+}
+
+TimerWheel::TimerId TimerWheel::scheduleAt(uint64_t tick, Callback cb) {
+  int32_t idx;
+  if (!free_.empty()) {
+    idx = free_.back();
+    free_.pop_back();
+  } else {
+    idx = (int32_t)nodes_.size();
+    nodes_.emplace_back();
+  }
+  Node &node = nodes_[idx];
+  // Never into the slot being fired, so a callback rescheduling "now"
+  // cannot spin inside a single advance step
+  node.expiry = tick > now_ ? tick : now_ + 1;
+  node.cb = std::move(cb);
+  link(idx);
+  pending_++;
+  return (uint64_t)node.generation << 32 | (uint32_t)(idx + 1);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+  int32_t idx = (int32_t)(uint32_t)id - 1;
+  if (idx < 0 || idx >= (int32_t)nodes_.size())
+    return false;
+  Node &node = nodes_[idx];
+  if (node.level < 0 || node.generation != (uint32_t)(id >> 32))
+    return false;
+  unlink(idx);
+  release(idx);
+  return true;
+}
+
+size_t TimerWheel::advanceTo(uint64_t tick) {
+  size_t fired = 0;
+  while (now_ < tick) {
+    if (pending_ == 0) {
+      // Nothing to cascade or fire, jump straight there
+      now_ = tick;
+      break;
+    }
+    now_++;
+
+    // Pull down the next round of each level that just wrapped
+    for (int level = kLevels - 1; level > 0; --level) {
+      uint64_t lowBits = now_ & ((1ULL << (level * kSlotBits)) - 1);
+      if (lowBits == 0)
+        cascade(level);
+    }
+
+    int32_t &head = heads_[0][now_ & kSlotMask];
+    while (head >= 0) {
+      int32_t idx = head;
+      unlink(idx);
+      Callback cb = std::move(nodes_[idx].cb);
+      release(idx);
+      fired++;
+      cb();
+    }
+  }
+  return fired;
+}
+
+void TimerWheel::link(int32_t idx) {
+  Node &node = nodes_[idx];
+  uint64_t delta = node.expiry - now_;
+  uint64_t at = delta > kMaxDelta ? now_ + kMaxDelta : node.expiry;
+  if (delta > kMaxDelta)
+    delta = kMaxDelta;
+
+  int level = 0;
+  while (level < kLevels - 1 && delta >= (1ULL << ((level + 1) * kSlotBits)))
+    level++;
+  uint8_t slot = (at >> (level * kSlotBits)) & kSlotMask;
+
+  node.level = (int8_t)level;
+  node.slot = slot;
+  node.prev = -1;
+  node.next = heads_[level][slot];
+  if (node.next >= 0)
+    nodes_[node.next].prev = idx;
+  heads_[level][slot] = idx;
+}
+
+void TimerWheel::unlink(int32_t idx) {
+  Node &node = nodes_[idx];
+  if (node.prev >= 0)
+    nodes_[node.prev].next = node.next;
+  else
+    heads_[node.level][node.slot] = node.next;
+  if (node.next >= 0)
+    nodes_[node.next].prev = node.prev;
+  node.level = -1;
+  node.prev = node.next = -1;
+}
+
+void TimerWheel::cascade(int level) {
+  int32_t idx = heads_[level][(now_ >> (level * kSlotBits)) & kSlotMask];
+  heads_[level][(now_ >> (level * kSlotBits)) & kSlotMask] = -1;
+  while (idx >= 0) {
+    int32_t next = nodes_[idx].next;
+    link(idx);
+    idx = next;
+  }
+}
+
+void TimerWheel::release(int32_t idx) {
+  Node &node = nodes_[idx];
+  node.cb = nullptr;
+  node.generation++;
+  free_.push_back(idx);
+  pending_--;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Hierarchical timing wheel (4 levels x 64 slots) counting in abstract ticks.
+// It has no clock of its own: the owner decides what a tick is and calls
+// advanceTo() with the current tick, which makes it equally usable with a
+// timerfd or a virtual clock. Schedule, cancel and per-tick expiry are O(1)
+// (amortised over cascades). Not thread-safe; meant to be owned by one loop.
+class TimerWheel {
+public:
+  using TimerId = uint64_t; // 0 is never a valid id
+  using Callback = std::function<void()>;
+
+  explicit TimerWheel(uint64_t startTick = 0);
+
+  // Fire at the given absolute tick; ticks that are already due fire on the
+  // next advanceTo()
+  TimerId scheduleAt(uint64_t tick, Callback cb);
+  TimerId scheduleAfter(uint64_t ticks, Callback cb) {
+    return scheduleAt(now_ + ticks, std::move(cb));
+  }
+  // False if the timer already fired or was cancelled
+  bool cancel(TimerId id);
+
+  // Run every timer due up to and including tick. Callbacks may schedule
+  // and cancel timers. Returns the number of timers fired.
+  size_t advanceTo(uint64_t tick);
+
+  uint64_t now() const { return now_; }
+  size_t pending() const { return pending_; }
+
+private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlots = 1 << kSlotBits;
+  static constexpr uint64_t kSlotMask = kSlots - 1;
+  static constexpr uint64_t kMaxDelta = (1ULL << (kLevels * kSlotBits)) - 1;
+
+  struct Node {
+    uint64_t expiry = 0;
+    Callback cb;
+    uint32_t generation = 0;
+    int32_t prev = -1;
+    int32_t next = -1;
+    int8_t level = -1; // -1 when not linked
+    uint8_t slot = 0;
+  };
+
+  void link(int32_t idx);
+  void unlink(int32_t idx);
+  void cascade(int level);
+  void release(int32_t idx);
+
+  uint64_t now_;
+  size_t pending_ = 0;
+  std::vector<Node> nodes_;
+  std::vector<int32_t> free_;
+  int32_t heads_[kLevels][kSlots];
+};
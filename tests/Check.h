@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Assertions for the test programs. Unlike assert() they stay on in release
+// builds; the first failure ends the program with a non-zero status.
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed"  \
+                << std::endl;                                                  \
+      std::exit(1);                                                            \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                         \
+  do {                                                                         \
+    auto checkA_ = (a);                                                        \
+    auto checkB_ = (b);                                                        \
+    if (!(checkA_ == checkB_)) {                                               \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #a ", " #b     \
+                << ") failed: " << checkA_ << " vs " << checkB_ << std::endl;  \
+      std::exit(1);                                                            \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,137 @@
+// JitterBuffer on a continuous stream (no markers, no silence): the applied
+// delay has to follow the jitter during playout, not only at talkspurts
+
+#include "Check.h"
+#include "rtp/JitterBuffer.h"
+#include "rtp/RtpPacketPool.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+
+namespace {
+
+const int kFrameMs = 20;
+const uint32_t kFirstTs = 0xFFFF0000; // wraps during the run
+
+// 20 ms PCMU sender whose packets reach the buffer after a random network
+// delay; the buffer is popped once per frame interval like the media clock
+// does
+class Stream {
+public:
+  struct Counts {
+    uint64_t played = 0;
+    uint64_t concealed = 0;
+    uint64_t silent = 0; // popped nothing: playout stalled
+    uint64_t late = 0;
+    int maxLatencyMs = 0; // send to playout
+  };
+
+  Stream() : pool_(RtpPacketPool::create(64)) {}
+  ~Stream() {
+    inFlight_.clear();
+    pool_->retire();
+  }
+
+  // Runs for durationMs with network delays uniform in [0, maxJitterMs]
+  Counts run(uint64_t durationMs, int maxJitterMs) {
+    Counts counts;
+    uint64_t lateBefore = jb_.stats().late;
+    for (uint64_t end = now_ + durationMs; now_ < end; ++now_) {
+      if (now_ % kFrameMs == 0) {
+        uint64_t delay = maxJitterMs > 0 ? rng_() % (maxJitterMs + 1) : 0;
+        inFlight_.emplace(now_ + delay, packet());
+      }
+      while (!inFlight_.empty() && inFlight_.begin()->first <= now_) {
+        jb_.push(inFlight_.begin()->second, now_);
+        inFlight_.erase(inFlight_.begin());
+      }
+      if (now_ % kFrameMs == 7) {
+        JitterBuffer::Frame frame = jb_.pop(now_);
+        if (frame.packet) {
+          counts.played++;
+          uint32_t sent = (frame.packet->getTimestamp() - kFirstTs) / 160;
+          int latency = (int)(now_ - (uint64_t)sent * kFrameMs);
+          counts.maxLatencyMs = std::max(counts.maxLatencyMs, latency);
+        } else if (frame.lost) {
+          counts.concealed++;
+        } else {
+          counts.silent++;
+        }
+      }
+    }
+    counts.late = jb_.stats().late - lateBefore;
+    return counts;
+  }
+
+  const JitterBuffer::Stats &stats() const { return jb_.stats(); }
+
+private:
+  RtpPacketRef packet() {
+    RtpPacketRef pkt = pool_->acquire();
+    memset(pkt->buffer, 0xFF, 172);
+    pkt->buffer[0] = 0x80;
+    pkt->buffer[1] = 0; // PCMU, never a marker
+    uint16_t seq = htons(seq_++);
+    uint32_t ts = htonl(ts_);
+    ts_ += 160;
+    memcpy(pkt->buffer + 2, &seq, 2);
+    memcpy(pkt->buffer + 4, &ts, 4);
+    pkt->parse(172);
+    return pkt;
+  }
+
+  RtpPacketPool *pool_;
+  JitterBuffer jb_{20, 200};
+  std::mt19937 rng_{1};
+  std::multimap<uint64_t, RtpPacketRef> inFlight_;
+  uint64_t now_ = 0;
+  uint16_t seq_ = 65000; // wraps during the run
+  uint32_t ts_ = kFirstTs;
+};
+
+} // namespace
+
+int main() {
+  Stream stream;
+
+  // Steady network: nothing late, the delay stays at the minimum
+  auto calm = stream.run(5000, 0);
+  CHECK_EQ(calm.late, 0u);
+  CHECK_EQ(calm.concealed, 0u);
+  CHECK(calm.played >= 245);
+  CHECK(calm.maxLatencyMs <= 40);
+  CHECK_EQ(stream.stats().delayMs, 20);
+
+  // Jitter jumps to 0-80 ms mid-stream with no marker to re-anchor on;
+  // the delay has to grow during playout to cover it
+  stream.run(10000, 80);
+  CHECK(stream.stats().stretched > 0);
+  CHECK(stream.stats().delayMs >= 80);
+  auto before = stream.stats();
+  auto jittery = stream.run(20000, 80);
+  CHECK(jittery.late * 100 <= jittery.played);         // under 1%
+  CHECK((jittery.concealed + jittery.silent) * 50 <= jittery.played); // 2%
+  CHECK(jittery.maxLatencyMs <= 200 + kFrameMs); // max delay + pop phase
+  // ...without see-sawing around the noisy jitter estimate
+  CHECK(stream.stats().stretched - before.stretched +
+            stream.stats().compressed - before.compressed <=
+        15);
+
+  // The network settles again: the delay comes back down by skipping
+  // frames, and playout stays clean
+  stream.run(60000, 0);
+  CHECK(stream.stats().compressed > 0);
+  CHECK(stream.stats().delayMs <= 40);
+  auto settled = stream.run(5000, 0);
+  CHECK_EQ(settled.late, 0u);
+  CHECK_EQ(settled.concealed, 0u);
+  CHECK_EQ(settled.silent, 0u);
+  CHECK(settled.played >= 245);
+  CHECK(settled.maxLatencyMs <= 40);
+
+  printf("jitter_buffer_test passed\n");
+  return 0;
+}
@@ -0,0 +1,170 @@
+// Counts heap allocations across steady-state media ticks: a packet through
+// the jitter buffer, G.711 decode with loss concealment, and both pipeline
+// directions through an echo stage, the way CallSession runs a call. After
+// warm-up none of it may allocate.
+
+#include "Check.h"
+#include "media/G711Plc.h"
+#include "media/MediaPipeline.h"
+#include "media/stages/EchoStage.h"
+#include "rtp/JitterBuffer.h"
+#include "rtp/RtpPacketPool.h"
+#include "util/G711Utils.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Every global allocation in the program goes through these. The test is
+// single-threaded, so the count is the tick's.
+static std::atomic<size_t> gAllocations{0};
+
+void *operator new(size_t size) {
+  gAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  gAllocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+const int kPtimeMs = 20;
+const size_t kSamples = 160;
+
+// Counts what reaches the end of the pipeline, so the test knows the ticks
+// really carried audio
+class CountingStage : public Stage {
+public:
+  void processUplink(AudioFrame &frame) override {
+    if (!frame.empty())
+      uplink++;
+  }
+  void processDownlink(AudioFrame &frame) override {
+    if (!frame.empty())
+      downlink++;
+  }
+
+  size_t uplink = 0;
+  size_t downlink = 0;
+};
+
+// One call's media path, after CallSession::processRtpFrame and onMediaTick
+class Call {
+public:
+  Call() : pool_(RtpPacketPool::create(64)) {
+    pipeline_ = std::make_shared<MediaPipeline>();
+    pipeline_->addStage(std::make_shared<EchoStage>());
+    counter_ = std::make_shared<CountingStage>();
+    pipeline_->addStage(counter_);
+  }
+  ~Call() { pool_->retire(); }
+
+  // Every tenth packet is lost so concealment runs too
+  void tick() {
+    if (tick_ % 10 != 9)
+      jitterBuffer_.push(packet(), nowMs_);
+    seq_++;
+    ts_ += kSamples;
+    tick_++;
+    nowMs_ += kPtimeMs;
+
+    JitterBuffer::Frame frame = jitterBuffer_.pop(nowMs_);
+    AudioFrame &out = uplink_;
+    out.payloadType = 0;
+    int16_t pcm[AudioFrame::kCapacity];
+    if (frame.packet) {
+      out.assign(frame.packet->getPayload(), frame.packet->getPayloadSize());
+      out.timestamp = frame.packet->getTimestamp();
+      out.seq = frame.packet->getSequenceNumber();
+      out.concealed = false;
+      G711Utils::decodeULaw(out.data, pcm, out.size);
+      if (plc_.receive(pcm, out.size))
+        G711Utils::encodeULaw(pcm, out.data, out.size);
+    } else if (frame.lost) {
+      plc_.conceal(pcm, kSamples);
+      G711Utils::encodeULaw(pcm, out.data, kSamples);
+      out.size = kSamples;
+      out.concealed = true;
+    } else {
+      out.clear();
+    }
+    std::shared_ptr<MediaPipeline> pipelineCopy = pipeline_;
+    pipelineCopy->processUplink(out);
+    pipelineCopy->processDownlink(downlink_);
+  }
+
+  const CountingStage &counter() const { return *counter_; }
+  const JitterBuffer::Stats &stats() const { return jitterBuffer_.stats(); }
+
+private:
+  RtpPacketRef packet() {
+    RtpPacketRef pkt = pool_->acquire();
+    pkt->buffer[0] = 0x80;
+    pkt->buffer[1] = 0; // PCMU
+    uint16_t seq = htons(seq_);
+    uint32_t ts = htonl(ts_);
+    memcpy(pkt->buffer + 2, &seq, 2);
+    memcpy(pkt->buffer + 4, &ts, 4);
+    memset(pkt->buffer + 8, 0, 4);
+    for (size_t i = 0; i < kSamples; ++i)
+      pkt->buffer[12 + i] = (uint8_t)(0x80 + (tick_ * 7 + i) % 64);
+    pkt->parse(12 + kSamples);
+    return pkt;
+  }
+
+  RtpPacketPool *pool_;
+  JitterBuffer jitterBuffer_{2 * kPtimeMs, 200}; // a gap is followed by a packet
+  G711Plc plc_;
+  std::shared_ptr<MediaPipeline> pipeline_;
+  std::shared_ptr<CountingStage> counter_;
+  AudioFrame uplink_;
+  AudioFrame downlink_;
+  uint64_t nowMs_ = 1000;
+  uint64_t tick_ = 0;
+  uint16_t seq_ = 1;
+  uint32_t ts_ = 0;
+};
+
+} // namespace
+
+int main() {
+  Call call;
+  CHECK(gAllocations.load() > 0); // the pipeline's setup was counted
+  for (int i = 0; i < 200; ++i)
+    call.tick();
+  size_t uplinkBefore = call.counter().uplink;
+  size_t downlinkBefore = call.counter().downlink;
+  uint64_t lostBefore = call.stats().lost;
+
+  size_t before = gAllocations.load();
+  for (int i = 0; i < 5000; ++i)
+    call.tick();
+  size_t allocations = gAllocations.load() - before;
+
+  CHECK_EQ(allocations, 0u);
+  // The ticks carried audio both ways, concealment included
+  CHECK(call.counter().uplink - uplinkBefore >= 4900);
+  CHECK(call.counter().downlink - downlinkBefore >= 4900);
+  CHECK(call.stats().lost - lostBefore >= 400);
+
+  std::printf("media_alloc_test passed\n");
+  return 0;
+}
@@ -0,0 +1,191 @@
+// RtpWorker media clock on the virtual clock: sinks tick at their
+// packetization interval, only when the clock is stepped. A tick that
+// blocks also stalls the loop, which is used to time out an allocation.
+
+#include "Check.h"
+#include "app/Logger.h"
+#include "rtp/RtpWorker.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class TickSink : public RtpSink {
+public:
+  explicit TickSink(int intervalMs) : intervalMs_(intervalMs) {}
+  void onRtpPacket(const RtpPacketRef &, const sockaddr_in &) override {}
+  int mediaTickIntervalMs() const override { return intervalMs_; }
+  void onMediaTick(uint64_t nowMs) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ticks_.push_back(nowMs);
+    count_.store(ticks_.size());
+  }
+
+  std::vector<uint64_t> ticks() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ticks_;
+  }
+  size_t count() const { return count_.load(); }
+
+private:
+  int intervalMs_;
+  std::mutex mutex_;
+  std::vector<uint64_t> ticks_;
+  std::atomic<size_t> count_{0};
+};
+
+// Blocks the loop in its first tick until go()
+class StallSink : public RtpSink {
+public:
+  void onRtpPacket(const RtpPacketRef &, const sockaddr_in &) override {}
+  int mediaTickIntervalMs() const override { return 20; }
+  void onMediaTick(uint64_t) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stalled_ = true;
+    cv_.notify_all();
+    cv_.wait(lock, [this] { return released_; });
+  }
+
+  void waitStalled() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return stalled_; });
+  }
+  void go() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    released_ = true;
+    cv_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stalled_ = false;
+  bool released_ = false;
+};
+
+RtpWorkerOptions virtualClockOptions(int tickMs) {
+  RtpWorkerOptions options;
+  options.virtualClock = true;
+  options.mediaTickMs = tickMs;
+  options.socketPoolSize = 2;
+  options.portQuarantineMs = 0;
+  return options;
+}
+
+std::vector<uint64_t> every(uint64_t first, uint64_t step, size_t n) {
+  std::vector<uint64_t> out;
+  for (size_t i = 0; i < n; ++i)
+    out.push_back(first + step * i);
+  return out;
+}
+
+// Once the worker is stopped the commands run inline, so every step is
+// visible as soon as advanceVirtualClock returns
+void inlineClock() {
+  RtpWorker worker(0, 44000, 44019, virtualClockOptions(5));
+  worker.start();
+  worker.stop();
+  auto a = std::make_shared<TickSink>(20);
+  int portA = worker.allocatePort(a);
+  CHECK(portA > 0);
+
+  // Nothing moves without a step
+  CHECK_EQ(a->count(), 0u);
+  worker.advanceVirtualClock(19);
+  CHECK_EQ(a->count(), 0u);
+  worker.advanceVirtualClock(1);
+  CHECK(a->ticks() == every(20, 20, 1));
+  worker.advanceVirtualClock(80);
+  CHECK(a->ticks() == every(20, 20, 5));
+
+  // A second sink keeps its own cadence from when it was allocated
+  auto b = std::make_shared<TickSink>(30);
+  int portB = worker.allocatePort(b);
+  CHECK(portB > 0);
+  worker.advanceVirtualClock(90);
+  CHECK(a->ticks() == every(20, 20, 9));
+  CHECK(b->ticks() == every(130, 30, 3));
+
+  // Released sinks stop ticking
+  worker.releasePort(portA);
+  worker.advanceVirtualClock(200);
+  CHECK_EQ(a->count(), 9u);
+  CHECK(b->ticks() == every(130, 30, 9));
+  worker.releasePort(portB);
+}
+
+// The interval is rounded to the clock resolution
+void roundedInterval() {
+  RtpWorker worker(0, 44020, 44039, virtualClockOptions(10));
+  worker.start();
+  worker.stop();
+  auto sink = std::make_shared<TickSink>(25);
+  int port = worker.allocatePort(sink);
+  CHECK(port > 0);
+  worker.advanceVirtualClock(90);
+  CHECK(sink->ticks() == every(30, 30, 3));
+  worker.releasePort(port);
+}
+
+// With the loop running, steps are posted to it and applied in order
+void loopThreadClock() {
+  RtpWorker worker(0, 44040, 44059, virtualClockOptions(5));
+  worker.start();
+  auto sink = std::make_shared<TickSink>(20);
+  int port = worker.allocatePort(sink);
+  CHECK(port > 0);
+  for (int i = 0; i < 50; ++i)
+    worker.advanceVirtualClock(20);
+  for (int i = 0; i < 200 && sink->count() < 50; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  CHECK(sink->ticks() == every(20, 20, 50));
+  worker.releasePort(port);
+  worker.stop();
+
+  // After stop() the clock is stepped inline again
+  worker.advanceVirtualClock(100);
+  CHECK_EQ(sink->count(), 50u);
+}
+
+// An allocation the caller gave up on must not keep the port or the sink
+// once the loop gets to it
+void abandonedAllocation() {
+  RtpWorker worker(0, 44060, 44063, virtualClockOptions(5));
+  worker.start();
+  auto staller = std::make_shared<StallSink>();
+  int stallPort = worker.allocatePort(staller);
+  CHECK(stallPort > 0);
+  worker.advanceVirtualClock(20);
+  staller->waitStalled();
+
+  auto late = std::make_shared<TickSink>(20);
+  CHECK_EQ(worker.allocatePort(late), -1);
+  staller->go();
+  for (int i = 0; i < 200 && late.use_count() > 1; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  CHECK_EQ(late.use_count(), 1);
+
+  // The range has two RTP ports; the second is still free
+  auto next = std::make_shared<TickSink>(20);
+  int port = worker.allocatePort(next);
+  CHECK(port > 0 && port != stallPort);
+  worker.releasePort(port);
+  worker.releasePort(stallPort);
+  worker.stop();
+}
+
+} // namespace
+
+int main() {
+  Logger::instance().setLevel(LogLevel::WARN);
+  inlineClock();
+  roundedInterval();
+  loopThreadClock();
+  abandonedAllocation();
+  printf("media_clock_test passed\n");
+  return 0;
+}
@@ -0,0 +1,330 @@
+// SipParser and SipMessage: compact and folded headers, repeated Vias,
+// truncated bodies, status lines, tag and branch parameters, and copies of
+// built messages
+
+#include "Check.h"
+#include "sip/SipParser.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// The message refers into text, so text must be a named buffer that
+// outlives it
+static std::optional<SipMessage> parse(const std::string &text) {
+  return SipParser::parse(text.data(), text.size());
+}
+static std::optional<SipMessage> parse(std::string &&) = delete;
+
+// Parsed text is a slice of the datagram, not a copy
+static bool within(std::string_view s, const std::string &buffer) {
+  return s.data() >= buffer.data() &&
+         s.data() + s.size() <= buffer.data() + buffer.size();
+}
+
+static void compactHeaders() {
+  const std::string text = "INVITE sip:bot@gw.example.com SIP/2.0\r\n"
+                           "v: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bKc1\r\n"
+                           "f: <sip:alice@example.com>;tag=from1\r\n"
+                           "t: <sip:bot@gw.example.com>\r\n"
+                           "i: compact-call@10.0.0.1\r\n"
+                           "CSeq: 7 INVITE\r\n"
+                           "m: <sip:alice@10.0.0.1:5060>\r\n"
+                           "l: 4\r\n"
+                           "\r\n"
+                           "v=0\n";
+  auto msg = parse(text);
+  CHECK(msg);
+  CHECK(msg->isRequest);
+  CHECK(msg->method == SipMethod::INVITE);
+  CHECK_EQ(msg->uri(), "sip:bot@gw.example.com");
+  CHECK_EQ(msg->version(), "SIP/2.0");
+
+  CHECK_EQ(msg->header(SipHeader::Via),
+           "SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bKc1");
+  CHECK_EQ(msg->header(SipHeader::From), "<sip:alice@example.com>;tag=from1");
+  CHECK_EQ(msg->header(SipHeader::To), "<sip:bot@gw.example.com>");
+  CHECK_EQ(msg->getCallId(), "compact-call@10.0.0.1");
+  CHECK_EQ(msg->header(SipHeader::Contact), "<sip:alice@10.0.0.1:5060>");
+  CHECK_EQ(msg->header(SipHeader::ContentLength), "4");
+  CHECK_EQ(msg->body(), "v=0\n");
+
+  // Long names find compact headers too, in any case
+  CHECK(msg->getHeader("call-id"));
+  CHECK_EQ(*msg->getHeader("CALL-ID"), "compact-call@10.0.0.1");
+  CHECK_EQ(*msg->getHeader("Contact"), "<sip:alice@10.0.0.1:5060>");
+
+  CHECK_EQ(msg->getBranch(), "z9hG4bKc1");
+  CHECK_EQ(msg->getFromTag(), "from1");
+  CHECK_EQ(msg->getToTag(), "");
+  CHECK_EQ(msg->getFromUser(), "alice");
+  CHECK_EQ(msg->getToUser(), "bot");
+  CHECK_EQ(msg->getCSeq(), 7);
+  CHECK(msg->getCSeqMethod() == SipMethod::INVITE);
+
+  CHECK(within(msg->getCallId(), text));
+  CHECK(within(msg->body(), text));
+}
+
+static void viasInOrder() {
+  const std::string text =
+      "BYE sip:bot@gw SIP/2.0\r\n"
+      "Via: SIP/2.0/UDP proxy2;branch=z9hG4bKtop, SIP/2.0/UDP proxy1;"
+      "branch=z9hG4bKcomma\r\n"
+      "Max-Forwards: 69\r\n"
+      "v: SIP/2.0/UDP 10.0.0.1;branch=z9hG4bKbottom;rport\r\n"
+      "VIA: SIP/2.0/TCP 10.0.0.2;branch=z9hG4bKlast\r\n"
+      "Call-ID: vias\r\n"
+      "CSeq: 2 BYE\r\n"
+      "\r\n";
+  auto msg = parse(text);
+  CHECK(msg);
+  std::vector<std::string_view> vias;
+  msg->forEachHeader(SipHeader::Via,
+                     [&](std::string_view v) { vias.push_back(v); });
+  CHECK_EQ(vias.size(), 3u);
+  CHECK_EQ(vias[0], "SIP/2.0/UDP proxy2;branch=z9hG4bKtop, SIP/2.0/UDP "
+                    "proxy1;branch=z9hG4bKcomma");
+  CHECK_EQ(vias[1], "SIP/2.0/UDP 10.0.0.1;branch=z9hG4bKbottom;rport");
+  CHECK_EQ(vias[2], "SIP/2.0/TCP 10.0.0.2;branch=z9hG4bKlast");
+
+  // The branch is the topmost Via value's, not one after its comma
+  CHECK_EQ(msg->getBranch(), "z9hG4bKtop");
+  CHECK_EQ(*msg->getHeader("max-forwards"), "69");
+  CHECK(msg->getCSeqMethod() == SipMethod::BYE);
+
+  // The fast path sees the same headers in the same order
+  std::vector<std::string_view> fast;
+  CHECK(SipParser::forEachHeader(
+      text.data(), text.size(),
+      [&](SipHeader id, std::string_view, std::string_view value) {
+        if (id == SipHeader::Via)
+          fast.push_back(value);
+      }));
+  CHECK(fast == vias);
+}
+
+static void foldedHeaders() {
+  const std::string text = "INVITE sip:bot@gw SIP/2.0\r\n"
+                           "Via: SIP/2.0/UDP 10.0.0.1\r\n"
+                           "\t;branch=z9hG4bKfolded\r\n"
+                           "From: <sip:alice@example.com>\r\n"
+                           "   ;tag=f1\r\n"
+                           "To: <sip:bot@gw>\r\n"
+                           "Subject: one\r\n"
+                           " two  \r\n"
+                           "\tthree\r\n"
+                           "Call-ID: folded\r\n"
+                           "CSeq: 1 INVITE\r\n"
+                           "\r\n";
+  auto msg = parse(text);
+  CHECK(msg);
+  CHECK_EQ(msg->header(SipHeader::Via),
+           "SIP/2.0/UDP 10.0.0.1 ;branch=z9hG4bKfolded");
+  CHECK_EQ(msg->getBranch(), "z9hG4bKfolded");
+  CHECK_EQ(msg->getFromTag(), "f1");
+  CHECK_EQ(*msg->getHeader("subject"), "one two three");
+  // Unfolded headers are still slices
+  CHECK_EQ(msg->getCallId(), "folded");
+  CHECK(within(msg->getCallId(), text));
+
+  // The fast path leaves folded messages to parse()
+  CHECK(!SipParser::forEachHeader(
+      text.data(), text.size(),
+      [](SipHeader, std::string_view, std::string_view) {}));
+
+  // A message that starts with a continuation line has nothing to fold into
+  const std::string strayText = "OPTIONS sip:gw SIP/2.0\r\n continued\r\n"
+                                "Call-ID: x\r\n\r\n";
+  auto stray = parse(strayText);
+  CHECK(stray);
+  CHECK_EQ(stray->getCallId(), "x");
+}
+
+static void contentLengthPastDatagram() {
+  const std::string text = "INVITE sip:bot@gw SIP/2.0\r\n"
+                           "Call-ID: short\r\n"
+                           "Content-Length: 500\r\n"
+                           "\r\n"
+                           "v=0\r\no=- 1 1 IN IP4 10.0.0.1\r\n";
+  auto msg = parse(text);
+  CHECK(msg);
+  CHECK_EQ(msg->body(), "v=0\r\no=- 1 1 IN IP4 10.0.0.1\r\n");
+
+  // Shorter than what follows: the rest is ignored
+  const std::string shortText = "INVITE sip:bot@gw SIP/2.0\r\n"
+                                "Content-Length: 3\r\n"
+                                "\r\n"
+                                "v=0 and more";
+  auto shortBody = parse(shortText);
+  CHECK(shortBody);
+  CHECK_EQ(shortBody->body(), "v=0");
+
+  // Missing, zero or garbage means no body
+  for (const char *length : {"", "Content-Length: 0\r\n",
+                             "Content-Length: lots\r\n"}) {
+    const std::string noBody =
+        std::string("INVITE sip:bot@gw SIP/2.0\r\n") + length + "\r\nv=0";
+    auto msg = parse(noBody);
+    CHECK(msg);
+    CHECK(msg->body().empty());
+  }
+
+  // Headers cut off before the blank line still parse
+  const std::string cutText = "BYE sip:bot@gw SIP/2.0\r\nCall-ID: cut";
+  auto cut = parse(cutText);
+  CHECK(cut);
+  CHECK_EQ(cut->getCallId(), "cut");
+  CHECK(cut->body().empty());
+}
+
+static void statusLines() {
+  const std::string ringingText = "SIP/2.0 180 Ringing\r\n"
+                                  "Via: SIP/2.0/UDP gw;branch=z9hG4bKr\r\n"
+                                  "To: <sip:alice@example.com>;tag=t9\r\n"
+                                  "CSeq: 1 INVITE\r\n"
+                                  "\r\n";
+  auto ringing = parse(ringingText);
+  CHECK(ringing);
+  CHECK(!ringing->isRequest);
+  CHECK(ringing->method == SipMethod::UNKNOWN);
+  CHECK_EQ(ringing->statusCode, 180);
+  CHECK_EQ(ringing->statusPhrase(), "Ringing");
+  CHECK_EQ(ringing->version(), "SIP/2.0");
+  CHECK_EQ(ringing->getToTag(), "t9");
+  CHECK(ringing->getCSeqMethod() == SipMethod::INVITE);
+
+  const std::string progressText = "SIP/2.0 183 Session Progress\n\n";
+  auto progress = parse(progressText);
+  CHECK(progress);
+  CHECK_EQ(progress->statusCode, 183);
+  CHECK_EQ(progress->statusPhrase(), "Session Progress");
+
+  // Request methods are matched without regard to case
+  const std::string lowerText = "bye sip:bot@gw SIP/2.0\r\n\r\n";
+  auto lower = parse(lowerText);
+  CHECK(lower);
+  CHECK(lower->method == SipMethod::BYE);
+  CHECK_EQ(lower->methodStr(), "bye");
+  const std::string unknownText = "SUBSCRIBE sip:bot@gw SIP/2.0\r\n\r\n";
+  auto unknown = parse(unknownText);
+  CHECK(unknown);
+  CHECK(unknown->isRequest);
+  CHECK(unknown->method == SipMethod::UNKNOWN);
+
+  for (const char *bad : {"", "\r\n", "SIP/2.0 200", "SIP/2.0 2x0 OK",
+                          "SIP/2.0  OK", "INVITE", "INVITE sip:bot@gw",
+                          "garbage"}) {
+    const std::string badText = std::string(bad) + "\r\nCall-ID: x\r\n\r\n";
+    CHECK(!parse(badText));
+  }
+}
+
+static void tagsAndBranches() {
+  // URI parameters inside <...> are not header parameters
+  const std::string text =
+      "INVITE sip:bot@gw SIP/2.0\r\n"
+      "Via: SIP/2.0/UDP 10.0.0.1:5060 ; BRANCH = z9hG4bKsp ;rport\r\n"
+      "From: \"Alice\" <sip:alice@example.com;tag=uri>;tag=real\r\n"
+      "To: <sip:bot@gw;transport=udp;tag=nottag>\r\n"
+      "Call-ID: tags\r\n"
+      "CSeq: 3 INVITE\r\n"
+      "\r\n";
+  auto msg = parse(text);
+  CHECK(msg);
+  CHECK_EQ(msg->getBranch(), "z9hG4bKsp");
+  CHECK_EQ(msg->getFromTag(), "real");
+  CHECK_EQ(msg->getToTag(), "");
+  CHECK_EQ(msg->getFromUser(), "alice");
+
+  // Without angle brackets every ;param is a header parameter
+  const std::string bareText =
+      "BYE sip:bot@gw SIP/2.0\r\n"
+      "Via: SIP/2.0/UDP 10.0.0.1;received=10.0.0.9;branch=b1\r\n"
+      "From: sip:alice@example.com;tag=bare;x=1\r\n"
+      "To: sip:bot@gw;TAG=upper\r\n"
+      "\r\n";
+  auto bare = parse(bareText);
+  CHECK(bare);
+  CHECK_EQ(bare->getBranch(), "b1");
+  CHECK_EQ(bare->getFromTag(), "bare");
+  CHECK_EQ(bare->getToTag(), "upper");
+
+  // Names must match whole, and valueless parameters are skipped
+  CHECK_EQ(SipMessage::headerParam("<sip:a@b>;xtag=1;tagx=2;tag;tag=3", "tag"),
+           "3");
+  CHECK_EQ(SipMessage::headerParam("<sip:a@b>;tag=", "tag"), "");
+  CHECK_EQ(SipMessage::headerParam("<sip:a@b;tag=1>", "tag"), "");
+  CHECK_EQ(SipMessage::headerParam("", "tag"), "");
+  // Only the first of several comma-separated values is searched
+  CHECK_EQ(SipMessage::headerParam("<sip:a@b>, <sip:c@d>;tag=2", "tag"), "");
+  CHECK_EQ(SipMessage::headerParam("sip:a@b;tag=1, <sip:c@d;tag=2>", "tag"),
+           "1");
+  // A quoted display name may hold separators
+  CHECK_EQ(SipMessage::headerParam(
+               "\"Smith, J; <x>\" <sip:j@example.com;tag=u>;tag=q", "tag"),
+           "q");
+  CHECK_EQ(SipMessage::headerParam("<sip:a@b;tag=1", "tag"), "");
+}
+
+static void copiedBuiltMessage() {
+  SipMessage copy;
+  {
+    SipMessage msg;
+    msg.setStatusLine("SIP/2.0", 200, "OK");
+    msg.addHeader("Via", "SIP/2.0/UDP 10.0.0.1;branch=z9hG4bKbuilt");
+    msg.addHeader("From", "<sip:alice@example.com>;tag=a");
+    msg.addHeader("To", "<sip:bot@gw>;tag=b");
+    msg.addHeader("Call-ID", "built@gw");
+    msg.addHeader("CSeq", "1 INVITE");
+    msg.addHeader("X-Custom", "kept");
+    // Enough text to move owned storage when it grows
+    msg.setBody(std::string(2000, 's'));
+    copy = msg;
+    // Changes to the original after the copy do not show up in it
+    msg.addHeader("X-Later", "no");
+  }
+  CHECK(!copy.isRequest);
+  CHECK_EQ(copy.statusCode, 200);
+  CHECK_EQ(copy.statusPhrase(), "OK");
+  CHECK_EQ(copy.getBranch(), "z9hG4bKbuilt");
+  CHECK_EQ(copy.getFromTag(), "a");
+  CHECK_EQ(copy.getToTag(), "b");
+  CHECK_EQ(copy.getCallId(), "built@gw");
+  CHECK_EQ(*copy.getHeader("x-custom"), "kept");
+  CHECK(!copy.getHeader("X-Later"));
+  CHECK_EQ(copy.body().size(), 2000u);
+
+  // Content-Length is filled in, and the text parses back to the same message
+  std::string text = copy.toString();
+  CHECK(text.find("Content-Length: 2000\r\n") != std::string::npos);
+  auto back = parse(text);
+  CHECK(back);
+  CHECK_EQ(back->statusCode, 200);
+  CHECK_EQ(back->getCallId(), "built@gw");
+  CHECK_EQ(*back->getHeader("X-Custom"), "kept");
+  CHECK_EQ(back->body(), copy.body());
+
+  // A built request keeps its own request line
+  SipMessage request;
+  request.setRequestLine("BYE", "sip:alice@10.0.0.1:5060");
+  request.addHeader("Call-ID", "req");
+  SipMessage requestCopy = request;
+  CHECK(requestCopy.isRequest);
+  CHECK(requestCopy.method == SipMethod::BYE);
+  CHECK_EQ(requestCopy.toString(), "BYE sip:alice@10.0.0.1:5060 SIP/2.0\r\n"
+                                   "Call-ID: req\r\n"
+                                   "Content-Length: 0\r\n"
+                                   "\r\n");
+}
+
+int main() {
+  compactHeaders();
+  viasInOrder();
+  foldedHeaders();
+  contentLengthPastDatagram();
+  statusLines();
+  tagsAndBranches();
+  copiedBuiltMessage();
+  std::printf("sip_parser_test passed\n");
+  return 0;
+}
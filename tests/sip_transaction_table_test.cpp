@@ -0,0 +1,305 @@
+// SipTransactionTable on a stepped clock: the RFC 3261 timer schedule
+// (G, H, I, J, K and the 2xx hold), and probing after deletions across the
+// wrap and after the table grows
+
+#include "Check.h"
+#include "sip/SipTransactionTable.h"
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+using std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+
+const uint32_t kT1 = 500;
+const uint32_t kT2 = 4000;
+const uint32_t kT4 = 5000;
+
+// The table's clock; a table made with steppedNow starts at kEpoch
+const Clock::time_point kEpoch = Clock::time_point() + std::chrono::hours(1);
+Clock::time_point gNow = kEpoch;
+Clock::time_point steppedNow() { return gNow; }
+
+uint64_t nowMs() {
+  return std::chrono::duration_cast<milliseconds>(gNow - kEpoch).count();
+}
+
+// Steps the clock to ms after the table was made, 10 ms at a time so every
+// timer fires on its own tick
+void stepTo(SipTransactionTable &table, uint64_t ms) {
+  while (nowMs() < ms) {
+    gNow += milliseconds(10);
+    table.advance(gNow);
+  }
+}
+
+SipMessage request(const char *method, const std::string &branch) {
+  SipMessage msg;
+  msg.setRequestLine(method, "sip:bot@gw");
+  msg.addHeader("Via", "SIP/2.0/UDP 10.0.0.1:5060;branch=" + branch);
+  msg.addHeader("Call-ID", "table-test");
+  msg.addHeader("CSeq", std::string("1 ") + method);
+  return msg;
+}
+
+SipMessage response(int code) {
+  SipMessage msg;
+  msg.setStatusLine("SIP/2.0", code, "Whatever");
+  return msg;
+}
+
+struct Fixture {
+  Fixture() : table(steppedNow) {
+    table.setRetransmit([this](const std::string &wire, const sockaddr_in &) {
+      CHECK_EQ(wire, "SIP/2.0 486 Busy Here\r\n\r\n");
+      retransmits.push_back(nowMs());
+    });
+  }
+  ~Fixture() { gNow = kEpoch; }
+
+  SipTransactionTable table;
+  std::vector<uint64_t> retransmits;
+  sockaddr_in peer{};
+};
+
+// Timer G doubles from T1 and caps at T2 until Timer H gives up at 64*T1
+void timerGUntilH() {
+  Fixture f;
+  uint64_t key = 42;
+  f.table.insert(key, request("INVITE", "z9hG4bKg"));
+  f.table.responseSent(key, 486, "SIP/2.0 486 Busy Here\r\n\r\n", f.peer);
+  CHECK(f.table.find(key)->getState() == TransactionState::COMPLETED);
+
+  stepTo(f.table, 64 * kT1 - 10);
+  CHECK(f.table.find(key));
+  std::vector<uint64_t> expected;
+  for (uint64_t at = kT1, interval = kT1; at < 64 * kT1;
+       interval = std::min<uint64_t>(interval * 2, kT2), at += interval)
+    expected.push_back(at);
+  CHECK(f.retransmits == expected);
+  CHECK_EQ(f.retransmits.size(), 10u); // 500, 1500, 3500, 7500, ... 31500
+
+  stepTo(f.table, 64 * kT1);
+  CHECK(!f.table.find(key));
+  CHECK_EQ(f.table.size(), 0u);
+  stepTo(f.table, 64 * kT1 + kT2 * 2);
+  CHECK_EQ(f.retransmits.size(), 10u);
+}
+
+// An ACK stops Timer G and leaves the entry for Timer I (T4) only
+void ackArmsTimerI() {
+  Fixture f;
+  uint64_t key = 43;
+  f.table.insert(key, request("INVITE", "z9hG4bKi"));
+  stepTo(f.table, 100);
+  f.table.responseSent(key, 486, "SIP/2.0 486 Busy Here\r\n\r\n", f.peer);
+  stepTo(f.table, 1000);
+  CHECK(f.retransmits == std::vector<uint64_t>{100 + kT1});
+
+  f.table.requestReceived(key, request("ACK", "z9hG4bKi"));
+  CHECK(f.table.find(key)->getState() == TransactionState::CONFIRMED);
+  stepTo(f.table, 1000 + kT4 - 10);
+  CHECK(f.table.find(key));
+  CHECK_EQ(f.retransmits.size(), 1u);
+  stepTo(f.table, 1000 + kT4);
+  CHECK(!f.table.find(key));
+
+  // An ACK for a key the table does not hold is ignored
+  f.table.requestReceived(key, request("ACK", "z9hG4bKi"));
+  CHECK_EQ(f.table.size(), 0u);
+}
+
+// 2xx to INVITE (held like Timer L), non-INVITE (Timer J) and transactions
+// that never get a final response all leave 64*T1 after their last event;
+// client transactions leave T4 after their final response (Timer K)
+void otherExpiries() {
+  Fixture f;
+  uint64_t invite = 1, bye = 2, silent = 3, client = 4, provisional = 5;
+  f.table.insert(invite, request("INVITE", "z9hG4bKok"));
+  f.table.insert(bye, request("BYE", "z9hG4bKbye"));
+  f.table.insert(silent, request("INFO", "z9hG4bKsilent"));
+  f.table.insert(client, request("BYE", "z9hG4bKclient"));
+  f.table.insert(provisional, request("INVITE", "z9hG4bKprov"));
+
+  stepTo(f.table, 1000);
+  f.table.responseSent(invite, 200, "SIP/2.0 200 OK\r\n\r\n", f.peer);
+  f.table.responseSent(bye, 200, "SIP/2.0 200 OK\r\n\r\n", f.peer);
+  // A provisional response does not restart the clock
+  f.table.responseSent(provisional, 180, "SIP/2.0 180 Ringing\r\n\r\n",
+                       f.peer);
+  f.table.responseReceived(client, response(100));
+  stepTo(f.table, 2000);
+  f.table.responseReceived(client, response(200));
+  CHECK(f.table.find(client)->getState() == TransactionState::COMPLETED);
+
+  stepTo(f.table, 2000 + kT4 - 10);
+  CHECK(f.table.find(client));
+  stepTo(f.table, 2000 + kT4);
+  CHECK(!f.table.find(client));
+
+  stepTo(f.table, 64 * kT1 - 10);
+  CHECK_EQ(f.table.size(), 4u);
+  stepTo(f.table, 64 * kT1);
+  CHECK(!f.table.find(silent));
+  CHECK(!f.table.find(provisional));
+  CHECK(f.table.find(invite));
+  CHECK(f.table.find(bye));
+
+  stepTo(f.table, 1000 + 64 * kT1 - 10);
+  CHECK_EQ(f.table.size(), 2u);
+  stepTo(f.table, 1000 + 64 * kT1);
+  CHECK_EQ(f.table.size(), 0u);
+  CHECK(f.retransmits.empty()); // G is for 3xx-6xx only
+}
+
+// Inserting a key again replaces the transaction and restarts its timers
+void reinsertRestartsTimers() {
+  Fixture f;
+  uint64_t key = 6;
+  f.table.insert(key, request("INVITE", "z9hG4bKre"));
+  f.table.responseSent(key, 486, "SIP/2.0 486 Busy Here\r\n\r\n", f.peer);
+  stepTo(f.table, 10000);
+  size_t sent = f.retransmits.size();
+  f.table.insert(key, request("INVITE", "z9hG4bKre"));
+  CHECK(f.table.find(key)->getState() == TransactionState::TRYING);
+  CHECK_EQ(f.table.size(), 1u);
+  stepTo(f.table, 10000 + 64 * kT1 - 10);
+  CHECK_EQ(f.retransmits.size(), sent);
+  CHECK(f.table.find(key));
+  stepTo(f.table, 10000 + 64 * kT1);
+  CHECK(!f.table.find(key));
+}
+
+// Keys are placed at key & (slots - 1); the table starts with 1024 slots
+const uint64_t kSlots = 1024;
+
+// A probe run that wraps from the last slot to the first, cut in the
+// middle: the rest of the run must still be found, and the freed slots
+// reused
+void eraseAcrossWrap() {
+  Fixture f;
+  // Home slot 1021 for the first four; the fourth lands in slot 0. Then
+  // homes 0 and 1, pushed to slots 1 and 2.
+  const uint64_t keys[] = {1021,          1021 + kSlots, 1021 + 2 * kSlots,
+                           1021 + 3 * kSlots, kSlots,    1};
+  for (uint64_t key : keys)
+    f.table.insert(key, request("BYE", "z9hG4bKw" + std::to_string(key)));
+
+  // Client Timer K removes one entry at a time
+  auto remove = [&](uint64_t key) {
+    f.table.responseReceived(key, response(200));
+    stepTo(f.table, nowMs() + kT4);
+    CHECK(!f.table.find(key));
+  };
+  remove(keys[1]);
+  for (uint64_t key : keys) {
+    if (key != keys[1]) {
+      CHECK(f.table.find(key));
+      CHECK_EQ(f.table.find(key)->getBranch(),
+               "z9hG4bKw" + std::to_string(key));
+    }
+  }
+  remove(keys[4]);
+  remove(keys[0]);
+  CHECK(f.table.find(keys[2]));
+  CHECK(f.table.find(keys[3]));
+  CHECK(f.table.find(keys[5]));
+  CHECK_EQ(f.table.size(), 3u);
+
+  // Never-inserted keys on the same run are not found
+  CHECK(!f.table.find(1021 + 4 * kSlots));
+  CHECK(!f.table.find(2 * kSlots));
+
+  for (uint64_t key : {keys[0], keys[1], keys[4]})
+    f.table.insert(key, request("BYE", "z9hG4bKagain"));
+  CHECK_EQ(f.table.size(), 6u);
+  for (uint64_t key : keys)
+    CHECK(f.table.find(key));
+}
+
+// A hole in the last slot: the entry in slot 0 is at home and must stay,
+// the one after it wrapped from the last slot and must move back
+void eraseLastSlot() {
+  Fixture f;
+  const uint64_t last = kSlots - 1, home0 = kSlots, wrapped = 2 * kSlots - 1;
+  for (uint64_t key : {last, home0, wrapped})
+    f.table.insert(key, request("BYE", "z9hG4bKl"));
+  f.table.responseReceived(last, response(200));
+  stepTo(f.table, kT4);
+  CHECK(!f.table.find(last));
+  CHECK(f.table.find(home0));
+  CHECK(f.table.find(wrapped));
+  CHECK_EQ(f.table.size(), 2u);
+}
+
+// Colliding keys past half full make the table grow; every entry is still
+// found and still expires on time
+void growWithCollisions() {
+  Fixture f;
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 1; i <= 700; ++i)
+    keys.push_back(i * kSlots + 5 + (i % 3) * (kSlots - 3)); // homes 5, 2, 1023
+  for (uint64_t key : keys)
+    f.table.insert(key, request("BYE", "z9hG4bK" + std::to_string(key)));
+  CHECK_EQ(f.table.size(), keys.size());
+  for (uint64_t key : keys) {
+    CHECK(f.table.find(key));
+    CHECK_EQ(f.table.find(key)->getBranch(), "z9hG4bK" + std::to_string(key));
+  }
+
+  // Every other one answered: those go at T4, the rest at 64*T1
+  for (size_t i = 0; i < keys.size(); i += 2)
+    f.table.responseReceived(keys[i], response(404));
+  stepTo(f.table, kT4);
+  CHECK_EQ(f.table.size(), keys.size() / 2);
+  for (size_t i = 0; i < keys.size(); ++i)
+    CHECK_EQ(f.table.find(keys[i]) != nullptr, i % 2 == 1);
+  stepTo(f.table, 64 * kT1);
+  CHECK_EQ(f.table.size(), 0u);
+}
+
+// Random inserts and expiries on crowded probe runs, checked against a map
+void randomAgainstModel() {
+  Fixture f;
+  std::mt19937_64 rng(11);
+  std::map<uint64_t, uint64_t> expiry; // key -> ms it leaves at
+  for (int round = 0; round < 400; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      // Few home slots, so runs are long and often wrap
+      uint64_t key = (rng() << 12) | (1016 + rng() % 16) % kSlots;
+      if (!key || expiry.count(key))
+        continue;
+      f.table.insert(key, request("BYE", "z9hG4bKr"));
+      expiry[key] = nowMs() + 64 * kT1;
+      if (rng() % 2) {
+        f.table.responseReceived(key, response(200));
+        expiry[key] = nowMs() + kT4;
+      }
+    }
+    stepTo(f.table, nowMs() + 10 * (1 + rng() % 30));
+    for (auto it = expiry.begin(); it != expiry.end();) {
+      bool gone = it->second <= nowMs();
+      CHECK_EQ(f.table.find(it->first) == nullptr, gone);
+      it = gone ? expiry.erase(it) : std::next(it);
+    }
+    CHECK_EQ(f.table.size(), expiry.size());
+  }
+}
+
+} // namespace
+
+int main() {
+  timerGUntilH();
+  ackArmsTimerI();
+  otherExpiries();
+  reinsertRestartsTimers();
+  eraseAcrossWrap();
+  eraseLastSlot();
+  growWithCollisions();
+  randomAgainstModel();
+  std::printf("sip_transaction_table_test passed\n");
+  return 0;
+}
@@ -0,0 +1,162 @@
+// TimerWheel: expiry at level boundaries, cancellation and re-entrancy
+
+#include "Check.h"
+#include "util/TimerWheel.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static void firesAtExactTick() {
+  // Level boundaries (64 and 4096 ticks cascade from levels 1 and 2), the
+  // top level and beyond the wheel's horizon
+  const uint64_t ticks[] = {1,     63,    64,     65,     127,    128,
+                            4095,  4096,  4097,   8192,   262143, 262144,
+                            262145, (1ULL << 24) - 1, 1ULL << 24,
+                            (1ULL << 24) + 70000};
+  for (uint64_t start : {0ULL, 5ULL, 4000ULL}) {
+    for (uint64_t t : ticks) {
+      // Walked tick by tick
+      TimerWheel wheel(start);
+      uint64_t firedAt = 0;
+      int fired = 0;
+      wheel.scheduleAt(start + t, [&] {
+        firedAt = wheel.now();
+        fired++;
+      });
+      if (t < 10000) {
+        for (uint64_t now = start + 1; now < start + t; ++now)
+          wheel.advanceTo(now);
+      } else {
+        wheel.advanceTo(start + t - 1);
+      }
+      CHECK_EQ(fired, 0);
+      CHECK_EQ(wheel.advanceTo(start + t), 1u);
+      CHECK_EQ(fired, 1);
+      CHECK_EQ(firedAt, start + t);
+      CHECK_EQ(wheel.pending(), 0u);
+
+      // One jump past it
+      TimerWheel jump(start);
+      fired = 0;
+      jump.scheduleAt(start + t, [&] {
+        firedAt = jump.now();
+        fired++;
+      });
+      CHECK_EQ(jump.advanceTo(start + t + 1000), 1u);
+      CHECK_EQ(fired, 1);
+      CHECK_EQ(firedAt, start + t);
+    }
+  }
+}
+
+static void randomTimersFireInOrder() {
+  std::mt19937 rng(7);
+  TimerWheel wheel;
+  std::vector<uint64_t> expiry(20000);
+  std::vector<int> fired(expiry.size(), 0);
+  uint64_t last = 0;
+  for (size_t i = 0; i < expiry.size(); ++i) {
+    expiry[i] = 1 + rng() % 20000;
+    wheel.scheduleAt(expiry[i], [&, i] {
+      CHECK_EQ(wheel.now(), expiry[i]);
+      CHECK(wheel.now() >= last);
+      last = wheel.now();
+      fired[i]++;
+    });
+  }
+  // Uneven steps so boundaries fall inside and at the ends of a step
+  uint64_t now = 0;
+  while (now < 20000) {
+    now += 1 + rng() % 300;
+    wheel.advanceTo(now);
+  }
+  for (int f : fired)
+    CHECK_EQ(f, 1);
+  CHECK_EQ(wheel.pending(), 0u);
+}
+
+static void cancelAfterFire() {
+  TimerWheel wheel;
+  int fired = 0;
+  auto id = wheel.scheduleAt(64, [&] { fired++; });
+  wheel.advanceTo(64);
+  CHECK_EQ(fired, 1);
+  CHECK(!wheel.cancel(id));
+
+  // The node is reused; the stale id must not cancel the new timer
+  auto reused = wheel.scheduleAt(100, [&] { fired++; });
+  CHECK((uint32_t)reused == (uint32_t)id);
+  CHECK(!wheel.cancel(id));
+  wheel.advanceTo(100);
+  CHECK_EQ(fired, 2);
+
+  // Cancelled timers never fire and cancel only once
+  auto cancelled = wheel.scheduleAt(4200, [&] { fired++; });
+  CHECK(wheel.cancel(cancelled));
+  CHECK(!wheel.cancel(cancelled));
+  wheel.advanceTo(10000);
+  CHECK_EQ(fired, 2);
+  CHECK(!wheel.cancel(0));
+}
+
+static void scheduleFromCallback() {
+  TimerWheel wheel;
+  std::vector<uint64_t> log;
+
+  // Rescheduling "now" lands on the next tick instead of spinning in the
+  // current one
+  wheel.scheduleAt(10, [&] {
+    log.push_back(wheel.now());
+    wheel.scheduleAt(wheel.now(), [&] { log.push_back(wheel.now()); });
+  });
+  CHECK_EQ(wheel.advanceTo(10), 1u);
+  CHECK_EQ(log.size(), 1u);
+  CHECK_EQ(wheel.advanceTo(11), 1u);
+  CHECK_EQ(log.size(), 2u);
+  CHECK_EQ(log[1], 11u);
+
+  // A periodic timer that reschedules itself across the 64 and 4096
+  // boundaries keeps its cadence
+  log.clear();
+  std::function<void()> periodic = [&] {
+    log.push_back(wheel.now());
+    if (log.size() < 200)
+      wheel.scheduleAt(wheel.now() + 30, periodic);
+  };
+  wheel.scheduleAt(20, periodic);
+  wheel.advanceTo(20000);
+  CHECK_EQ(log.size(), 200u);
+  for (size_t i = 0; i < log.size(); ++i)
+    CHECK_EQ(log[i], 20 + 30 * i);
+
+  // A callback can cancel a timer due in the same tick (whichever of the
+  // two runs first cancels the other), and one scheduled further out from
+  // inside a big jump still fires at its own tick
+  TimerWheel jump;
+  int fired = 0;
+  uint64_t laterAt = 0;
+  TimerWheel::TimerId a = 0, b = 0;
+  a = jump.scheduleAt(4096, [&] {
+    fired++;
+    CHECK(jump.cancel(b));
+    jump.scheduleAt(jump.now() + 64, [&] { laterAt = jump.now(); });
+  });
+  b = jump.scheduleAt(4096, [&] {
+    fired++;
+    CHECK(jump.cancel(a));
+    jump.scheduleAt(jump.now() + 64, [&] { laterAt = jump.now(); });
+  });
+  jump.advanceTo(100000);
+  CHECK_EQ(fired, 1);
+  CHECK_EQ(laterAt, 4096u + 64);
+  CHECK_EQ(jump.pending(), 0u);
+}
+
+int main() {
+  firesAtExactTick();
+  randomTimersFireInOrder();
+  cancelAfterFire();
+  scheduleFromCallback();
+  printf("timer_wheel_test passed\n");
+  return 0;
+}